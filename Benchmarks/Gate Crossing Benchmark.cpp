@@ -0,0 +1,215 @@
+// Accuracy of the walking-test timer on synthetic walks with known ground
+// truth: the old 1 cm depth-window check against GateCrossing
+// (Common/GateCrossing.h). Each walk starts at rest 1 m before the start
+// gate, speeds up over half a second and walks at a constant speed with
+// torso sway past the stop gate. Depth is sampled at 30 Hz from a random
+// clock phase, with sensor noise, through the tests' 3-frame moving average.
+//
+//   missed  walks whose timer never started or never stopped
+//   mean    mean error of the measured time, ms
+//   rms     RMS error, ms
+//   max     largest absolute error, ms
+//
+// Usage: "Gate Crossing Benchmark" [noise mm]
+#include "../Common/GateCrossing.h"
+#include "../Common/RingFilter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+const TIMESPAN FRAME_TICKS = TICKS_PER_SECOND / 30;
+const int TRIALS = 500;
+
+struct Walk {
+    float startDistance;
+    float stopDistance;
+    double speed;      // m/s
+    double swayPhase;  // radians
+};
+
+const double SWAY_AMPLITUDE = 0.015; // m, torso moving back and forth with each step
+const double SWAY_FREQUENCY = 1.8;   // Hz, step rate
+const double REST_SECONDS = 1.0;
+const double ACCELERATION_SECONDS = 0.5;
+
+// Distance of the torso from the sensor at t seconds
+double walkDistance(const Walk& walk, double t) {
+    double sign = walk.stopDistance > walk.startDistance ? 1.0 : -1.0;
+    double origin = walk.startDistance - sign * 1.0;
+    double travelled = 0.0;
+    if (t > REST_SECONDS) {
+        double moving = t - REST_SECONDS;
+        // Speed ramps up linearly over ACCELERATION_SECONDS
+        travelled = moving < ACCELERATION_SECONDS
+            ? walk.speed * moving * moving / (2.0 * ACCELERATION_SECONDS)
+            : walk.speed * (moving - ACCELERATION_SECONDS / 2.0);
+        double ramp = std::min(1.0, moving / ACCELERATION_SECONDS);
+        travelled += ramp * SWAY_AMPLITUDE * sin(2.0 * 3.14159265 * SWAY_FREQUENCY * moving + walk.swayPhase);
+    }
+    return origin + sign * travelled;
+}
+
+double walkSeconds(const Walk& walk) {
+    return REST_SECONDS + ACCELERATION_SECONDS + (fabs(walk.stopDistance - walk.startDistance) + 1.5) / walk.speed;
+}
+
+// First time the true distance reaches `gate`, to 0.1 ms
+double trueCrossing(const Walk& walk, float gate) {
+    double sign = walk.stopDistance > walk.startDistance ? 1.0 : -1.0;
+    for (double t = 0.0; t < walkSeconds(walk); t += 1e-4) {
+        if (sign * (walkDistance(walk, t) - gate) >= 0.0) return t;
+    }
+    return -1.0;
+}
+
+// The check the walking tests used: the timer starts while the depth is
+// within 1 cm in front of the start gate and stops within 1 cm of the stop
+// gate, at the interpolated entry into that window
+class WindowTimer {
+public:
+    explicit WindowTimer(const Walk& walk) : walk_(walk) {}
+
+    void update(TIMESPAN time, float depth) {
+        if (previousTime_ == 0) {
+            previousTime_ = time;
+            previousDepth_ = depth;
+        }
+        float startLow, startHigh, stopLow, stopHigh;
+        window(walk_.startDistance, startLow, startHigh);
+        window(walk_.stopDistance, stopLow, stopHigh);
+        if (!timer_.isRunning() && !stopped_ && depth >= startLow && depth <= startHigh) {
+            timer_.start(bandEntryTime(previousTime_, previousDepth_, time, depth, startLow, startHigh));
+        }
+        if (timer_.isRunning() && depth >= stopLow && depth <= stopHigh) {
+            timer_.stop(bandEntryTime(previousTime_, previousDepth_, time, depth, stopLow, stopHigh));
+            stopped_ = true;
+        }
+        previousTime_ = time;
+        previousDepth_ = depth;
+    }
+
+    bool finished() const { return stopped_; }
+    double seconds() const { return timer_.finalSeconds(); }
+
+private:
+    // 1 cm on the side the walker comes from
+    void window(float gate, float& low, float& high) const {
+        bool approaching = walk_.stopDistance < walk_.startDistance;
+        low = approaching ? gate : gate - 0.01f;
+        high = approaching ? gate + 0.01f : gate;
+    }
+
+    Walk walk_;
+    FrameTimer timer_;
+    TIMESPAN previousTime_ = 0;
+    float previousDepth_ = 0.0f;
+    bool stopped_ = false;
+};
+
+class GateTimer {
+public:
+    explicit GateTimer(const Walk& walk)
+        : startGate_(walk.startDistance, gateDirection(walk.startDistance, walk.stopDistance)),
+          stopGate_(walk.stopDistance, gateDirection(walk.startDistance, walk.stopDistance)) {}
+
+    void update(TIMESPAN time, float depth) {
+        TIMESPAN startTime = 0, stopTime = 0;
+        bool started = startGate_.update(time, depth, startTime);
+        bool stopped = stopGate_.update(time, depth, stopTime);
+        if (started && !timer_.isRunning() && !stopped_) timer_.start(startTime);
+        if (stopped && timer_.isRunning()) {
+            timer_.stop(stopTime);
+            stopped_ = true;
+        }
+    }
+
+    bool finished() const { return stopped_; }
+    double seconds() const { return timer_.finalSeconds(); }
+
+private:
+    GateCrossing startGate_;
+    GateCrossing stopGate_;
+    FrameTimer timer_;
+    bool stopped_ = false;
+};
+
+struct Accuracy {
+    int missed = 0;
+    int measured = 0;
+    double errorSum = 0.0;
+    double squaredSum = 0.0;
+    double maxError = 0.0;
+
+    void add(bool finished, double seconds, double truth) {
+        if (!finished) {
+            ++missed;
+            return;
+        }
+        double error = seconds - truth;
+        ++measured;
+        errorSum += error;
+        squaredSum += error * error;
+        maxError = std::max(maxError, fabs(error));
+    }
+
+    void print(const char* name) const {
+        cout << "  " << left << setw(8) << name << right << fixed << setprecision(1)
+             << setw(9) << 100.0 * missed / (missed + measured) << "%";
+        if (measured) {
+            cout << setw(10) << 1000.0 * errorSum / measured
+                 << setw(10) << 1000.0 * sqrt(squaredSum / measured)
+                 << setw(10) << 1000.0 * maxError;
+        }
+        cout << endl;
+    }
+};
+
+void run(float startDistance, float stopDistance, double speed, double noiseMm, mt19937& random) {
+    normal_distribution<double> noise(0.0, noiseMm * 0.001);
+    uniform_real_distribution<double> phase(0.0, 2.0 * 3.14159265);
+    Accuracy window, gate;
+
+    for (int trial = 0; trial < TRIALS; ++trial) {
+        Walk walk = { startDistance, stopDistance, speed, phase(random) };
+        double truth = trueCrossing(walk, stopDistance) - trueCrossing(walk, startDistance);
+
+        WindowTimer windowTimer(walk);
+        GateTimer gateTimer(walk);
+        RingFilter<float, 3> depthFilter;
+        TIMESPAN offset = static_cast<TIMESPAN>(random() % FRAME_TICKS) + FRAME_TICKS;
+        for (TIMESPAN time = offset; ticksToSeconds(time) < walkSeconds(walk); time += FRAME_TICKS) {
+            float depth = static_cast<float>(walkDistance(walk, ticksToSeconds(time)) + noise(random));
+            float smoothed = depthFilter.push(depth);
+            windowTimer.update(time, smoothed);
+            gateTimer.update(time, smoothed);
+        }
+        window.add(windowTimer.finished(), windowTimer.seconds(), truth);
+        gate.add(gateTimer.finished(), gateTimer.seconds(), truth);
+    }
+
+    cout << fixed << setprecision(1) << startDistance << " m -> " << stopDistance << " m at " << speed << " m/s" << endl;
+    window.print("window");
+    gate.print("gate");
+}
+
+int main(int argc, char** argv) {
+    double noiseMm = argc > 1 ? atof(argv[1]) : 10.0;
+    mt19937 random(1);
+
+    cout << TRIALS << " walks per row, " << noiseMm << " mm depth noise, "
+         << SWAY_AMPLITUDE * 1000 << " mm sway at " << SWAY_FREQUENCY << " Hz" << endl;
+    cout << "  " << left << setw(8) << "timer" << right << setw(10) << "missed"
+         << setw(10) << "mean ms" << setw(10) << "rms ms" << setw(10) << "max ms" << endl;
+
+    const float gates[][2] = { { 6.0f, 1.0f }, { 2.0f, 4.0f }, { 3.0f, 8.0f } };
+    const double speeds[] = { 0.6, 1.2, 1.8 };
+    for (const auto& g : gates) {
+        for (double speed : speeds) run(g[0], g[1], speed, noiseMm, random);
+    }
+    return 0;
+}
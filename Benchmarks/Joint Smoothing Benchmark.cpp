@@ -0,0 +1,258 @@
+// Latency versus jitter of each joint smoothing filter (Common/JointSmoothing.h)
+// and of the 5-frame moving average (Common/JointFilterBank.h) on the
+// SpineMid Y coordinate, the signal the TUG test starts its timer on.
+//
+// Without an argument the filters run on a synthetic sit-to-stand with known
+// ground truth and 5 mm sensor noise:
+//   lag     delay of the Y_CHANGE_THRESHOLD (0.1 m) crossing behind the truth
+//   jitter  RMS error while the subject is still
+//   rms     RMS error over the whole trajectory
+// With a recording, the raw samples are the only reference:
+//   lag     time shift that best aligns the output with the raw signal
+//   jitter  RMS frame-to-frame acceleration of the output
+//
+// Usage: "Joint Smoothing Benchmark" [recording.ksession]
+#include "../Common/JointSmoothing.h"
+#include "../Common/JointFilterBank.h"
+#include "../Common/ReplayFrameSource.h"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const float Y_CHANGE_THRESHOLD = 0.1f; // as in the TUG tests
+const TIMESPAN FRAME_TICKS = TICKS_PER_SECOND / 30;
+
+// Every filter under test, fed the same body frames
+const int FILTER_COUNT = SmoothingFilter_Count + 1;
+const int BOXCAR = SmoothingFilter_Count;
+
+const char* filterName(int filter) {
+    return filter == BOXCAR ? "moving-average(5)" : smoothingFilterName(static_cast<SmoothingFilterType>(filter));
+}
+
+struct Series {
+    vector<TIMESPAN> time;
+    vector<float> raw;
+    vector<float> output[FILTER_COUNT];
+};
+
+class FilterSet {
+public:
+    FilterSet() {
+        for (int f = 0; f < SmoothingFilter_Count; ++f) {
+            smoothers_[f] = new JointSmoother(static_cast<SmoothingFilterType>(f));
+        }
+    }
+    ~FilterSet() {
+        for (JointSmoother* smoother : smoothers_) delete smoother;
+    }
+
+    // Runs all filters over one body frame and appends every tracked
+    // body's SpineMid Y to its series
+    void process(const BodyFrameData& frame, map<UINT64, Series>& series) {
+        for (JointSmoother* smoother : smoothers_) {
+            smoother->beginFrame(frame.relativeTime);
+            smoother->addBodies(frame);
+            smoother->endFrame();
+        }
+        boxcar_.beginFrame();
+        boxcar_.addBodies(frame);
+        boxcar_.endFrame();
+
+        for (const BodyData& body : frame.bodies) {
+            if (!body.isTracked || body.joints[JointType_SpineMid].TrackingState != TrackingState_Tracked) continue;
+            Series& s = series[body.trackingId];
+            s.time.push_back(frame.relativeTime);
+            s.raw.push_back(body.joints[JointType_SpineMid].Position.Y);
+            for (int f = 0; f < FILTER_COUNT; ++f) {
+                CameraSpacePoint p = {};
+                if (f == BOXCAR) {
+                    boxcar_.smoothed(boxcar_.slotOf(body.trackingId), JointType_SpineMid, p);
+                } else {
+                    smoothers_[f]->smoothed(smoothers_[f]->slotOf(body.trackingId), JointType_SpineMid, p);
+                }
+                s.output[f].push_back(p.Y);
+            }
+        }
+    }
+
+private:
+    JointSmoother* smoothers_[SmoothingFilter_Count];
+    JointFilterBank boxcar_;
+};
+
+// First time `values` rises through `threshold`, interpolated; -1 if never
+double firstCrossing(const vector<TIMESPAN>& time, const vector<float>& values, float threshold) {
+    for (size_t i = 1; i < values.size(); ++i) {
+        if (values[i - 1] < threshold && values[i] >= threshold) {
+            return ticksToSeconds(crossingTime(time[i - 1], values[i - 1], time[i], values[i], threshold));
+        }
+    }
+    return -1.0;
+}
+
+// Synthetic TUG start: seated 2 s, stands up 0.4 m over 1 s, stands still 2 s
+float sitToStand(double t) {
+    const double seatedY = 0.0, standingY = 0.4;
+    if (t < 2.0) return static_cast<float>(seatedY);
+    if (t < 3.0) return static_cast<float>(seatedY + (standingY - seatedY) * (1.0 - cos(3.14159265 * (t - 2.0))) / 2.0);
+    return static_cast<float>(standingY);
+}
+
+void runSynthetic() {
+    const int TRIALS = 200;
+    const int FRAMES = 150;
+    const double NOISE = 0.005;
+
+    double lagSum[FILTER_COUNT] = {}, jitterSum[FILTER_COUNT] = {}, rmsSum[FILTER_COUNT] = {};
+    int crossed[FILTER_COUNT] = {};
+    mt19937 random(1);
+    normal_distribution<double> noise(0.0, NOISE);
+
+    for (int trial = 0; trial < TRIALS; ++trial) {
+        FilterSet filters;
+        map<UINT64, Series> series;
+        vector<float> truth;
+        BodyFrameData frame;
+        frame.bodies[0].isTracked = true;
+        frame.bodies[0].trackingId = 1;
+        for (int j = 0; j < JointType_Count; ++j) {
+            frame.bodies[0].joints[j].JointType = static_cast<JointType>(j);
+            frame.bodies[0].joints[j].TrackingState = TrackingState_Tracked;
+        }
+
+        // Start at a random phase of the frame clock, so the crossing lands
+        // anywhere between two frames
+        TIMESPAN offset = static_cast<TIMESPAN>(random() % FRAME_TICKS);
+        for (int i = 0; i < FRAMES; ++i) {
+            TIMESPAN time = offset + i * FRAME_TICKS;
+            float y = sitToStand(ticksToSeconds(time));
+            truth.push_back(y);
+            frame.relativeTime = time;
+            frame.bodies[0].joints[JointType_SpineMid].Position = { 0.0f, y + static_cast<float>(noise(random)), 3.0f };
+            filters.process(frame, series);
+        }
+
+        const Series& s = series[1];
+        double truthCrossing = firstCrossing(s.time, truth, Y_CHANGE_THRESHOLD);
+        for (int f = 0; f < FILTER_COUNT; ++f) {
+            double crossing = firstCrossing(s.time, s.output[f], Y_CHANGE_THRESHOLD);
+            if (crossing >= 0.0) {
+                lagSum[f] += crossing - truthCrossing;
+                ++crossed[f];
+            }
+            double still = 0.0, all = 0.0;
+            int stillCount = 0;
+            for (size_t i = 0; i < truth.size(); ++i) {
+                double error = s.output[f][i] - truth[i];
+                all += error * error;
+                double t = ticksToSeconds(s.time[i]);
+                // Skip the first second while the filters settle
+                if ((t > 1.0 && t < 2.0) || t > 3.5) {
+                    still += error * error;
+                    ++stillCount;
+                }
+            }
+            jitterSum[f] += sqrt(still / stillCount);
+            rmsSum[f] += sqrt(all / truth.size());
+        }
+    }
+
+    cout << "Synthetic sit-to-stand, " << TRIALS << " trials, " << NOISE * 1000 << " mm noise" << endl;
+    cout << left << setw(22) << "filter" << right << setw(12) << "lag ms" << setw(14) << "jitter mm" << setw(12) << "rms mm" << endl;
+    for (int f = 0; f < FILTER_COUNT; ++f) {
+        cout << left << setw(22) << filterName(f) << right << fixed << setprecision(1);
+        if (crossed[f]) cout << setw(12) << 1000.0 * lagSum[f] / crossed[f];
+        else cout << setw(12) << "-";
+        cout << setw(14) << setprecision(2) << 1000.0 * jitterSum[f] / TRIALS
+             << setw(12) << 1000.0 * rmsSum[f] / TRIALS << endl;
+    }
+}
+
+// Output value at time t, linear between samples
+float sampleAt(const Series& s, const vector<float>& values, double t) {
+    if (t <= ticksToSeconds(s.time.front())) return values.front();
+    for (size_t i = 1; i < s.time.size(); ++i) {
+        double t1 = ticksToSeconds(s.time[i]);
+        if (t <= t1) {
+            double t0 = ticksToSeconds(s.time[i - 1]);
+            double fraction = (t - t0) / (t1 - t0);
+            return static_cast<float>(values[i - 1] + fraction * (values[i] - values[i - 1]));
+        }
+    }
+    return values.back();
+}
+
+int runReplay(const string& path) {
+    ReplayFrameSource source(0.0);
+    if (!source.open(path)) {
+        cerr << "Cannot open recording: " << path << endl;
+        return -1;
+    }
+
+    FilterSet filters;
+    map<UINT64, Series> series;
+    BodyFrameData frame;
+    size_t frames = 0;
+    while (!source.IsFinished()) {
+        if (source.AcquireLatestBodyFrame(frame) == S_OK) {
+            filters.process(frame, series);
+            ++frames;
+        }
+    }
+    if (series.empty()) {
+        cerr << "No tracked SpineMid in " << path << endl;
+        return -1;
+    }
+
+    cout << "Replay " << path << ": " << frames << " body frames, " << series.size() << " bodies" << endl;
+    cout << left << setw(22) << "filter" << right << setw(12) << "lag ms" << setw(16) << "jitter mm/f^2" << endl;
+    for (int f = 0; f < FILTER_COUNT; ++f) {
+        // Lag: shift (0..200 ms in 2 ms steps) minimizing the squared
+        // difference between the output and the delayed raw signal
+        double bestLag = 0.0, bestError = -1.0;
+        for (int step = 0; step <= 100; ++step) {
+            double lag = step * 0.002;
+            double error = 0.0;
+            for (const auto& entry : series) {
+                const Series& s = entry.second;
+                for (size_t i = 0; i < s.time.size(); ++i) {
+                    double d = s.output[f][i] - sampleAt(s, s.raw, ticksToSeconds(s.time[i]) - lag);
+                    error += d * d;
+                }
+            }
+            if (bestError < 0.0 || error < bestError) {
+                bestError = error;
+                bestLag = lag;
+            }
+        }
+
+        double acceleration = 0.0;
+        size_t count = 0;
+        for (const auto& entry : series) {
+            const vector<float>& out = entry.second.output[f];
+            for (size_t i = 2; i < out.size(); ++i) {
+                double a = out[i] - 2.0 * out[i - 1] + out[i - 2];
+                acceleration += a * a;
+                ++count;
+            }
+        }
+
+        cout << left << setw(22) << filterName(f) << right << fixed << setprecision(1)
+             << setw(12) << 1000.0 * bestLag
+             << setw(16) << setprecision(2) << (count ? 1000.0 * sqrt(acceleration / count) : 0.0) << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) return runReplay(argv[1]);
+    runSynthetic();
+    return 0;
+}
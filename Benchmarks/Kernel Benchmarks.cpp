@@ -0,0 +1,445 @@
+// Time per call of every per-frame kernel, on synthetic frames of the
+// Kinect's dimensions: 1920 x 1080 BGRA color, 512 x 424 depth and body
+// index, 6 bodies x 25 joints.
+//
+//   depth-smoothing       RingFilter<float, 3> (was getSmoothedDepth), per sample
+//   joint-filter-bank     5-frame moving average of all joints, per frame
+//   joint-smoother        One Euro on all joints, per frame
+//   euler-angles          CalculatePitch/Yaw/Roll of all joint orientations
+//   euler-angles-shared   CalculateEulerAngles, the three sharing products
+//   euler-angles-batch    EulerAngleBatch, SIMD with polynomial atan2/asin
+//   joint-angles          JointAngleEngine, the clinical angles of 6 bodies
+//   bgra-to-bgr           the per-frame conversion the programs used to do
+//   joint-color-map       one MapCameraPointsToColorSpace for all joints
+//   skeleton-draw         bones and joint markers (needs OpenCV)
+//   depth-roi-*           torso statistic with and without body index
+//   protocol-*            one frame of each test's state machine
+//
+// Each kernel is timed in batches of at least 20 ms; the median of 7 batches
+// is reported. --csv writes the results, and --baseline compares them with
+// an earlier --csv file, flagging kernels more than 10% slower. The batched
+// Euler angles are also checked against CalculatePitch/Yaw/Roll; an error
+// over EulerAngleBatch::MAX_ERROR_DEGREES fails the run.
+//
+// Usage: "Kernel Benchmarks" [--csv results.csv] [--baseline previous.csv]
+#include "../Common/DepthRoi.h"
+#include "../Common/JointColorMap.h"
+#include "../Common/JointAngles.h"
+#include "../Common/JointFilterBank.h"
+#include "../Common/JointOrientation.h"
+#include "../Common/ReplayFrameSource.h"
+#include "../Common/RingFilter.h"
+#include "../Common/TestProtocols.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#if __has_include(<opencv2/opencv.hpp>)
+#include <opencv2/opencv.hpp>
+#define KERNEL_BENCHMARKS_OPENCV 1
+#endif
+
+using namespace std;
+
+const TIMESPAN FRAME_TICKS = TICKS_PER_SECOND / 30;
+const int MOTION_FRAMES = 300; // 10 s of synthetic motion, replayed in a loop
+const int REPEATS = 7;
+const double MIN_BATCH_MS = 20.0;
+const double REGRESSION = 1.10;
+
+double checksum = 0.0; // kernel outputs, so the compiler cannot drop the work
+
+// Median ns per call of `kernel()`
+template<class Kernel>
+double nsPerCall(Kernel kernel) {
+    size_t calls = 1;
+    for (;;) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) kernel();
+        if (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= MIN_BATCH_MS) break;
+        calls *= 2;
+    }
+    vector<double> runs;
+    for (int r = 0; r < REPEATS; ++r) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) kernel();
+        runs.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / calls);
+    }
+    sort(runs.begin(), runs.end());
+    return runs[REPEATS / 2];
+}
+
+// Six people standing 2-4.5 m from the sensor. Body 0 does a Timed Up and
+// Go (sits, stands, walks to 1 m and back) and then raises its left foot for
+// a second; the others sway. Orientations are random unit quaternions.
+vector<BodyFrameData> makeBodyFrames() {
+    vector<BodyFrameData> frames(MOTION_FRAMES);
+    mt19937 random(1);
+    normal_distribution<float> noise(0.0f, 0.005f), axis(0.0f, 1.0f);
+    for (int f = 0; f < MOTION_FRAMES; ++f) {
+        BodyFrameData& frame = frames[f];
+        frame.relativeTime = f * FRAME_TICKS;
+        double t = f / 30.0;
+        for (int b = 0; b < BODY_COUNT; ++b) {
+            BodyData& body = frame.bodies[b];
+            body.isTracked = true;
+            body.trackingId = 100 + b;
+            float x = -1.25f + 0.5f * b;
+            float z = 2.0f + 0.5f * b;
+            float lift = 0.0f;
+            if (b == 0) {
+                // seated 0-2 s, up by 2.5 s, out to 1 m by 5 s, back by 8 s, seated from 8.5 s
+                lift = t < 2.0 ? -0.3f : (t < 2.5 ? static_cast<float>(-0.3 + 0.6 * (t - 2.0)) : (t < 8.0 ? 0.0f : -0.3f));
+                z = static_cast<float>(t < 2.5 ? 4.0 : (t < 5.0 ? 4.0 - 1.2 * (t - 2.5) : (t < 7.5 ? 1.0 + 1.2 * (t - 5.0) : 4.0)));
+            }
+            float sway = 0.02f * static_cast<float>(sin(2.0 * 3.14159 * 0.3 * t + b));
+            for (int j = 0; j < JointType_Count; ++j) {
+                Joint& joint = body.joints[j];
+                joint.JointType = static_cast<JointType>(j);
+                joint.TrackingState = TrackingState_Tracked;
+                bool foot = j == JointType_FootLeft || j == JointType_FootRight;
+                float height = foot ? -0.9f : 1.0f - 0.1f * (j % 8);
+                joint.Position = { x + sway + noise(random), height + lift + noise(random), z + noise(random) };
+
+                Vector4 q = { axis(random), axis(random), axis(random), axis(random) };
+                float norm = sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+                body.orientations[j].JointType = static_cast<JointType>(j);
+                body.orientations[j].Orientation = { q.x / norm, q.y / norm, q.z / norm, q.w / norm };
+            }
+            if (b == 0 && t > 8.6 && t < 9.6) body.joints[JointType_FootLeft].Position.Y += 0.2f;
+        }
+    }
+    return frames;
+}
+
+// A person at 2.5 m filling the middle of the frame in front of a 4.5 m wall
+void makeDepthFrame(DepthFrameData& depth, BodyIndexFrameData& bodyIndex) {
+    mt19937 random(2);
+    uniform_int_distribution<int> noise(-8, 8);
+    for (int y = 0; y < DEPTH_HEIGHT; ++y) {
+        for (int x = 0; x < DEPTH_WIDTH; ++x) {
+            bool head = (x - 256) * (x - 256) + (y - 90) * (y - 90) < 30 * 30;
+            bool torso = x > 196 && x < 316 && y > 115 && y < 300;
+            bool legs = ((x > 206 && x < 250) || (x > 262 && x < 306)) && y >= 300 && y < 420;
+            bool person = head || torso || legs;
+            int i = y * DEPTH_WIDTH + x;
+            depth.pixels[i] = static_cast<UINT16>((person ? 2500 : 4500) + noise(random));
+            bodyIndex.pixels[i] = person ? 0 : 255;
+        }
+    }
+}
+
+// The BGRA -> BGR copy the programs made before drawing straight onto BGRA
+void bgraToBgr(const BYTE* bgra, BYTE* bgr, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        bgr[3 * i] = bgra[4 * i];
+        bgr[3 * i + 1] = bgra[4 * i + 1];
+        bgr[3 * i + 2] = bgra[4 * i + 2];
+    }
+}
+
+// Largest difference in degrees between EulerAngleBatch and
+// CalculatePitch/Yaw/Roll over every orientation of `frames`, and over
+// rotations about one axis, through the +-90 degree yaw singularity
+double eulerAngleError(const vector<BodyFrameData>& frames) {
+    vector<BodyFrameData> batches(frames);
+    BodyFrameData axes;
+    for (int i = 0; i < BODY_COUNT * JointType_Count; ++i) {
+        double half = (-180.0 + 360.0 * i / (BODY_COUNT * JointType_Count - 1)) * 3.14159265358979 / 360.0;
+        float c = static_cast<float>(cos(half)), s = static_cast<float>(sin(half));
+        Vector4 q = i % 3 == 0 ? Vector4{ s, 0.0f, 0.0f, c } : (i % 3 == 1 ? Vector4{ 0.0f, s, 0.0f, c } : Vector4{ 0.0f, 0.0f, s, c });
+        axes.bodies[i / JointType_Count].orientations[i % JointType_Count].Orientation = q;
+    }
+    batches.push_back(axes);
+
+    EulerAngleBatch batch;
+    double maxError = 0.0;
+    auto difference = [](double a, double b) {
+        double d = fabs(a - b);
+        return d > 180.0 ? 360.0 - d : d; // +-180 are the same angle
+    };
+    for (const BodyFrameData& frame : batches) {
+        batch.setBodies(frame);
+        batch.compute();
+        for (int b = 0; b < BODY_COUNT; ++b) {
+            for (int j = 0; j < JointType_Count; ++j) {
+                const Vector4& q = frame.bodies[b].orientations[j].Orientation;
+                EulerAngles angles = batch.angles(b, static_cast<JointType>(j));
+                maxError = max({ maxError, difference(angles.pitch, CalculatePitch(q)),
+                                 difference(angles.yaw, CalculateYaw(q)), difference(angles.roll, CalculateRoll(q)) });
+            }
+        }
+    }
+    return maxError;
+}
+
+struct Result {
+    string kernel;
+    double ns;
+};
+
+map<string, double> readBaseline(const string& path) {
+    map<string, double> baseline;
+    ifstream in(path);
+    string line;
+    getline(in, line); // header
+    while (getline(in, line)) {
+        size_t comma = line.find(',');
+        if (comma != string::npos) baseline[line.substr(0, comma)] = atof(line.c_str() + comma + 1);
+    }
+    return baseline;
+}
+
+int main(int argc, char** argv) {
+    string csvPath, baselinePath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--csv") csvPath = argv[i + 1];
+        else if (arg == "--baseline") baselinePath = argv[i + 1];
+    }
+    if (argc % 2 == 0) {
+        cerr << "Usage: " << argv[0] << " [--csv results.csv] [--baseline previous.csv]" << endl;
+        return -1;
+    }
+    map<string, double> baseline;
+    if (!baselinePath.empty()) {
+        baseline = readBaseline(baselinePath);
+        if (baseline.empty()) {
+            cerr << "No results in " << baselinePath << endl;
+            return -1;
+        }
+    }
+
+    vector<BodyFrameData> bodyFrames = makeBodyFrames();
+    DepthFrameData depth;
+    BodyIndexFrameData bodyIndex;
+    makeDepthFrame(depth, bodyIndex);
+    ColorFrameData color;
+    for (size_t i = 0; i < color.bgra.size(); ++i) color.bgra.data()[i] = static_cast<BYTE>(i * 7);
+    vector<BYTE> bgr(COLOR_WIDTH * COLOR_HEIGHT * 3);
+
+    vector<Result> results;
+    bool failed = false;
+    auto run = [&](const string& kernel, double ns) {
+        results.push_back({ kernel, ns });
+        cout << left << setw(28) << kernel << right << fixed << setprecision(1) << setw(12) << ns << " ns";
+        auto it = baseline.find(kernel);
+        if (it != baseline.end() && it->second > 0.0) {
+            double ratio = ns / it->second;
+            cout << setw(12) << it->second << " ns" << showpos << setw(8) << (ratio - 1.0) * 100.0 << "%" << noshowpos;
+            if (ratio > REGRESSION) cout << "  SLOWER";
+        }
+        cout << endl;
+    };
+    int frame = 0;
+    auto nextFrame = [&]() -> const BodyFrameData& {
+        frame = (frame + 1) % MOTION_FRAMES;
+        return bodyFrames[frame];
+    };
+    TIMESPAN time = 0; // keeps increasing while the motion loops, as filters expect
+
+    // Depth smoothing, per sample
+    RingFilter<float, 3> depthFilter;
+    float depthSample = 2.0f;
+    run("depth-smoothing", nsPerCall([&] {
+        depthSample = depthSample > 6.0f ? 1.0f : depthSample + 0.01f;
+        checksum += depthFilter.push(depthSample);
+    }));
+
+    // Joint smoothing, every joint of 6 bodies per frame
+    JointFilterBank filterBank;
+    run("joint-filter-bank", nsPerCall([&] {
+        filterBank.beginFrame();
+        filterBank.addBodies(nextFrame());
+        filterBank.endFrame();
+        CameraSpacePoint p;
+        if (filterBank.smoothed(0, JointType_SpineMid, p)) checksum += p.Y;
+    }));
+
+    JointSmoother smoother(SmoothingFilter_OneEuro);
+    run("joint-smoother", nsPerCall([&] {
+        smoother.beginFrame(time += FRAME_TICKS);
+        smoother.addBodies(nextFrame());
+        smoother.endFrame();
+        CameraSpacePoint p;
+        if (smoother.smoothed(0, JointType_SpineMid, p)) checksum += p.Y;
+    }));
+
+    // Euler angles of every joint of 6 bodies
+    run("euler-angles", nsPerCall([&] {
+        const BodyFrameData& bodies = nextFrame();
+        double sum = 0.0;
+        for (const BodyData& body : bodies.bodies) {
+            for (const JointOrientation& orientation : body.orientations) {
+                sum += CalculatePitch(orientation.Orientation) + CalculateYaw(orientation.Orientation) + CalculateRoll(orientation.Orientation);
+            }
+        }
+        checksum += sum;
+    }));
+    run("euler-angles-shared", nsPerCall([&] {
+        const BodyFrameData& bodies = nextFrame();
+        double sum = 0.0;
+        for (const BodyData& body : bodies.bodies) {
+            for (const JointOrientation& orientation : body.orientations) {
+                EulerAngles angles = CalculateEulerAngles(orientation.Orientation);
+                sum += angles.pitch + angles.yaw + angles.roll;
+            }
+        }
+        checksum += sum;
+    }));
+    EulerAngleBatch eulerBatch;
+    run("euler-angles-batch", nsPerCall([&] {
+        eulerBatch.setBodies(nextFrame());
+        eulerBatch.compute();
+        checksum += eulerBatch.pitch(0, JointType_KneeLeft) + eulerBatch.yaw(3, JointType_Head) + eulerBatch.roll(5, JointType_FootRight);
+    }));
+    double eulerError = eulerAngleError(bodyFrames);
+    cout << "euler-angles-batch max error " << setprecision(5) << eulerError << " degrees";
+    if (eulerError > EulerAngleBatch::MAX_ERROR_DEGREES) {
+        cout << ", over " << EulerAngleBatch::MAX_ERROR_DEGREES << "  INACCURATE";
+        failed = true;
+    }
+    cout << endl;
+
+    JointAngleEngine jointAngles;
+    run("joint-angles", nsPerCall([&] {
+        jointAngles.beginFrame(time += FRAME_TICKS);
+        jointAngles.addBodies(nextFrame());
+        jointAngles.endFrame();
+        float knee;
+        if (jointAngles.angle(0, ClinicalAngle_KneeFlexionLeft, knee)) checksum += knee;
+    }));
+
+    // Color conversion, one 1920 x 1080 frame
+    run("bgra-to-bgr", nsPerCall([&] {
+        bgraToBgr(color.bgra.data(), bgr.data(), COLOR_WIDTH * COLOR_HEIGHT);
+        checksum += bgr[bgr.size() / 2];
+    }));
+
+    // Joint to color pixel mapping, 6 x 25 joints in one call
+    ReplayFrameSource mapper;
+    JointColorMap jointMap;
+    run("joint-color-map", nsPerCall([&] {
+        jointMap.clear();
+        jointMap.addBodies(nextFrame());
+        jointMap.map(mapper);
+        int x, y;
+        if (jointMap.pixel(0, JointType_Head, COLOR_WIDTH, COLOR_HEIGHT, x, y)) checksum += x;
+    }));
+
+#ifdef KERNEL_BENCHMARKS_OPENCV
+    cv::Mat colorMat(COLOR_HEIGHT, COLOR_WIDTH, CV_8UC4, color.bgra.data());
+    cv::Mat bgrMat;
+    run("cvtColor-bgra-to-bgr", nsPerCall([&] {
+        cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
+        checksum += bgrMat.data[0];
+    }));
+
+    // Bones and joint markers of 6 bodies, on the joint map above
+    run("skeleton-draw", nsPerCall([&] {
+        for (int b = 0; b < BODY_COUNT; ++b) {
+            forEachBone<JointGroup_Body>([&](const Bone& bone) {
+                int x1, y1, x2, y2;
+                if (jointMap.pixel(b, bone.parent, COLOR_WIDTH, COLOR_HEIGHT, x1, y1) &&
+                    jointMap.pixel(b, bone.child, COLOR_WIDTH, COLOR_HEIGHT, x2, y2)) {
+                    cv::line(colorMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 3);
+                }
+            });
+            for (int j = 0; j < JointType_Count; ++j) {
+                int x, y;
+                if (jointMap.pixel(b, static_cast<JointType>(j), COLOR_WIDTH, COLOR_HEIGHT, x, y)) {
+                    cv::circle(colorMat, cv::Point(x, y), 10, cv::Scalar(0, 0, 255), -1);
+                }
+            }
+        }
+    }));
+#else
+    cout << "(built without OpenCV: cvtColor-bgra-to-bgr and skeleton-draw skipped)" << endl;
+#endif
+
+    // Torso depth statistic; a generous budget keeps every row sampled
+    DepthRoi depthRoi(DepthStatistic_Median, 1000.0);
+    DepthRoiResult roi;
+    run("depth-roi-body-index", nsPerCall([&] {
+        depthRoi.measure(depth.pixels.data(), bodyIndex.pixels.data(), roi);
+        checksum += roi.depth;
+    }));
+    run("depth-roi-center", nsPerCall([&] {
+        depthRoi.measure(depth.pixels.data(), roi);
+        checksum += roi.depth;
+    }));
+
+    // Test state machines, one frame each, on the motion above
+    vector<unique_ptr<FramePool<BodyFrameData>>> bodyPools;
+    vector<FrameBundle> bundles(MOTION_FRAMES);
+    for (int f = 0; f < MOTION_FRAMES; ++f) {
+        if (f % FramePool<BodyFrameData>::MAX_CAPACITY == 0) {
+            bodyPools.emplace_back(new FramePool<BodyFrameData>(FramePool<BodyFrameData>::MAX_CAPACITY));
+        }
+        bundles[f].body = bodyPools.back()->lease();
+        *bundles[f].body = bodyFrames[f];
+        bundles[f].streams = FrameStream_Body;
+    }
+    vector<ProtocolEvent> events;
+    ProtocolFrame protocolFrame;
+    auto nextBundle = [&]() {
+        frame = (frame + 1) % MOTION_FRAMES;
+        protocolFrame.bundle = &bundles[frame];
+        bundles[frame].body->relativeTime = protocolFrame.relativeTime = time += FRAME_TICKS;
+    };
+
+    // A walk from 6.5 m to 0.5 m through both gates every MOTION_FRAMES frames
+    WalkingSpeedProtocol walk;
+    DepthRoiResult torso;
+    torso.pixels = 1000;
+    protocolFrame.torso = &torso;
+    run("protocol-walking-speed", nsPerCall([&] {
+        nextBundle();
+        torso.depth = 6.5f - 6.0f * static_cast<float>(frame) / MOTION_FRAMES;
+        walk.onFrame(protocolFrame, events);
+        checksum += static_cast<double>(events.size());
+        events.clear();
+    }));
+    protocolFrame.torso = nullptr;
+
+    // The TUG reads the smoothed joints, so its frame includes smoothing
+    TugProtocol tug;
+    protocolFrame.joints = &smoother;
+    run("protocol-tug", nsPerCall([&] {
+        nextBundle();
+        smoother.beginFrame(time);
+        smoother.addBodies(*protocolFrame.bundle->body);
+        smoother.endFrame();
+        tug.onFrame(protocolFrame, events);
+        checksum += static_cast<double>(events.size());
+        events.clear();
+    }));
+
+    OneLegStandProtocol oneLeg;
+    run("protocol-one-leg-stand", nsPerCall([&] {
+        nextBundle();
+        oneLeg.onFrame(protocolFrame, events);
+        checksum += static_cast<double>(events.size());
+        events.clear();
+    }));
+
+    if (!csvPath.empty()) {
+        ofstream csv(csvPath);
+        if (!csv) {
+            cerr << "Failed to open " << csvPath << " for writing" << endl;
+            return -1;
+        }
+        csv << "kernel,ns_per_call\n" << fixed << setprecision(1);
+        for (const Result& result : results) csv << result.kernel << "," << result.ns << "\n";
+    }
+
+    cout << fixed << setprecision(0) << "checksum " << checksum << endl;
+    return failed ? -1 : 0;
+}
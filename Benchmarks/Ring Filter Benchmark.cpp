@@ -0,0 +1,141 @@
+// Compares the std::deque moving average the test programs used to smooth
+// depth (push_back/pop_front plus a full std::accumulate per sample) with
+// the fixed-capacity filters in Common/RingFilter.h, and checks how far the
+// running sum drifts from an exact re-sum over a long session.
+//
+// Usage: "Ring Filter Benchmark" [samples]
+#include "../Common/RingFilter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+using namespace std;
+
+const size_t DEPTH_WINDOW = 10; // walking tests and depth measuring
+const size_t JOINT_WINDOW = 5;  // JointFilter in the skeleton smoothing program
+
+// The previous smoother, kept verbatim as the baseline
+float getSmoothedDepth(std::deque<float>& depthQueue, float newDepth, size_t windowSize) {
+    depthQueue.push_back(newDepth);
+    if (depthQueue.size() > windowSize) {
+        depthQueue.pop_front();
+    }
+    float sum = std::accumulate(depthQueue.begin(), depthQueue.end(), 0.0f);
+    return sum / depthQueue.size();
+}
+
+// Synthetic SpineMid depth: a person walking away from 1 m to 5 m and back,
+// with sensor noise and an occasional single-frame spike
+vector<float> makeDepthSignal(size_t count) {
+    vector<float> samples(count);
+    srand(1);
+    for (size_t i = 0; i < count; ++i) {
+        float phase = static_cast<float>(i % 600) / 600.0f;
+        float walk = 1.0f + 4.0f * (phase < 0.5f ? 2.0f * phase : 2.0f - 2.0f * phase);
+        float noise = (static_cast<float>(rand()) / RAND_MAX - 0.5f) * 0.02f;
+        samples[i] = walk + noise + (i % 97 == 0 ? 0.5f : 0.0f);
+    }
+    return samples;
+}
+
+// Runs `filter(sample) -> float` over every sample; returns ns per sample.
+// The outputs are summed so the compiler cannot drop the work.
+template<class Filter>
+double timePerSample(const vector<float>& samples, Filter filter, double& checksum) {
+    auto start = chrono::steady_clock::now();
+    double sum = 0.0;
+    for (float sample : samples) sum += filter(sample);
+    auto end = chrono::steady_clock::now();
+    checksum += sum;
+    return chrono::duration<double, nano>(end - start).count() / samples.size();
+}
+
+void printResult(const char* name, double nsPerSample, double baseline) {
+    cout << left << setw(34) << name << right << fixed << setprecision(2)
+         << setw(9) << nsPerSample << " ns/sample";
+    if (baseline > 0.0) cout << setw(9) << baseline / nsPerSample << "x";
+    cout << endl;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+    if (count == 0) {
+        cerr << "Usage: " << argv[0] << " [samples]" << endl;
+        return -1;
+    }
+    vector<float> samples = makeDepthSignal(count);
+    double checksum = 0.0;
+
+    cout << count << " samples" << endl;
+
+    // Depth smoothing, window 10
+    deque<float> depthQueue;
+    double dequeNs = timePerSample(samples, [&](float v) { return getSmoothedDepth(depthQueue, v, DEPTH_WINDOW); }, checksum);
+    printResult("deque + accumulate (10)", dequeNs, 0.0);
+
+    RingFilter<float, DEPTH_WINDOW> ringFilter;
+    printResult("RingFilter<float, 10>", timePerSample(samples, [&](float v) { return ringFilter.push(v); }, checksum), dequeNs);
+
+    MedianFilter<float, DEPTH_WINDOW> medianFilter;
+    printResult("MedianFilter<float, 10>", timePerSample(samples, [&](float v) { return medianFilter.push(v); }, checksum), dequeNs);
+
+    ExponentialFilter<float> exponentialFilter = ExponentialFilter<float>::forWindow(DEPTH_WINDOW);
+    printResult("ExponentialFilter<float>", timePerSample(samples, [&](float v) { return exponentialFilter.push(v); }, checksum), dequeNs);
+
+    // Joint smoothing, window 5, three axes per joint
+    deque<float> x, y, z;
+    double jointDequeNs = timePerSample(samples, [&](float v) {
+        if (x.size() >= JOINT_WINDOW) {
+            x.pop_front();
+            y.pop_front();
+            z.pop_front();
+        }
+        x.push_back(v);
+        y.push_back(v * 0.5f);
+        z.push_back(v * 0.25f);
+        float sx = 0, sy = 0, sz = 0;
+        for (size_t i = 0; i < x.size(); ++i) {
+            sx += x[i];
+            sy += y[i];
+            sz += z[i];
+        }
+        return (sx + sy + sz) / x.size();
+    }, checksum);
+    printResult("JointFilter deques (5 x 3)", jointDequeNs, 0.0);
+
+    RingFilter<float, JOINT_WINDOW> fx, fy, fz;
+    printResult("RingFilter<float, 5> x 3", timePerSample(samples, [&](float v) {
+        return fx.push(v) + fy.push(v * 0.5f) + fz.push(v * 0.25f);
+    }, checksum), jointDequeNs);
+
+    // Drift of the running sum against an exact re-sum of the final window
+    RingFilter<float, DEPTH_WINDOW> compensated;
+    float naiveSum = 0.0f;
+    deque<float> window;
+    for (float sample : samples) {
+        compensated.push(sample);
+        window.push_back(sample);
+        naiveSum += sample;
+        if (window.size() > DEPTH_WINDOW) {
+            naiveSum -= window.front();
+            window.pop_front();
+        }
+    }
+    double exact = 0.0;
+    for (float sample : window) exact += sample;
+    exact /= window.size();
+
+    cout << setprecision(7);
+    cout << "Final mean: exact " << exact
+         << ", compensated " << compensated.mean() << " (error " << scientific << fabs(compensated.mean() - exact) << ")"
+         << fixed << ", uncompensated running sum " << naiveSum / window.size()
+         << " (error " << scientific << fabs(naiveSum / window.size() - exact) << ")" << endl;
+
+    cout << fixed << setprecision(0) << "checksum " << checksum << endl;
+    return 0;
+}
@@ -0,0 +1,43 @@
+// Counts every call to the global operator new, to check that a frame loop
+// does no heap allocation once warmed up.
+//
+// This replaces the global allocation functions, so include it in exactly one
+// .cpp file of a program (the one with main()).
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+inline std::atomic<uint64_t>& heapAllocationCounter() {
+    static std::atomic<uint64_t> counter(0);
+    return counter;
+}
+
+inline uint64_t heapAllocations() {
+    return heapAllocationCounter().load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,370 @@
+// Console logging for the frame loop. A log line is formatted on the
+// caller's stack, copied into a bounded lock-free ring and written out by a
+// background thread, so logging costs the frame loop a few hundred bytes of
+// formatting and one compare-and-swap, never a console write or a flush.
+//
+//   AsyncLogger logger;                                  // stdout, drained every 10 ms
+//   LogChannel events(logger, "test");                   // every line
+//   LogChannel angles(logger, "angles", LogLevel_Debug, 250.0, 25); // 250 lines/s, bursts of 25
+//   events.info() << "Timer started! Depth: " << depth << "m";
+//
+// Lines below a channel's level are rejected before any formatting. Lines
+// over a channel's rate limit are dropped and counted; so are lines that
+// find the ring full. The counts are reported in the output about once a
+// second. Any thread may log; flush() blocks until everything logged so far
+// is written, for summaries printed with cout after the loop.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+enum LogLevel {
+    LogLevel_Debug,
+    LogLevel_Info,
+    LogLevel_Warning,
+    LogLevel_Error,
+    LogLevel_Off
+};
+
+class LogChannel;
+
+class AsyncLogger {
+public:
+    static constexpr size_t LINE_CAPACITY = 240; // longer lines are cut
+
+    // `capacity` lines in flight (rounded up to a power of two), written to
+    // `out` every `drainMs` milliseconds
+    explicit AsyncLogger(FILE* out = stdout, size_t capacity = 4096, int drainMs = 10)
+        : out_(out), drainPeriod_(drainMs) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+        drain_ = std::thread([this] { run(); });
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Writes what is still queued, then stops the drain thread
+    ~AsyncLogger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        drain_.join();
+    }
+
+    // Blocks until every line logged before the call is written; not for the frame loop
+    void flush() {
+        size_t target = enqueuePos_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (flushTarget_ < target) flushTarget_ = target;
+        wake_.notify_one();
+        flushed_.wait(lock, [&] { return written_ >= target; });
+    }
+
+    uint64_t dropped() const { return droppedTotal_.load(std::memory_order_relaxed); }
+
+private:
+    friend class LogChannel;
+    friend class LogLine;
+
+    struct Record {
+        LogLevel level;
+        uint32_t length;
+        char text[LINE_CAPACITY];
+    };
+
+    // Slot of a bounded multi-producer queue (D. Vyukov): `sequence` says
+    // whether the slot is free for the producer of a position or holds the
+    // line for the consumer
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    // Any thread; never blocks. False (and counted) when the ring is full.
+    bool push(LogLevel level, const char* text, size_t length) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (difference == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (difference < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                droppedTotal_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->record.level = level;
+        slot->record.length = static_cast<uint32_t>(length);
+        memcpy(slot->record.text, text, length);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Drain thread only
+    bool pop(std::string& batch) {
+        Slot& slot = slots_[dequeuePos_ & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) return false;
+        if (slot.record.level == LogLevel_Warning) batch += "warning: ";
+        else if (slot.record.level == LogLevel_Error) batch += "error: ";
+        batch.append(slot.record.text, slot.record.length);
+        batch += '\n';
+        slot.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+        ++dequeuePos_;
+        return true;
+    }
+
+    void run() {
+        std::string batch;
+        auto lastReport = std::chrono::steady_clock::now();
+        for (;;) {
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, drainPeriod_, [this] { return stop_ || flushTarget_ > written_; });
+                stopping = stop_;
+            }
+            while (pop(batch)) {}
+
+            auto now = std::chrono::steady_clock::now();
+            if (stopping || now - lastReport >= std::chrono::seconds(1)) {
+                report(batch);
+                lastReport = now;
+            }
+            // One write and one flush per pass, however many lines
+            if (!batch.empty()) {
+                fwrite(batch.data(), 1, batch.size(), out_);
+                fflush(out_);
+                batch.clear();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                written_ = dequeuePos_;
+            }
+            flushed_.notify_all();
+            if (stopping && slots_[dequeuePos_ & mask_].sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) return;
+        }
+    }
+
+    // Lines dropped since the last report; defined after LogChannel
+    inline void report(std::string& batch);
+    inline void reportSuppressed(LogChannel& channel, std::string& batch);
+
+    FILE* out_;
+    std::chrono::milliseconds drainPeriod_;
+    size_t mask_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<size_t> enqueuePos_{ 0 };
+    alignas(64) std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<uint64_t> droppedTotal_{ 0 };
+    alignas(64) size_t dequeuePos_ = 0; // drain thread only
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    bool stop_ = false;
+    size_t flushTarget_ = 0;
+    size_t written_ = 0;
+    std::vector<LogChannel*> channels_; // for the rate-limit report
+    std::thread drain_;
+};
+
+// Fixed-point number for a LogLine, like std::fixed << std::setprecision(digits)
+struct LogFixed {
+    double value;
+    int digits;
+};
+
+inline LogFixed logFixed(double value, int digits) {
+    return { value, digits };
+}
+
+// One line being formatted; queued when it goes out of scope, at the end of
+// the statement for `channel.info() << ...`. A line its channel rejected
+// ignores everything streamed into it.
+class LogLine {
+public:
+    LogLine(AsyncLogger* logger, LogLevel level) : logger_(logger), level_(level) {}
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    ~LogLine() {
+        if (logger_) logger_->push(level_, text_, length_);
+    }
+
+    bool active() const { return logger_ != nullptr; }
+
+    LogLine& operator<<(const char* text) {
+        if (logger_ && text) append(text, strlen(text));
+        return *this;
+    }
+
+    LogLine& operator<<(const std::string& text) {
+        if (logger_) append(text.data(), text.size());
+        return *this;
+    }
+
+    LogLine& operator<<(char c) {
+        if (logger_) append(&c, 1);
+        return *this;
+    }
+
+    LogLine& operator<<(bool value) {
+        return *this << (value ? "1" : "0");
+    }
+
+    // Integers in decimal, floating point like cout's default (%g)
+    template<class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    LogLine& operator<<(T value) {
+        if (!logger_) return *this;
+        if (std::is_floating_point<T>::value) print("%g", static_cast<double>(value));
+        else if (std::is_signed<T>::value) print("%lld", static_cast<long long>(value));
+        else print("%llu", static_cast<unsigned long long>(value));
+        return *this;
+    }
+
+    LogLine& operator<<(LogFixed number) {
+        if (logger_) print("%.*f", number.digits, number.value);
+        return *this;
+    }
+
+private:
+    void append(const char* text, size_t length) {
+        length = std::min(length, AsyncLogger::LINE_CAPACITY - length_);
+        memcpy(text_ + length_, text, length);
+        length_ += length;
+    }
+
+    template<class... Args>
+    void print(const char* format, Args... args) {
+        char number[64];
+        int length = snprintf(number, sizeof(number), format, args...);
+        if (length > 0) append(number, std::min(static_cast<size_t>(length), sizeof(number) - 1));
+    }
+
+    AsyncLogger* logger_; // null when the channel rejected the line
+    LogLevel level_;
+    size_t length_ = 0;
+    char text_[AsyncLogger::LINE_CAPACITY];
+};
+
+// A named source of log lines with its own level and rate limit. The limit
+// is a token bucket of `burst` lines refilled at `linesPerSecond` (0 = no
+// limit), kept as one atomic so any thread may log on the channel.
+class LogChannel {
+public:
+    LogChannel(AsyncLogger& logger, const char* name, LogLevel level = LogLevel_Info,
+               double linesPerSecond = 0.0, unsigned burst = 1)
+        : logger_(logger), name_(name), level_(level) {
+        setRate(linesPerSecond, burst);
+        std::lock_guard<std::mutex> lock(logger_.mutex_);
+        logger_.channels_.push_back(this);
+    }
+
+    LogChannel(const LogChannel&) = delete;
+    LogChannel& operator=(const LogChannel&) = delete;
+
+    ~LogChannel() {
+        {
+            std::lock_guard<std::mutex> lock(logger_.mutex_);
+            logger_.channels_.erase(std::find(logger_.channels_.begin(), logger_.channels_.end(), this));
+        }
+        // What the last report has not counted yet
+        std::string line;
+        logger_.reportSuppressed(*this, line);
+        if (!line.empty()) logger_.push(LogLevel_Info, line.data(), line.size() - 1);
+    }
+
+    const char* name() const { return name_; }
+
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+
+    bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // Not while other threads log on the channel
+    void setRate(double linesPerSecond, unsigned burst = 1) {
+        interval_ = linesPerSecond > 0.0 ? static_cast<int64_t>(1e9 / linesPerSecond) : 0;
+        burst_ = std::max(1u, burst);
+    }
+
+    // Level check and rate limit for `lines` lines at once, so a group of
+    // lines (every joint of a body) is logged whole or not at all. Lines
+    // admitted here are written with admitted().
+    bool admit(LogLevel level, unsigned lines = 1) {
+        if (!enabled(level)) return false;
+        if (interval_ == 0) return true;
+        // Generic cell rate algorithm: `due_` is when the bucket would be full again
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t due = due_.load(std::memory_order_relaxed);
+        for (;;) {
+            int64_t next = std::max(due, now) + interval_ * lines;
+            if (next - now > interval_ * burst_) {
+                suppressed_.fetch_add(lines, std::memory_order_relaxed);
+                return false;
+            }
+            if (due_.compare_exchange_weak(due, next, std::memory_order_relaxed)) return true;
+        }
+    }
+
+    LogLine line(LogLevel level) { return LogLine(admit(level) ? &logger_ : nullptr, level); }
+    LogLine debug() { return line(LogLevel_Debug); }
+    LogLine info() { return line(LogLevel_Info); }
+    LogLine warning() { return line(LogLevel_Warning); }
+    LogLine error() { return line(LogLevel_Error); }
+
+    // A line already let through by admit()
+    LogLine admitted(LogLevel level) { return LogLine(&logger_, level); }
+
+private:
+    friend class AsyncLogger;
+
+    AsyncLogger& logger_;
+    const char* name_;
+    std::atomic<int> level_;
+    int64_t interval_ = 0; // nanoseconds per line, 0 = no limit
+    unsigned burst_ = 1;
+    std::atomic<int64_t> due_{ 0 };
+    std::atomic<uint64_t> suppressed_{ 0 };
+};
+
+inline void AsyncLogger::report(std::string& batch) {
+    char line[128];
+    uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        snprintf(line, sizeof(line), "log: %llu lines dropped, the console fell behind\n", static_cast<unsigned long long>(dropped));
+        batch += line;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (LogChannel* channel : channels_) reportSuppressed(*channel, batch);
+}
+
+inline void AsyncLogger::reportSuppressed(LogChannel& channel, std::string& batch) {
+    uint64_t suppressed = channel.suppressed_.exchange(0, std::memory_order_relaxed);
+    if (!suppressed) return;
+    char line[128];
+    snprintf(line, sizeof(line), "log: %llu %s lines over the rate limit\n", static_cast<unsigned long long>(suppressed), channel.name_);
+    batch += line;
+}
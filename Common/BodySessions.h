@@ -0,0 +1,99 @@
+// Per-body test state. The tests used to keep one set of globals and feed
+// every tracked body into it, so a second person walking through the scene
+// corrupted the measurement. BodySessions keeps one `State` per body, keyed
+// by TrackingId through BodySlots, in a flat table of BODY_COUNT entries.
+// A session starts when its body is first tracked and ends (its state is
+// reset) on the first frame the body is missing.
+//
+//   SessionMode_Concurrent   every tracked body runs its own test, up to
+//                            BODY_COUNT at once
+//   SessionMode_SubjectLock  only the first body tracked is tested; other
+//                            bodies are ignored until it leaves
+#pragma once
+
+#include "BodySlots.h"
+#include "FrameSource.h"
+
+enum SessionMode {
+    SessionMode_Concurrent,
+    SessionMode_SubjectLock
+};
+
+template<class State>
+class BodySessions {
+public:
+    explicit BodySessions(SessionMode mode = SessionMode_Concurrent) : mode_(mode) {}
+
+    SessionMode mode() const { return mode_; }
+
+    void beginFrame() { slots_.beginFrame(); }
+
+    // Slot of the session for a body tracked this frame, starting one if the
+    // body is new. Returns -1 for a body that is not under test: every slot
+    // is taken, or another body holds the subject lock.
+    int bind(UINT64 trackingId) {
+        if (mode_ == SessionMode_SubjectLock) {
+            if (subject_ == 0) subject_ = trackingId;
+            else if (trackingId != subject_) return -1;
+        }
+        return slots_.bind(trackingId);
+    }
+
+    // Ends the sessions of bodies not bound this frame, calling
+    // `onEnd(slot, state)` before each state is reset
+    template<class OnEnd>
+    void endFrame(OnEnd onEnd) {
+        slots_.endFrame([&](int slot) {
+            onEnd(slot, states_[slot]);
+            states_[slot] = State();
+            if (slots_.trackingId(slot) == subject_) subject_ = 0;
+        });
+    }
+
+    void endFrame() {
+        endFrame([](int, State&) {});
+    }
+
+    // One pass over a body frame: `step(slot, body, state)` for every body
+    // under test, then endFrame(onEnd)
+    template<class Step, class OnEnd>
+    void update(const BodyFrameData& frame, Step step, OnEnd onEnd) {
+        beginFrame();
+        for (const BodyData& body : frame.bodies) {
+            if (!body.isTracked) continue;
+            int slot = bind(body.trackingId);
+            if (slot >= 0) step(slot, body, states_[slot]);
+        }
+        endFrame(onEnd);
+    }
+
+    template<class Step>
+    void update(const BodyFrameData& frame, Step step) {
+        update(frame, step, [](int, State&) {});
+    }
+
+    State& state(int slot) { return states_[slot]; }
+    const State& state(int slot) const { return states_[slot]; }
+
+    // Calls `f(slot, trackingId, state)` for every running session
+    template<class F>
+    void forEach(F f) const {
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            if (slots_.occupied(slot)) f(slot, slots_.trackingId(slot), states_[slot]);
+        }
+    }
+
+    int slotOf(UINT64 trackingId) const { return slots_.slotOf(trackingId); }
+
+    // TrackingId holding the subject lock, 0 when none
+    UINT64 subject() const { return subject_; }
+
+    // Session lifecycle counters
+    const BodySlots& slots() const { return slots_; }
+
+private:
+    SessionMode mode_;
+    BodySlots slots_;
+    State states_[BODY_COUNT];
+    UINT64 subject_ = 0;
+};
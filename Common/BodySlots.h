@@ -0,0 +1,85 @@
+// Binds the bodies the sensor tracks to BODY_COUNT fixed slots by
+// TrackingId, so per-body state can live in flat arrays indexed by slot.
+// A body keeps its slot while it is tracked and loses it on the first frame
+// it is missing; the slot is then free for the next body.
+#pragma once
+
+#include "KinectCompat.h"
+
+class BodySlots {
+public:
+    BodySlots() { clear(); }
+
+    void clear() {
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            trackingIds_[slot] = 0;
+            occupied_[slot] = false;
+            seen_[slot] = false;
+        }
+    }
+
+    void beginFrame() {
+        for (int slot = 0; slot < BODY_COUNT; ++slot) seen_[slot] = false;
+    }
+
+    // Slot of a body tracked this frame, binding a free slot when the body
+    // is new. Returns -1 when every slot is taken by another body.
+    int bind(UINT64 trackingId) {
+        int slot = slotOf(trackingId);
+        if (slot < 0) {
+            for (int free = 0; free < BODY_COUNT; ++free) {
+                if (!occupied_[free]) {
+                    slot = free;
+                    occupied_[slot] = true;
+                    trackingIds_[slot] = trackingId;
+                    ++bound_;
+                    break;
+                }
+            }
+        }
+        if (slot < 0) {
+            ++rejected_;
+            return -1;
+        }
+        seen_[slot] = true;
+        return slot;
+    }
+
+    // Frees the slots of bodies not bound this frame, calling
+    // `onRelease(slot)` for each before it is reused
+    template<class OnRelease>
+    void endFrame(OnRelease onRelease) {
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            if (occupied_[slot] && !seen_[slot]) {
+                onRelease(slot);
+                occupied_[slot] = false;
+                trackingIds_[slot] = 0;
+                ++released_;
+            }
+        }
+    }
+
+    // Slot bound to `trackingId`, -1 if none
+    int slotOf(UINT64 trackingId) const {
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            if (occupied_[slot] && trackingIds_[slot] == trackingId) return slot;
+        }
+        return -1;
+    }
+
+    bool occupied(int slot) const { return occupied_[slot]; }
+    UINT64 trackingId(int slot) const { return trackingIds_[slot]; }
+
+    // Lifecycle counters
+    uint64_t bound() const { return bound_; }
+    uint64_t released() const { return released_; }
+    uint64_t rejected() const { return rejected_; }
+
+private:
+    UINT64 trackingIds_[BODY_COUNT];
+    bool occupied_[BODY_COUNT];
+    bool seen_[BODY_COUNT];
+    uint64_t bound_ = 0;
+    uint64_t released_ = 0;
+    uint64_t rejected_ = 0;
+};
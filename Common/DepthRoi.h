@@ -0,0 +1,244 @@
+// Distance to the person from a region of the depth frame instead of the
+// single centre pixel. With a body-index frame the region is the torso of
+// the body standing in the middle of the view; without one it falls back to
+// the valid pixels of a small centre window. Either way the distance is a
+// robust statistic (median or interquartile mean) of a depth histogram, so
+// one noisy or missing pixel no longer moves it and the tests can use a
+// much shorter smoothing window.
+//
+// The histogram pass computes bins eight pixels at a time with SSE2 (scalar
+// elsewhere) and counts into four interleaved sub-histograms, so runs of
+// equal depths do not serialize on one counter. If a frame takes longer
+// than the time budget, later frames sample every second (up to fourth) row;
+// offline scoring sets no budget, so results do not depend on machine load.
+#pragma once
+
+#include "KinectCompat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEPTH_ROI_SSE2 1
+#endif
+
+enum DepthStatistic {
+    DepthStatistic_Median,
+    DepthStatistic_InterquartileMean
+};
+
+struct DepthRoiResult {
+    float depth = 0.0f;     // metres, 0 when no pixel qualified
+    UINT pixels = 0;        // pixels in the histogram
+    int body = -1;          // body-index value measured, -1 for the centre-window fallback
+    int rowStep = 1;        // rows sampled: every rowStep-th
+    double milliseconds = 0.0;
+};
+
+class DepthRoi {
+public:
+    static constexpr int BIN_SHIFT = 2;                       // 4 mm bins
+    static constexpr UINT16 MAX_DEPTH = 8191;                  // mm; farther is clamped and ignored
+    static constexpr int BIN_COUNT = (MAX_DEPTH >> BIN_SHIFT) + 1;
+    static constexpr int CENTER_HALF_WIDTH = 16;               // centre window, pixels each side
+
+    explicit DepthRoi(DepthStatistic statistic = DepthStatistic_Median, double budgetMs = 1.0)
+        : statistic_(statistic), budgetMs_(budgetMs) {}
+
+    // Time allowed per torso pass; 0 always samples every row
+    void setBudget(double budgetMs) {
+        budgetMs_ = budgetMs;
+        if (budgetMs_ <= 0.0) rowStep_ = 1;
+    }
+
+    // Torso of the body that covers most of the centre window: the middle
+    // 40% of its silhouette's width, from 20% to 50% of its height (below
+    // the head, above the hips). Falls back to measure(depth) when no body
+    // is in the centre window.
+    bool measure(const UINT16* depth, const BYTE* bodyIndex, DepthRoiResult& result) {
+        auto start = std::chrono::steady_clock::now();
+        int body = centerBody(bodyIndex);
+        if (body < 0) return measure(depth, result);
+
+        int left, top, right, bottom;
+        if (!bounds(bodyIndex, static_cast<BYTE>(body), left, top, right, bottom)) return measure(depth, result);
+        int width = right - left + 1, height = bottom - top + 1;
+        int x0 = left + width * 3 / 10, x1 = std::max(x0 + 1, right + 1 - width * 3 / 10);
+        int y0 = top + height / 5, y1 = std::max(y0 + 1, top + height / 2);
+
+        clearHistogram();
+        UINT pixels = accumulate(depth, bodyIndex, static_cast<BYTE>(body), x0, x1, y0, y1, rowStep_);
+        finish(start, pixels, body, result);
+        return pixels > 0;
+    }
+
+    // Centre window of valid depth pixels
+    bool measure(const UINT16* depth, DepthRoiResult& result) {
+        auto start = std::chrono::steady_clock::now();
+        int cx = DEPTH_WIDTH / 2, cy = DEPTH_HEIGHT / 2;
+        clearHistogram();
+        UINT pixels = accumulate(depth, nullptr, 0, cx - CENTER_HALF_WIDTH, cx + CENTER_HALF_WIDTH + 1,
+            cy - CENTER_HALF_WIDTH, cy + CENTER_HALF_WIDTH + 1, 1);
+        finish(start, pixels, -1, result);
+        return pixels > 0;
+    }
+
+private:
+    // Body-index value with the most pixels in the centre window, -1 if none
+    static int centerBody(const BYTE* bodyIndex) {
+        UINT counts[BODY_COUNT] = {};
+        int cx = DEPTH_WIDTH / 2, cy = DEPTH_HEIGHT / 2;
+        for (int y = cy - CENTER_HALF_WIDTH; y <= cy + CENTER_HALF_WIDTH; ++y) {
+            const BYTE* row = bodyIndex + y * DEPTH_WIDTH;
+            for (int x = cx - CENTER_HALF_WIDTH; x <= cx + CENTER_HALF_WIDTH; ++x) {
+                if (row[x] < BODY_COUNT) ++counts[row[x]];
+            }
+        }
+        int best = -1;
+        for (int body = 0; body < BODY_COUNT; ++body) {
+            if (counts[body] > 0 && (best < 0 || counts[body] > counts[best])) best = body;
+        }
+        return best;
+    }
+
+    // Bounding box of a body's silhouette
+    static bool bounds(const BYTE* bodyIndex, BYTE body, int& left, int& top, int& right, int& bottom) {
+        left = DEPTH_WIDTH;
+        right = -1;
+        top = bottom = -1;
+        for (int y = 0; y < DEPTH_HEIGHT; ++y) {
+            const BYTE* row = bodyIndex + y * DEPTH_WIDTH;
+            int first = -1, last = -1;
+            int x = 0;
+#if defined(DEPTH_ROI_SSE2)
+            const __m128i target = _mm_set1_epi8(static_cast<char>(body));
+            for (; x + 16 <= DEPTH_WIDTH; x += 16) {
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), target));
+                if (!mask) continue;
+                if (first < 0) first = x + lowestBit(mask);
+                last = x + highestBit(mask);
+            }
+#endif
+            for (; x < DEPTH_WIDTH; ++x) {
+                if (row[x] != body) continue;
+                if (first < 0) first = x;
+                last = x;
+            }
+            if (first < 0) continue;
+            if (top < 0) top = y;
+            bottom = y;
+            left = std::min(left, first);
+            right = std::max(right, last);
+        }
+        return top >= 0;
+    }
+
+    static int lowestBit(int mask) {
+        int bit = 0;
+        while (!(mask & (1 << bit))) ++bit;
+        return bit;
+    }
+
+    static int highestBit(int mask) {
+        int bit = 15;
+        while (!(mask & (1 << bit))) --bit;
+        return bit;
+    }
+
+    void clearHistogram() { memset(histogram_, 0, sizeof(histogram_)); }
+
+    // Counts the depth of every pixel in [x0, x1) x [y0, y1) whose body index
+    // is `body` (every pixel when bodyIndex is null). Invalid (0) and
+    // too-far depths land in the first and last bin, which are not counted.
+    UINT accumulate(const UINT16* depth, const BYTE* bodyIndex, BYTE body, int x0, int x1, int y0, int y1, int rowStep) {
+        for (int y = y0; y < y1; y += rowStep) {
+            const UINT16* depthRow = depth + y * DEPTH_WIDTH;
+            const BYTE* indexRow = bodyIndex ? bodyIndex + y * DEPTH_WIDTH : nullptr;
+            int x = x0;
+#if defined(DEPTH_ROI_SSE2)
+            alignas(16) UINT16 bins[8];
+            const __m128i maxDepth = _mm_set1_epi16(static_cast<short>(MAX_DEPTH));
+            const __m128i target = _mm_set1_epi16(body);
+            for (; x + 8 <= x1; x += 8) {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depthRow + x));
+                d = _mm_sub_epi16(d, _mm_subs_epu16(d, maxDepth)); // min(d, MAX_DEPTH)
+                __m128i bin = _mm_srli_epi16(d, BIN_SHIFT);
+                if (indexRow) {
+                    __m128i index = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indexRow + x)), _mm_setzero_si128());
+                    bin = _mm_and_si128(bin, _mm_cmpeq_epi16(index, target)); // other pixels -> bin 0
+                }
+                _mm_store_si128(reinterpret_cast<__m128i*>(bins), bin);
+                ++histogram_[0][bins[0]];
+                ++histogram_[1][bins[1]];
+                ++histogram_[2][bins[2]];
+                ++histogram_[3][bins[3]];
+                ++histogram_[0][bins[4]];
+                ++histogram_[1][bins[5]];
+                ++histogram_[2][bins[6]];
+                ++histogram_[3][bins[7]];
+            }
+#endif
+            for (; x < x1; ++x) {
+                if (indexRow && indexRow[x] != body) continue;
+                ++histogram_[x & 3][std::min(depthRow[x], MAX_DEPTH) >> BIN_SHIFT];
+            }
+        }
+
+        UINT pixels = 0;
+        for (int bin = 1; bin < BIN_COUNT - 1; ++bin) {
+            merged_[bin] = histogram_[0][bin] + histogram_[1][bin] + histogram_[2][bin] + histogram_[3][bin];
+            pixels += merged_[bin];
+        }
+        return pixels;
+    }
+
+    // Depth (mm, bin centre) below which `rank` of the counted pixels lie
+    float percentile(UINT rank) const {
+        UINT seen = 0;
+        for (int bin = 1; bin < BIN_COUNT - 1; ++bin) {
+            seen += merged_[bin];
+            if (seen > rank) return binCentre(bin);
+        }
+        return 0.0f;
+    }
+
+    static float binCentre(int bin) { return static_cast<float>((bin << BIN_SHIFT) + (1 << BIN_SHIFT) / 2); }
+
+    float interquartileMean(UINT pixels) const {
+        UINT low = pixels / 4, high = pixels - pixels / 4; // ranks [low, high)
+        UINT seen = 0;
+        double sum = 0.0;
+        for (int bin = 1; bin < BIN_COUNT - 1 && seen < high; ++bin) {
+            UINT first = std::max(seen, low), last = std::min(seen + merged_[bin], high);
+            if (last > first) sum += static_cast<double>(last - first) * binCentre(bin);
+            seen += merged_[bin];
+        }
+        return static_cast<float>(sum / (high - low));
+    }
+
+    void finish(std::chrono::steady_clock::time_point start, UINT pixels, int body, DepthRoiResult& result) {
+        float millimetres = 0.0f;
+        if (pixels > 0) {
+            millimetres = statistic_ == DepthStatistic_Median ? percentile(pixels / 2) : interquartileMean(pixels);
+        }
+        result.depth = millimetres * 0.001f;
+        result.pixels = pixels;
+        result.body = body;
+        result.rowStep = body >= 0 ? rowStep_ : 1;
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Keep the torso pass within budget
+        if (body >= 0 && budgetMs_ > 0.0) {
+            if (result.milliseconds > budgetMs_ && rowStep_ < 4) rowStep_ *= 2;
+            else if (result.milliseconds < budgetMs_ / 4 && rowStep_ > 1) rowStep_ /= 2;
+        }
+    }
+
+    DepthStatistic statistic_;
+    double budgetMs_;
+    int rowStep_ = 1;
+    UINT histogram_[4][BIN_COUNT];
+    UINT merged_[BIN_COUNT];
+};
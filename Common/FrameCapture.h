@@ -0,0 +1,193 @@
+// Runs frame acquisition on its own thread, so a slow imshow/waitKey in the
+// UI loop no longer stalls the sensor. Each stream is handed to consumers
+// through a CaptureChannel: a lock-free SPSC ring of pooled frames.
+//
+// Typical use: an analytics thread pop()s every depth/body frame in order at
+// sensor rate, while the UI loop calls popLatest() on the color channel and
+// renders at whatever rate it manages. Each channel counts the frames it
+// captured, dropped because its ring was full, and skipped by popLatest().
+//
+// Intended for the live sensor and real-time replay (speed > 0). A free-run
+// replay would outpace the consumers and drop frames; read it directly.
+#pragma once
+
+#include "FrameSource.h"
+#include "SpscRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+// One stream's pooled frames and the ring that carries them from the capture
+// thread to a single consumer thread
+template<class Frame, size_t RingCapacity>
+class CaptureChannel {
+public:
+    // Ring slots plus one frame being filled by the producer and two held by
+    // the consumer (the current frame and the one popLatest() is swapping in)
+    static const size_t POOL_CAPACITY = RingCapacity + 3;
+
+    // Allocates the frames; a channel that is never opened captures nothing
+    void open() {
+        pool_.reset(new FramePool<Frame>(POOL_CAPACITY));
+        overflow_.reset(new Frame());
+    }
+
+    bool isOpen() const { return pool_ != nullptr; }
+
+    // Consumer: oldest queued frame, false when none is queued
+    bool pop(FrameLease<Frame>& frame) { return ring_.tryPop(frame); }
+
+    // Consumer: like pop() but waits up to `timeout` for a frame to arrive
+    bool waitPop(FrameLease<Frame>& frame, std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!ring_.tryPop(frame)) {
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // Consumer: newest queued frame; older queued frames are released and
+    // counted as skipped. Returns false (and keeps `frame`) when none is queued.
+    bool popLatest(FrameLease<Frame>& frame) {
+        uint64_t popped = 0;
+        FrameLease<Frame> next;
+        while (ring_.tryPop(next)) {
+            frame = std::move(next);
+            ++popped;
+        }
+        if (popped > 1) skipped_.fetch_add(popped - 1, std::memory_order_relaxed);
+        return popped > 0;
+    }
+
+    bool empty() const { return ring_.empty(); }
+
+    uint64_t captured() const { return captured_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+    // Producer: acquires one frame through `acquire(Frame&) -> HRESULT` and
+    // queues it. Returns true if the source had a new frame.
+    template<class Acquire>
+    bool capture(Acquire acquire) {
+        FrameLease<Frame> frame = pool_->lease();
+
+        // The consumer is holding more frames than planned for; still take the
+        // frame from the source so the drop is counted
+        if (!frame) {
+            if (FAILED(acquire(*overflow_))) return false;
+            captured_.fetch_add(1, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (FAILED(acquire(*frame))) return false;
+        captured_.fetch_add(1, std::memory_order_relaxed);
+        if (!ring_.tryPush(frame)) dropped_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    // Declared before the ring so they outlive it: frames still queued at
+    // destruction go back to the pool when the ring is destroyed
+    std::unique_ptr<FramePool<Frame>> pool_;
+    std::unique_ptr<Frame> overflow_;
+    SpscRing<FrameLease<Frame>, RingCapacity> ring_;
+    std::atomic<uint64_t> captured_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<uint64_t> skipped_{ 0 };
+};
+
+// Analytics channels buffer about a second of frames; color only needs to
+// cover one slow render, and each frame is 8 MB
+typedef CaptureChannel<DepthFrameData, 32> DepthCaptureChannel;
+typedef CaptureChannel<BodyIndexFrameData, 32> BodyIndexCaptureChannel;
+typedef CaptureChannel<BodyFrameData, 32> BodyCaptureChannel;
+typedef CaptureChannel<ColorFrameData, 2> ColorCaptureChannel;
+
+// Owns the capture thread. While it runs, only the capture thread acquires
+// from the source; MapCameraPointsToColorSpace may still be called from
+// other threads.
+class FrameCapture {
+public:
+    explicit FrameCapture(FrameSource& source) : source_(source) {}
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    ~FrameCapture() { stop(); }
+
+    // Opens a channel for every FrameStream flag in `streams` and starts the thread
+    void start(UINT streams) {
+        if (thread_.joinable()) return;
+        if (streams & FrameStream_Depth) depth_.open();
+        if (streams & FrameStream_BodyIndex) bodyIndex_.open();
+        if (streams & FrameStream_Body) body_.open();
+        if (streams & FrameStream_Color) color_.open();
+
+        stopRequested_ = false;
+        sourceFinished_ = false;
+        thread_ = std::thread(&FrameCapture::run, this);
+    }
+
+    void stop() {
+        stopRequested_ = true;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // True once the source has been played to the end. Frames may still be
+    // queued in the channels.
+    bool sourceFinished() const { return sourceFinished_.load(std::memory_order_acquire); }
+
+    DepthCaptureChannel& depth() { return depth_; }
+    BodyIndexCaptureChannel& bodyIndex() { return bodyIndex_; }
+    BodyCaptureChannel& body() { return body_; }
+    ColorCaptureChannel& color() { return color_; }
+
+private:
+    void run() {
+#ifdef _WIN32
+        timeBeginPeriod(1); // default scheduler tick is 15.6 ms, too coarse for 1 ms polling
+#endif
+        while (!stopRequested_.load(std::memory_order_relaxed)) {
+            bool newFrame = false;
+            if (depth_.isOpen()) {
+                newFrame |= depth_.capture([this](DepthFrameData& f) { return source_.AcquireLatestDepthFrame(f); });
+            }
+            if (bodyIndex_.isOpen()) {
+                newFrame |= bodyIndex_.capture([this](BodyIndexFrameData& f) { return source_.AcquireLatestBodyIndexFrame(f); });
+            }
+            if (body_.isOpen()) {
+                newFrame |= body_.capture([this](BodyFrameData& f) { return source_.AcquireLatestBodyFrame(f); });
+            }
+            if (color_.isOpen()) {
+                newFrame |= color_.capture([this](ColorFrameData& f) { return source_.AcquireLatestColorFrame(f); });
+            }
+
+            if (!newFrame) {
+                if (source_.IsFinished()) {
+                    sourceFinished_.store(true, std::memory_order_release);
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+    FrameSource& source_;
+    DepthCaptureChannel depth_;
+    BodyIndexCaptureChannel bodyIndex_;
+    BodyCaptureChannel body_;
+    ColorCaptureChannel color_;
+    std::atomic<bool> stopRequested_{ false };
+    std::atomic<bool> sourceFinished_{ false };
+    std::thread thread_;
+};
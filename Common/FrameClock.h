@@ -0,0 +1,102 @@
+// Test timing on the sensor clock. Every frame carries the RelativeTime at
+// which the sensor captured it (a recorded session keeps it), so timers built
+// on it are free of processing and render latency, and replaying a recording
+// gives the same times on any machine.
+#pragma once
+
+#include "KinectCompat.h"
+
+#include <algorithm>
+#include <cmath>
+
+inline double ticksToSeconds(TIMESPAN ticks) {
+    return static_cast<double>(ticks) / TICKS_PER_SECOND;
+}
+
+// When a signal sampled at two consecutive frames crossed `threshold`,
+// assuming it moved linearly in between. Returns `time` when the samples do
+// not straddle the threshold, or when there is no previous sample (pass
+// previousTime == time), so the event falls back to the frame it was detected on.
+inline TIMESPAN crossingTime(TIMESPAN previousTime, float previousValue, TIMESPAN time, float value, float threshold) {
+    if (previousTime >= time || previousValue == value) return time;
+    if ((previousValue - threshold) * (value - threshold) > 0.0f) return time;
+
+    double fraction = (static_cast<double>(threshold) - previousValue) / (static_cast<double>(value) - previousValue);
+    if (fraction < 0.0) fraction = 0.0;
+    if (fraction > 1.0) fraction = 1.0;
+    return previousTime + static_cast<TIMESPAN>(std::llround(fraction * static_cast<double>(time - previousTime)));
+}
+
+// Crossing time of whichever edge of [low, high] the signal entered through
+inline TIMESPAN bandEntryTime(TIMESPAN previousTime, float previousValue, TIMESPAN time, float value, float low, float high) {
+    float edge = previousValue > high ? high : low;
+    return crossingTime(previousTime, previousValue, time, value, edge);
+}
+
+// When `value < limit` started to hold: `previousTime` if it already held at
+// the previous frame, else the interpolated crossing. The latest onset among
+// several conditions is when all of them became true.
+inline TIMESPAN belowOnsetTime(TIMESPAN previousTime, float previousValue, TIMESPAN time, float value, float limit) {
+    return previousValue < limit ? previousTime : crossingTime(previousTime, previousValue, time, value, limit);
+}
+
+// When `value > limit` started to hold, see belowOnsetTime()
+inline TIMESPAN aboveOnsetTime(TIMESPAN previousTime, float previousValue, TIMESPAN time, float value, float limit) {
+    return previousValue > limit ? previousTime : crossingTime(previousTime, previousValue, time, value, limit);
+}
+
+// When `a > limitA || b > limitB` started to hold: the earlier crossing
+inline TIMESPAN eitherAboveOnsetTime(TIMESPAN previousTime, float previousA, float previousB,
+    TIMESPAN time, float a, float b, float limitA, float limitB) {
+    if (previousA > limitA || previousB > limitB) return previousTime;
+    TIMESPAN onset = time;
+    if (a > limitA) onset = std::min(onset, crossingTime(previousTime, previousA, time, a, limitA));
+    if (b > limitB) onset = std::min(onset, crossingTime(previousTime, previousB, time, b, limitB));
+    return onset;
+}
+
+// When `a < limitA && b < limitB` started to hold: the later onset
+inline TIMESPAN bothBelowOnsetTime(TIMESPAN previousTime, float previousA, float previousB,
+    TIMESPAN time, float a, float b, float limitA, float limitB) {
+    return std::max(belowOnsetTime(previousTime, previousA, time, a, limitA),
+                    belowOnsetTime(previousTime, previousB, time, b, limitB));
+}
+
+// Start/stop timer driven by frame timestamps
+class FrameTimer {
+public:
+    void start(TIMESPAN time) {
+        startTime_ = time;
+        running_ = true;
+    }
+
+    // Returns the final elapsed time in seconds
+    double stop(TIMESPAN time) {
+        finalSeconds_ = ticksToSeconds(time - startTime_);
+        running_ = false;
+        return finalSeconds_;
+    }
+
+    void reset() {
+        running_ = false;
+        finalSeconds_ = 0.0;
+    }
+
+    bool isRunning() const { return running_; }
+    TIMESPAN startTime() const { return startTime_; }
+
+    // Seconds from the start to `now` while running (never negative, as the
+    // start may be interpolated past the frame on screen), otherwise the
+    // final time (0 if never stopped)
+    double elapsedSeconds(TIMESPAN now) const {
+        if (!running_) return finalSeconds_;
+        return now > startTime_ ? ticksToSeconds(now - startTime_) : 0.0;
+    }
+
+    double finalSeconds() const { return finalSeconds_; }
+
+private:
+    TIMESPAN startTime_ = 0;
+    double finalSeconds_ = 0.0;
+    bool running_ = false;
+};
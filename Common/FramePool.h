@@ -0,0 +1,206 @@
+// Preallocated, cache-line aligned frame buffers that are leased to the frame
+// loop and handed back when the lease goes out of scope, so steady-state
+// acquisition does no heap allocation.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+const size_t FRAME_BUFFER_ALIGNMENT = 64;
+
+// Fixed-size byte buffer aligned for SIMD loads. Copying reuses the existing
+// allocation when the sizes match.
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(size_t size) { allocate(size); }
+
+    AlignedBuffer(const AlignedBuffer& other) {
+        allocate(other.size_);
+        if (size_) memcpy(data_, other.data_, size_);
+    }
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept { swap(other); }
+
+    AlignedBuffer& operator=(const AlignedBuffer& other) {
+        if (this != &other) {
+            if (size_ != other.size_) {
+                release();
+                allocate(other.size_);
+            }
+            if (size_) memcpy(data_, other.data_, size_);
+        }
+        return *this;
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~AlignedBuffer() { release(); }
+
+    void swap(AlignedBuffer& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    unsigned char* data() { return data_; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Buffers allocated since program start, across all AlignedBuffers
+    static uint64_t allocations() { return allocationCounter().load(std::memory_order_relaxed); }
+
+private:
+    static std::atomic<uint64_t>& allocationCounter() {
+        static std::atomic<uint64_t> counter(0);
+        return counter;
+    }
+
+    void allocate(size_t size) {
+        size_ = size;
+        if (!size) return;
+
+        size_t rounded = (size + FRAME_BUFFER_ALIGNMENT - 1) / FRAME_BUFFER_ALIGNMENT * FRAME_BUFFER_ALIGNMENT;
+#ifdef _WIN32
+        data_ = static_cast<unsigned char*>(_aligned_malloc(rounded, FRAME_BUFFER_ALIGNMENT));
+#else
+        data_ = static_cast<unsigned char*>(std::aligned_alloc(FRAME_BUFFER_ALIGNMENT, rounded));
+#endif
+        if (!data_) throw std::bad_alloc();
+        allocationCounter().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+#ifdef _WIN32
+        _aligned_free(data_);
+#else
+        std::free(data_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+inline void swap(AlignedBuffer& a, AlignedBuffer& b) noexcept { a.swap(b); }
+
+template<class T>
+class FramePool;
+
+// Exclusive use of one pooled frame; returns it to the pool when destroyed
+template<class T>
+class FrameLease {
+public:
+    FrameLease() = default;
+    FrameLease(const FrameLease&) = delete;
+    FrameLease& operator=(const FrameLease&) = delete;
+
+    FrameLease(FrameLease&& other) noexcept
+        : pool_(other.pool_), slot_(other.slot_) {
+        other.pool_ = nullptr;
+    }
+
+    FrameLease& operator=(FrameLease&& other) noexcept {
+        if (this != &other) {
+            reset();
+            pool_ = other.pool_;
+            slot_ = other.slot_;
+            other.pool_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~FrameLease() { reset(); }
+
+    explicit operator bool() const { return pool_ != nullptr; }
+    T& operator*() const { return pool_->frames_[slot_]; }
+    T* operator->() const { return &pool_->frames_[slot_]; }
+    T* get() const { return pool_ ? &pool_->frames_[slot_] : nullptr; }
+
+    void reset() {
+        if (pool_) {
+            pool_->giveBack(slot_);
+            pool_ = nullptr;
+        }
+    }
+
+private:
+    friend class FramePool<T>;
+    FrameLease(FramePool<T>* pool, size_t slot) : pool_(pool), slot_(slot) {}
+
+    FramePool<T>* pool_ = nullptr;
+    size_t slot_ = 0;
+};
+
+// Fixed set of up to 64 frames, all constructed up front. Leasing and
+// returning are lock-free, so the pool can be shared between an acquisition
+// thread and the UI thread. The pool must outlive its leases.
+template<class T>
+class FramePool {
+public:
+    static constexpr size_t MAX_CAPACITY = 64;
+
+    explicit FramePool(size_t capacity)
+        : frames_(new T[std::min(std::max<size_t>(capacity, 1), MAX_CAPACITY)]),
+          capacity_(std::min(std::max<size_t>(capacity, 1), MAX_CAPACITY)),
+          freeMask_(capacity_ == 64 ? ~0ull : (1ull << capacity_) - 1) {}
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Empty lease when every frame is in use
+    FrameLease<T> lease() {
+        uint64_t mask = freeMask_.load(std::memory_order_acquire);
+        while (mask) {
+            uint64_t lowest = mask & (~mask + 1);
+            if (freeMask_.compare_exchange_weak(mask, mask & ~lowest, std::memory_order_acq_rel)) {
+                leases_.fetch_add(1, std::memory_order_relaxed);
+                return FrameLease<T>(this, bitIndex(lowest));
+            }
+        }
+        exhausted_.fetch_add(1, std::memory_order_relaxed);
+        return FrameLease<T>();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    size_t available() const {
+        uint64_t mask = freeMask_.load(std::memory_order_relaxed);
+        size_t count = 0;
+        for (; mask; mask &= mask - 1) ++count;
+        return count;
+    }
+
+    uint64_t leaseCount() const { return leases_.load(std::memory_order_relaxed); }
+    uint64_t exhaustedCount() const { return exhausted_.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameLease<T>;
+
+    static size_t bitIndex(uint64_t bit) {
+        size_t index = 0;
+        while (bit >>= 1) ++index;
+        return index;
+    }
+
+    void giveBack(size_t slot) {
+        freeMask_.fetch_or(1ull << slot, std::memory_order_release);
+    }
+
+    std::unique_ptr<T[]> frames_;
+    size_t capacity_;
+    std::atomic<uint64_t> freeMask_;
+    std::atomic<uint64_t> leases_{ 0 };
+    std::atomic<uint64_t> exhausted_{ 0 };
+};
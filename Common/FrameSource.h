@@ -0,0 +1,64 @@
+// Backend-neutral frame types and the acquire-latest-frame contract shared by
+// the live Kinect backend (KinectFrameSource.h) and the recorded-session
+// backend (ReplayFrameSource.h).
+#pragma once
+
+#include "KinectCompat.h"
+#include "FramePool.h"
+
+#include <vector>
+
+struct DepthFrameData {
+    TIMESPAN relativeTime = 0;
+    std::vector<UINT16> pixels = std::vector<UINT16>(DEPTH_WIDTH * DEPTH_HEIGHT); // millimetres
+};
+
+struct BodyIndexFrameData {
+    TIMESPAN relativeTime = 0;
+    std::vector<BYTE> pixels = std::vector<BYTE>(DEPTH_WIDTH * DEPTH_HEIGHT); // 0..5 = body slot, 255 = background
+};
+
+struct ColorFrameData {
+    TIMESPAN relativeTime = 0;
+    AlignedBuffer bgra = AlignedBuffer(COLOR_WIDTH * COLOR_HEIGHT * 4);
+};
+
+struct BodyData {
+    UINT64 trackingId = 0;
+    bool isTracked = false;
+    Joint joints[JointType_Count] = {};
+    JointOrientation orientations[JointType_Count] = {};
+};
+
+struct BodyFrameData {
+    TIMESPAN relativeTime = 0;
+    BodyData bodies[BODY_COUNT];
+};
+
+// Stream flags, used both to open a source and in the session file header
+enum FrameStream : UINT {
+    FrameStream_Depth = 0x1,
+    FrameStream_BodyIndex = 0x2,
+    FrameStream_Body = 0x4,
+    FrameStream_Color = 0x8
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // Each call copies the newest frame into `frame` and returns S_OK, or
+    // returns E_PENDING when there is nothing newer than the last frame
+    // handed out - the same contract as IxxxFrameReader::AcquireLatestFrame.
+    virtual HRESULT AcquireLatestDepthFrame(DepthFrameData& frame) = 0;
+    virtual HRESULT AcquireLatestBodyIndexFrame(BodyIndexFrameData& frame) = 0;
+    virtual HRESULT AcquireLatestBodyFrame(BodyFrameData& frame) = 0;
+    virtual HRESULT AcquireLatestColorFrame(ColorFrameData& frame) = 0;
+
+    // Same signature as ICoordinateMapper::MapCameraPointsToColorSpace
+    virtual HRESULT MapCameraPointsToColorSpace(UINT cameraPointCount, const CameraSpacePoint* cameraPoints,
+        UINT colorPointCount, ColorSpacePoint* colorPoints) = 0;
+
+    // True once a recorded session has been played to the end; a live sensor never finishes
+    virtual bool IsFinished() const { return false; }
+};
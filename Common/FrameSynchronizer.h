@@ -0,0 +1,339 @@
+// Groups depth, body index, body and color frames that were captured together
+// into one FrameBundle by matching their RelativeTime, so an overlay is always
+// drawn on the color frame its skeleton came from.
+//
+// Every frame of the anchor stream starts a bundle. Each other stream
+// contributes the frame closest in time to the anchor, if it is within the
+// tolerance. A bundle is handed out once no later frame could match better,
+// or after maxWait of anchor time when a stream has stalled. Kinect v2 stamps
+// depth, body index and body identically; color differs by a few ms and drops
+// to 15 fps in low light, which is what the missing-stream policy is for.
+#pragma once
+
+#include "FrameCapture.h"
+
+#include <chrono>
+#include <cstdlib>
+
+enum MissingStreamPolicy {
+    MissingStream_Drop,    // discard an anchor frame when any stream has no match
+    MissingStream_Partial  // hand out the bundle with the unmatched streams empty
+};
+
+struct FrameBundle {
+    TIMESPAN relativeTime = 0; // time of the anchor frame
+    UINT streams = 0;          // FrameStream flags of the frames present
+    FrameLease<DepthFrameData> depth;
+    FrameLease<BodyIndexFrameData> bodyIndex;
+    FrameLease<BodyFrameData> body;
+    FrameLease<ColorFrameData> color;
+
+    bool has(FrameStream stream) const { return (streams & stream) != 0; }
+};
+
+// Frames of one stream waiting for an anchor, oldest first
+template<class Frame>
+class PendingFrames {
+public:
+    static const size_t CAPACITY = 4;
+
+    size_t size() const { return count_; }
+    TIMESPAN time(size_t i) const { return frames_[i]->relativeTime; }
+    std::chrono::steady_clock::time_point arrival(size_t i) const { return arrivals_[i]; }
+
+    // Newest time ever pushed; frames arrive in time order per stream
+    TIMESPAN newestTime() const { return newestTime_; }
+    bool received() const { return received_; }
+
+    // Appends `frame`; returns how many old frames were evicted to make room
+    size_t push(FrameLease<Frame>& frame) {
+        size_t evicted = 0;
+        if (count_ == CAPACITY) evicted = removeFront(1);
+        newestTime_ = frame->relativeTime;
+        received_ = true;
+        arrivals_[count_] = std::chrono::steady_clock::now();
+        frames_[count_++] = std::move(frame);
+        return evicted;
+    }
+
+    // Index of the frame closest to `time` within `tolerance`, or -1
+    int closest(TIMESPAN time, TIMESPAN tolerance) const {
+        int best = -1;
+        TIMESPAN bestDistance = tolerance;
+        for (size_t i = 0; i < count_; ++i) {
+            TIMESPAN distance = std::llabs(this->time(i) - time);
+            if (distance <= bestDistance) {
+                best = static_cast<int>(i);
+                bestDistance = distance;
+            }
+        }
+        return best;
+    }
+
+    // Removes frame `i` into `frame`; returns how many older frames were discarded
+    size_t take(size_t i, FrameLease<Frame>& frame) {
+        size_t discarded = removeFront(i);
+        frame = std::move(frames_[0]);
+        removeFront(1);
+        return discarded;
+    }
+
+    // Discards frames older than `time`; returns how many
+    size_t discardBefore(TIMESPAN time) {
+        size_t n = 0;
+        while (n < count_ && this->time(n) < time) ++n;
+        return removeFront(n);
+    }
+
+    size_t removeFront(size_t n) {
+        for (size_t i = n; i < count_; ++i) {
+            frames_[i - n] = std::move(frames_[i]);
+            arrivals_[i - n] = arrivals_[i];
+        }
+        for (size_t i = count_ - n; i < count_; ++i) frames_[i].reset();
+        count_ -= n;
+        return n;
+    }
+
+private:
+    FrameLease<Frame> frames_[CAPACITY];
+    std::chrono::steady_clock::time_point arrivals_[CAPACITY];
+    size_t count_ = 0;
+    TIMESPAN newestTime_ = 0;
+    bool received_ = false;
+};
+
+struct SyncStreamStats {
+    uint64_t matched = 0;   // frames handed out in a bundle
+    uint64_t unmatched = 0; // frames discarded without a bundle
+    double skewSumMs = 0.0; // sum of |frame time - anchor time| over matched frames
+    double maxSkewMs = 0.0;
+
+    double meanSkewMs() const { return matched ? skewSumMs / matched : 0.0; }
+};
+
+class FrameSynchronizer {
+public:
+    // Frames pooled for poll(FrameSource&): the pending frames, up to two
+    // bundles the caller holds (the current one and one kept for display)
+    // and the one being acquired
+    static const size_t POOL_CAPACITY = PendingFrames<DepthFrameData>::CAPACITY + 3;
+
+    // `streams` are the FrameStream flags to bundle, `anchor` one of them.
+    // The default tolerance is half a frame at 30 fps.
+    FrameSynchronizer(UINT streams, FrameStream anchor, MissingStreamPolicy policy,
+        TIMESPAN tolerance = TICKS_PER_SECOND / 60, TIMESPAN maxWait = TICKS_PER_SECOND / 10)
+        : streams_(streams | anchor), anchor_(anchor), policy_(policy), tolerance_(tolerance), maxWait_(maxWait) {}
+
+    FrameSynchronizer(const FrameSynchronizer&) = delete;
+    FrameSynchronizer& operator=(const FrameSynchronizer&) = delete;
+
+    void push(FrameLease<DepthFrameData>& frame) { pushTo(FrameStream_Depth, depth_, frame); }
+    void push(FrameLease<BodyIndexFrameData>& frame) { pushTo(FrameStream_BodyIndex, bodyIndex_, frame); }
+    void push(FrameLease<BodyFrameData>& frame) { pushTo(FrameStream_Body, body_, frame); }
+    void push(FrameLease<ColorFrameData>& frame) { pushTo(FrameStream_Color, color_, frame); }
+
+    // Acquires every new frame of the bundled streams from `source`
+    void poll(FrameSource& source) {
+        if (streams_ & FrameStream_Depth) acquireFrom(depthPool_, [&](DepthFrameData& f) { return source.AcquireLatestDepthFrame(f); });
+        if (streams_ & FrameStream_BodyIndex) acquireFrom(bodyIndexPool_, [&](BodyIndexFrameData& f) { return source.AcquireLatestBodyIndexFrame(f); });
+        if (streams_ & FrameStream_Body) acquireFrom(bodyPool_, [&](BodyFrameData& f) { return source.AcquireLatestBodyFrame(f); });
+        if (streams_ & FrameStream_Color) acquireFrom(colorPool_, [&](ColorFrameData& f) { return source.AcquireLatestColorFrame(f); });
+    }
+
+    // Pops queued frames of the bundled streams from a capture thread, as
+    // many as fit in the pending queues. The rest stay in the capture rings
+    // for the next poll, so call pop() until it fails between polls; a backlog
+    // is handed out in full and in order instead of being evicted.
+    void poll(FrameCapture& capture) {
+        if (streams_ & FrameStream_Depth) drain(capture.depth(), depth_);
+        if (streams_ & FrameStream_BodyIndex) drain(capture.bodyIndex(), bodyIndex_);
+        if (streams_ & FrameStream_Body) drain(capture.body(), body_);
+        if (streams_ & FrameStream_Color) drain(capture.color(), color_);
+    }
+
+    // Next complete bundle, oldest first. Frames the bundle held before are
+    // returned to their pools.
+    bool pop(FrameBundle& bundle) {
+        while (pendingAnchors() > 0) {
+            TIMESPAN anchorTime = anchorFrameTime(0);
+            if (!ready(anchorTime)) return false;
+
+            // Frames too old for this anchor are too old for every later one
+            bool complete = true;
+            forEachPending([&](FrameStream stream, auto& pending) {
+                if (stream == anchor_ || !(streams_ & stream)) return;
+                stats_[streamIndex(stream)].unmatched += pending.discardBefore(anchorTime - tolerance_);
+                if (pending.closest(anchorTime, tolerance_) < 0) complete = false;
+            });
+
+            if (!complete && policy_ == MissingStream_Drop) {
+                discardAnchor();
+                ++droppedBundles_;
+                continue;
+            }
+
+            emit(anchorTime, bundle);
+            if (!complete) ++partialBundles_;
+            return true;
+        }
+        return false;
+    }
+
+    // End of input: stop waiting for later frames so the remaining anchors
+    // can be popped with whatever has arrived
+    void flush() { flushing_ = true; }
+
+    uint64_t bundles() const { return bundles_; }
+    uint64_t partialBundles() const { return partialBundles_; }
+    uint64_t droppedBundles() const { return droppedBundles_; }
+    const SyncStreamStats& stats(FrameStream stream) const { return stats_[streamIndex(stream)]; }
+
+    // Wall-clock time from the anchor frame's arrival to its bundle being popped
+    double meanPairingLatencyMs() const { return bundles_ ? latencySumMs_ / bundles_ : 0.0; }
+    double maxPairingLatencyMs() const { return maxLatencyMs_; }
+
+private:
+    static size_t streamIndex(FrameStream stream) {
+        size_t index = 0;
+        for (UINT bit = stream; bit > 1; bit >>= 1) ++index;
+        return index;
+    }
+
+    template<class F>
+    void forEachPending(F f) {
+        f(FrameStream_Depth, depth_);
+        f(FrameStream_BodyIndex, bodyIndex_);
+        f(FrameStream_Body, body_);
+        f(FrameStream_Color, color_);
+    }
+
+    template<class F>
+    void forEachStream(FrameBundle& bundle, F f) {
+        f(FrameStream_Depth, depth_, bundle.depth);
+        f(FrameStream_BodyIndex, bodyIndex_, bundle.bodyIndex);
+        f(FrameStream_Body, body_, bundle.body);
+        f(FrameStream_Color, color_, bundle.color);
+    }
+
+    template<class Frame>
+    void pushTo(FrameStream stream, PendingFrames<Frame>& pending, FrameLease<Frame>& frame) {
+        if (!frame || !(streams_ & stream)) return;
+        stats_[streamIndex(stream)].unmatched += pending.push(frame);
+        if (stream == anchor_) newestAnchorTime_ = pending.newestTime();
+    }
+
+    template<class Frame, class Acquire>
+    void acquireFrom(std::unique_ptr<FramePool<Frame>>& pool, Acquire acquire) {
+        if (!pool) pool.reset(new FramePool<Frame>(POOL_CAPACITY));
+        FrameLease<Frame> frame = pool->lease();
+        if (frame && SUCCEEDED(acquire(*frame))) push(frame);
+    }
+
+    template<class Frame, size_t RingCapacity>
+    void drain(CaptureChannel<Frame, RingCapacity>& channel, const PendingFrames<Frame>& pending) {
+        FrameLease<Frame> frame;
+        while (pending.size() < PendingFrames<Frame>::CAPACITY && channel.pop(frame)) push(frame);
+    }
+
+    size_t pendingAnchors() {
+        size_t count = 0;
+        forEachPending([&](FrameStream stream, auto& pending) {
+            if (stream == anchor_) count = pending.size();
+        });
+        return count;
+    }
+
+    TIMESPAN anchorFrameTime(size_t i) {
+        TIMESPAN time = 0;
+        forEachPending([&](FrameStream stream, auto& pending) {
+            if (stream == anchor_) time = pending.time(i);
+        });
+        return time;
+    }
+
+    // True when no frame still to come could match `anchorTime` better
+    bool ready(TIMESPAN anchorTime) {
+        if (flushing_ || newestAnchorTime_ >= anchorTime + maxWait_) return true;
+
+        // Waiting any longer would evict the anchor at the next push
+        if (pendingAnchors() == PendingFrames<DepthFrameData>::CAPACITY) return true;
+
+        bool allReady = true;
+        forEachPending([&](FrameStream stream, auto& pending) {
+            if (stream == anchor_ || !(streams_ & stream)) return;
+            // A full queue takes no more frames until this anchor is popped
+            if (pending.size() == PendingFrames<DepthFrameData>::CAPACITY) return;
+            int best = pending.closest(anchorTime, tolerance_);
+            TIMESPAN needed = best >= 0 ? std::llabs(pending.time(best) - anchorTime) : tolerance_;
+            if (!pending.received() || pending.newestTime() < anchorTime + needed) allReady = false;
+        });
+        return allReady;
+    }
+
+    void discardAnchor() {
+        forEachPending([&](FrameStream stream, auto& pending) {
+            if (stream == anchor_) stats_[streamIndex(stream)].unmatched += pending.removeFront(1);
+        });
+    }
+
+    void emit(TIMESPAN anchorTime, FrameBundle& bundle) {
+        bundle.relativeTime = anchorTime;
+        bundle.streams = 0;
+        auto now = std::chrono::steady_clock::now();
+
+        forEachStream(bundle, [&](FrameStream stream, auto& pending, auto& slot) {
+            slot.reset();
+            if (!(streams_ & stream)) return;
+
+            SyncStreamStats& stats = stats_[streamIndex(stream)];
+            int best = stream == anchor_ ? 0 : pending.closest(anchorTime, tolerance_);
+            if (best < 0) return;
+
+            if (stream == anchor_) {
+                double latencyMs = std::chrono::duration<double, std::milli>(now - pending.arrival(0)).count();
+                latencySumMs_ += latencyMs;
+                if (latencyMs > maxLatencyMs_) maxLatencyMs_ = latencyMs;
+            }
+
+            double skewMs = ticksToMs(std::llabs(pending.time(best) - anchorTime));
+            stats.unmatched += pending.take(static_cast<size_t>(best), slot);
+            stats.matched += 1;
+            stats.skewSumMs += skewMs;
+            if (skewMs > stats.maxSkewMs) stats.maxSkewMs = skewMs;
+            bundle.streams |= stream;
+        });
+        ++bundles_;
+    }
+
+    static double ticksToMs(TIMESPAN ticks) {
+        return static_cast<double>(ticks) * 1000.0 / TICKS_PER_SECOND;
+    }
+
+    UINT streams_;
+    FrameStream anchor_;
+    MissingStreamPolicy policy_;
+    TIMESPAN tolerance_;
+    TIMESPAN maxWait_;
+    bool flushing_ = false;
+    TIMESPAN newestAnchorTime_ = 0;
+
+    // Declared before the pending queues so they outlive them: frames still
+    // pending at destruction go back to these pools
+    std::unique_ptr<FramePool<DepthFrameData>> depthPool_;
+    std::unique_ptr<FramePool<BodyIndexFrameData>> bodyIndexPool_;
+    std::unique_ptr<FramePool<BodyFrameData>> bodyPool_;
+    std::unique_ptr<FramePool<ColorFrameData>> colorPool_;
+
+    PendingFrames<DepthFrameData> depth_;
+    PendingFrames<BodyIndexFrameData> bodyIndex_;
+    PendingFrames<BodyFrameData> body_;
+    PendingFrames<ColorFrameData> color_;
+
+    SyncStreamStats stats_[4];
+    uint64_t bundles_ = 0;
+    uint64_t partialBundles_ = 0;
+    uint64_t droppedBundles_ = 0;
+    double latencySumMs_ = 0.0;
+    double maxLatencyMs_ = 0.0;
+};
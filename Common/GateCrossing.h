@@ -0,0 +1,97 @@
+// Start and stop gates for timed walks. The walking tests used to start the
+// timer only while the smoothed depth was inside a 1 cm window in front of a
+// gate, but a walker covers about 4 cm per frame at 30 Hz, so the window was
+// often stepped over and the timer silently never started or stopped.
+//
+// A GateCrossing instead watches the distance pass the gate in the walking
+// direction. It fires once the subject is `hysteresis` past the gate, and
+// only after having been `hysteresis` in front of it, so noise around the
+// gate distance cannot fire it twice or fire it backwards. The reported time
+// is interpolated between the samples on either side of the gate; if noise
+// made the signal cross more than once, it is the midpoint of the first and
+// last crossing.
+#pragma once
+
+#include "FrameClock.h"
+
+#include <cmath>
+
+enum GateDirection {
+    GateDirection_Approaching, // walking towards the sensor, distance falling
+    GateDirection_Receding     // walking away, distance rising
+};
+
+// Direction of a walk from the start gate to the stop gate
+inline GateDirection gateDirection(float startDistance, float stopDistance) {
+    return stopDistance < startDistance ? GateDirection_Approaching : GateDirection_Receding;
+}
+
+struct GateParams {
+    float hysteresis = 0.05f; // m each side of the gate to arm and to fire
+    float maxStep = 0.5f;     // m; a larger jump between samples (subject lost or replaced) restarts the gate
+};
+
+class GateCrossing {
+public:
+    GateCrossing(float distance, GateDirection direction, const GateParams& params = GateParams())
+        : distance_(distance), direction_(direction), params_(params) {}
+
+    // Feeds one distance sample (metres) taken at `time`. Returns true when
+    // the subject has passed the gate, with `crossing` set to when it
+    // reached the gate distance.
+    bool update(TIMESPAN time, float distance, TIMESPAN& crossing) {
+        float progress = direction_ == GateDirection_Approaching ? distance_ - distance : distance - distance_;
+        bool fired = false;
+
+        if (!hasPrevious_ || std::fabs(progress - previousProgress_) > params_.maxStep) {
+            // First sample, or the signal broke: nothing to interpolate over
+            armed_ = progress <= -params_.hysteresis;
+            hasCrossing_ = false;
+        } else if (armed_) {
+            if (previousProgress_ < 0.0f && progress >= 0.0f) {
+                TIMESPAN t = crossingTime(previousTime_, previousProgress_, time, progress, 0.0f);
+                if (!hasCrossing_) firstCrossing_ = t;
+                lastCrossing_ = t;
+                hasCrossing_ = true;
+            }
+            if (progress >= params_.hysteresis && hasCrossing_) {
+                crossing = firstCrossing_ + (lastCrossing_ - firstCrossing_) / 2;
+                armed_ = false;
+                hasCrossing_ = false;
+                fired = true;
+            } else if (progress <= -params_.hysteresis) {
+                hasCrossing_ = false; // backed off: only the next approach counts
+            }
+        } else if (progress <= -params_.hysteresis) {
+            armed_ = true;
+        }
+
+        previousTime_ = time;
+        previousProgress_ = progress;
+        hasPrevious_ = true;
+        return fired;
+    }
+
+    void reset() {
+        hasPrevious_ = armed_ = hasCrossing_ = false;
+    }
+
+    float distance() const { return distance_; }
+    GateDirection direction() const { return direction_; }
+
+    // True while the subject is in front of the gate and a crossing can fire
+    bool armed() const { return armed_; }
+
+private:
+    float distance_;
+    GateDirection direction_;
+    GateParams params_;
+
+    TIMESPAN previousTime_ = 0;
+    float previousProgress_ = 0.0f; // metres past the gate in the walking direction
+    bool hasPrevious_ = false;
+    bool armed_ = false;
+    bool hasCrossing_ = false;
+    TIMESPAN firstCrossing_ = 0;
+    TIMESPAN lastCrossing_ = 0;
+};
@@ -0,0 +1,254 @@
+// Clinical joint angles of every tracked body, kept as short time series.
+// Where the Euler angles of Common/JointOrientation.h describe each joint
+// relative to the camera, these are the angles between body segments that
+// the tests are scored on:
+//
+//   knee flexion          0 with the leg straight, 90 seated
+//   hip flexion           thigh against the trunk, 0 standing, 90 seated
+//   ankle dorsiflexion    0 with the shin square to the foot, positive
+//                         with the toes pulled up
+//   trunk lean            trunk from the camera's vertical, any direction
+//
+// Each angle is the angle between two bone vectors taken from the joint
+// positions (smoothed ones when a JointSmoother is given). The Kinect's
+// joint orientations carry the same bone directions as their Y axes but are
+// zero on the feet, so the positions are used throughout. An angle is only
+// measured when every joint it needs is tracked; otherwise its sample is NaN.
+// The ankle angle is taken to the Kinect's foot joint, which sits below the
+// ankle as well as in front of it, so a neutral foot reads somewhat negative.
+//
+// Every (body, angle) pair is one float lane, and endFrame() measures all of
+// them in one SIMD pass with fastAtan2(), to within 0.0005 degrees of a
+// double-precision atan2. The last HISTORY frames are kept in a ring, one row
+// per frame, and a body's history is cleared when its slot is released.
+//
+//   JointAngleEngine angles;
+//   angles.beginFrame(bodyFrame.relativeTime);
+//   angles.addBodies(bodyFrame, &smoother);
+//   angles.endFrame();
+//   float knee;
+//   if (angles.angle(slot, ClinicalAngle_KneeFlexionLeft, knee)) ...
+#pragma once
+
+#include "BodySlots.h"
+#include "FrameSource.h"
+#include "JointOrientation.h"
+#include "JointSmoothing.h"
+
+#include <cstring>
+#include <limits>
+
+enum ClinicalAngle {
+    ClinicalAngle_KneeFlexionLeft,
+    ClinicalAngle_KneeFlexionRight,
+    ClinicalAngle_HipFlexionLeft,
+    ClinicalAngle_HipFlexionRight,
+    ClinicalAngle_AnkleDorsiflexionLeft,
+    ClinicalAngle_AnkleDorsiflexionRight,
+    ClinicalAngle_TrunkLean,
+    ClinicalAngle_Count
+};
+
+// degrees = offset + sign * (angle between a1 - a0 and b1 - b0); b0 == b1
+// stands for the camera's up axis
+struct ClinicalAngleDefinition {
+    const char* name;
+    JointType a0, a1;
+    JointType b0, b1;
+    float offset, sign;
+};
+
+const ClinicalAngleDefinition CLINICAL_ANGLES[ClinicalAngle_Count] = {
+    { "knee_flexion_left", JointType_KneeLeft, JointType_HipLeft, JointType_KneeLeft, JointType_AnkleLeft, 180.0f, -1.0f },
+    { "knee_flexion_right", JointType_KneeRight, JointType_HipRight, JointType_KneeRight, JointType_AnkleRight, 180.0f, -1.0f },
+    { "hip_flexion_left", JointType_SpineBase, JointType_SpineShoulder, JointType_HipLeft, JointType_KneeLeft, 180.0f, -1.0f },
+    { "hip_flexion_right", JointType_SpineBase, JointType_SpineShoulder, JointType_HipRight, JointType_KneeRight, 180.0f, -1.0f },
+    { "ankle_dorsiflexion_left", JointType_AnkleLeft, JointType_KneeLeft, JointType_AnkleLeft, JointType_FootLeft, 90.0f, -1.0f },
+    { "ankle_dorsiflexion_right", JointType_AnkleRight, JointType_KneeRight, JointType_AnkleRight, JointType_FootRight, 90.0f, -1.0f },
+    { "trunk_lean", JointType_SpineBase, JointType_SpineShoulder, JointType_SpineBase, JointType_SpineBase, 0.0f, 1.0f }
+};
+
+class JointAngleEngine {
+public:
+    static const size_t HISTORY = 64; // frames, about 2 s at 30 Hz
+
+    static const size_t LANES = BODY_COUNT * ClinicalAngle_Count;
+    static const size_t LANE_STRIDE = (LANES + 15) / 16 * 16;
+
+    JointAngleEngine() {
+        for (size_t lane = 0; lane < LANE_STRIDE; ++lane) {
+            const ClinicalAngleDefinition& definition = CLINICAL_ANGLES[lane % ClinicalAngle_Count];
+            offset_[lane] = definition.offset;
+            sign_[lane] = definition.sign;
+        }
+        clear();
+    }
+
+    void clear() {
+        memset(vectors_, 0, sizeof(vectors_));
+        memset(valid_, 0, sizeof(valid_));
+        std::fill(&history_[0][0], &history_[0][0] + HISTORY * LANE_STRIDE, NOT_MEASURED);
+        memset(times_, 0, sizeof(times_));
+        memset(samples_, 0, sizeof(samples_));
+        slots_.clear();
+        row_ = 0;
+    }
+
+    // Starts a frame captured at `time` (the body frame's RelativeTime)
+    void beginFrame(TIMESPAN time) {
+        row_ = row_ + 1 == HISTORY ? 0 : row_ + 1;
+        times_[row_] = time;
+        memset(valid_, 0, sizeof(valid_));
+        slots_.beginFrame();
+    }
+
+    // Adds one tracked body. The positions are taken from `smoother` when
+    // given and it has the joint, else from `joints`. Returns the body's
+    // slot, -1 if all slots are taken by other bodies.
+    int addBody(UINT64 trackingId, const Joint* joints, const JointSmoother* smoother = nullptr) {
+        int slot = slots_.bind(trackingId);
+        if (slot < 0) return -1;
+        int smoothedSlot = smoother ? smoother->slotOf(trackingId) : -1;
+        auto position = [&](JointType joint) {
+            CameraSpacePoint point;
+            if (smoothedSlot < 0 || !smoother->smoothed(smoothedSlot, joint, point)) point = joints[joint].Position;
+            return point;
+        };
+        auto tracked = [&](JointType joint) { return joints[joint].TrackingState == TrackingState_Tracked; };
+
+        for (int angle = 0; angle < ClinicalAngle_Count; ++angle) {
+            const ClinicalAngleDefinition& definition = CLINICAL_ANGLES[angle];
+            bool vertical = definition.b0 == definition.b1;
+            if (!tracked(definition.a0) || !tracked(definition.a1) ||
+                (!vertical && (!tracked(definition.b0) || !tracked(definition.b1)))) continue;
+            size_t lane = static_cast<size_t>(slot) * ClinicalAngle_Count + angle;
+            CameraSpacePoint a0 = position(definition.a0), a1 = position(definition.a1);
+            vectors_[0][lane] = a1.X - a0.X;
+            vectors_[1][lane] = a1.Y - a0.Y;
+            vectors_[2][lane] = a1.Z - a0.Z;
+            if (vertical) {
+                vectors_[3][lane] = 0.0f;
+                vectors_[4][lane] = 1.0f;
+                vectors_[5][lane] = 0.0f;
+            } else {
+                CameraSpacePoint b0 = position(definition.b0), b1 = position(definition.b1);
+                vectors_[3][lane] = b1.X - b0.X;
+                vectors_[4][lane] = b1.Y - b0.Y;
+                vectors_[5][lane] = b1.Z - b0.Z;
+            }
+            valid_[lane] = 1.0f;
+        }
+        return slot;
+    }
+
+    // Adds every tracked body of a FrameSource body frame
+    void addBodies(const BodyFrameData& frame, const JointSmoother* smoother = nullptr) {
+        for (int i = 0; i < BODY_COUNT; ++i) {
+            if (frame.bodies[i].isTracked) addBody(frame.bodies[i].trackingId, frame.bodies[i].joints, smoother);
+        }
+    }
+
+    // Releases the slots of bodies that were not added this frame and
+    // measures every angle into the newest row of the ring
+    void endFrame() {
+        slots_.endFrame([this](int slot) { release(slot); });
+        measure(history_[row_]);
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            if (slots_.occupied(slot) && samples_[slot] < HISTORY) ++samples_[slot];
+        }
+    }
+
+    int slotOf(UINT64 trackingId) const { return slots_.slotOf(trackingId); }
+    const BodySlots& slots() const { return slots_; }
+
+    // Frames of history the body in `slot` has, up to HISTORY
+    size_t samples(int slot) const { return slot < 0 || slot >= BODY_COUNT ? 0 : samples_[slot]; }
+
+    // The angle `age` frames back (0 = this frame) and the time of that
+    // frame. False when the body has no such frame or the angle was not
+    // measured in it.
+    bool sample(int slot, ClinicalAngle angle, size_t age, float& degrees, TIMESPAN& time) const {
+        if (age >= samples(slot)) return false;
+        size_t row = (row_ + HISTORY - age) % HISTORY;
+        degrees = history_[row][static_cast<size_t>(slot) * ClinicalAngle_Count + angle];
+        time = times_[row];
+        return degrees == degrees; // not NaN
+    }
+
+    // The angle this frame, in degrees
+    bool angle(int slot, ClinicalAngle angle, float& degrees) const {
+        TIMESPAN time;
+        return sample(slot, angle, 0, degrees, time);
+    }
+
+private:
+    static constexpr float NOT_MEASURED = std::numeric_limits<float>::quiet_NaN();
+    static constexpr float DEGREES = static_cast<float>(180.0 / M_PI);
+
+    void release(int slot) {
+        for (size_t row = 0; row < HISTORY; ++row) {
+            std::fill(history_[row] + slot * ClinicalAngle_Count, history_[row] + (slot + 1) * ClinicalAngle_Count, NOT_MEASURED);
+        }
+        samples_[slot] = 0;
+    }
+
+    // angle = atan2(|a x b|, a . b), accurate at 0 and 180 degrees where
+    // acos of the normalized dot product is not
+    void measure(float* out) {
+        size_t lane = 0;
+#if defined(EULER_ANGLES_AVX)
+        const __m256 degrees = _mm256_set1_ps(DEGREES), notMeasured = _mm256_set1_ps(NOT_MEASURED), zero = _mm256_setzero_ps();
+        for (; lane < LANE_STRIDE; lane += 8) {
+            __m256 ax = _mm256_load_ps(vectors_[0] + lane), ay = _mm256_load_ps(vectors_[1] + lane), az = _mm256_load_ps(vectors_[2] + lane);
+            __m256 bx = _mm256_load_ps(vectors_[3] + lane), by = _mm256_load_ps(vectors_[4] + lane), bz = _mm256_load_ps(vectors_[5] + lane);
+            __m256 cx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+            __m256 cy = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+            __m256 cz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+            __m256 cross = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)));
+            __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+            __m256 angle = _mm256_mul_ps(fastAtan2(cross, dot), degrees);
+            angle = _mm256_add_ps(_mm256_load_ps(offset_ + lane), _mm256_mul_ps(_mm256_load_ps(sign_ + lane), angle));
+            __m256 valid = _mm256_cmp_ps(_mm256_load_ps(valid_ + lane), zero, _CMP_GT_OQ);
+            _mm256_store_ps(out + lane, selectLanes(valid, angle, notMeasured));
+        }
+#elif defined(EULER_ANGLES_SSE2)
+        const __m128 degrees = _mm_set1_ps(DEGREES), notMeasured = _mm_set1_ps(NOT_MEASURED), zero = _mm_setzero_ps();
+        for (; lane < LANE_STRIDE; lane += 4) {
+            __m128 ax = _mm_load_ps(vectors_[0] + lane), ay = _mm_load_ps(vectors_[1] + lane), az = _mm_load_ps(vectors_[2] + lane);
+            __m128 bx = _mm_load_ps(vectors_[3] + lane), by = _mm_load_ps(vectors_[4] + lane), bz = _mm_load_ps(vectors_[5] + lane);
+            __m128 cx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+            __m128 cy = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+            __m128 cz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+            __m128 cross = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+            __m128 angle = _mm_mul_ps(fastAtan2(cross, dot), degrees);
+            angle = _mm_add_ps(_mm_load_ps(offset_ + lane), _mm_mul_ps(_mm_load_ps(sign_ + lane), angle));
+            __m128 valid = _mm_cmpgt_ps(_mm_load_ps(valid_ + lane), zero);
+            _mm_store_ps(out + lane, selectLanes(valid, angle, notMeasured));
+        }
+#endif
+        for (; lane < LANE_STRIDE; ++lane) {
+            float ax = vectors_[0][lane], ay = vectors_[1][lane], az = vectors_[2][lane];
+            float bx = vectors_[3][lane], by = vectors_[4][lane], bz = vectors_[5][lane];
+            float cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+            float angle = fastAtan2(std::sqrt(cx * cx + cy * cy + cz * cz), ax * bx + ay * by + az * bz) * DEGREES;
+            out[lane] = valid_[lane] > 0.0f ? offset_[lane] + sign_[lane] * angle : NOT_MEASURED;
+        }
+    }
+
+    // vectors_[component][lane]: a.x, a.y, a.z, b.x, b.y, b.z of this frame
+    alignas(64) float vectors_[6][LANE_STRIDE];
+    // 1 where every joint of the lane's angle is tracked this frame
+    alignas(64) float valid_[LANE_STRIDE];
+    alignas(64) float offset_[LANE_STRIDE];
+    alignas(64) float sign_[LANE_STRIDE];
+
+    // history_[row][lane] in degrees, NaN where not measured; times_[row]
+    // is the frame's time. row_ is the newest row.
+    alignas(64) float history_[HISTORY][LANE_STRIDE];
+    TIMESPAN times_[HISTORY];
+    size_t samples_[BODY_COUNT];
+    size_t row_ = 0;
+
+    BodySlots slots_;
+};
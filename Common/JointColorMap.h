@@ -0,0 +1,100 @@
+// Maps the joints of every tracked body to color-image pixels with a single
+// MapCameraPointsToColorSpace call per frame. Drawing a skeleton used to map
+// both ends of every bone and then every joint again, one call each: about
+// 65 calls per body, most of them for joints already mapped. Bones and joint
+// markers now look their pixels up in the per-frame table instead.
+//
+// Works with anything that has the ICoordinateMapper signature of
+// MapCameraPointsToColorSpace: the SDK's ICoordinateMapper or a FrameSource
+// (whose replay backend projects with the color camera intrinsics).
+#pragma once
+
+#include "FrameSource.h"
+#include "SkeletonTopology.h"
+
+class JointColorMap {
+public:
+    static const int MAX_POINTS = BODY_COUNT * JointType_Count;
+
+    JointColorMap() { clear(); }
+
+    // Forgets the previous frame's joints
+    void clear() {
+        for (int body = 0; body < BODY_COUNT; ++body) {
+            for (int j = 0; j < JointType_Count; ++j) index_[body][j] = -1;
+        }
+        count_ = 0;
+    }
+
+    // Queues one camera-space point for `joint` of `body` (0..BODY_COUNT-1)
+    void add(int body, JointType joint, const CameraSpacePoint& position) {
+        if (index_[body][joint] < 0) index_[body][joint] = count_++;
+        cameraPoints_[index_[body][joint]] = position;
+    }
+
+    // Queues every tracked joint of a body
+    void addBody(int body, const Joint* joints) {
+        for (int j = 0; j < JointType_Count; ++j) {
+            if (joints[j].TrackingState == TrackingState_Tracked) add(body, static_cast<JointType>(j), joints[j].Position);
+        }
+    }
+
+    void addBodies(const BodyFrameData& frame) {
+        for (int body = 0; body < BODY_COUNT; ++body) {
+            if (frame.bodies[body].isTracked) addBody(body, frame.bodies[body].joints);
+        }
+    }
+
+    // Queues only the tracked joints of `Groups`, for programs that draw or
+    // read part of the skeleton (JointGroup_Body for the drawn bones)
+    template<unsigned Groups>
+    void addBody(int body, const Joint* joints) {
+        forEachJoint<Groups>([&](JointType joint) {
+            if (joints[joint].TrackingState == TrackingState_Tracked) add(body, joint, joints[joint].Position);
+        });
+    }
+
+    template<unsigned Groups>
+    void addBodies(const BodyFrameData& frame) {
+        for (int body = 0; body < BODY_COUNT; ++body) {
+            if (frame.bodies[body].isTracked) addBody<Groups>(body, frame.bodies[body].joints);
+        }
+    }
+
+    // Maps every queued point in one call
+    template<class Mapper>
+    HRESULT map(Mapper& mapper) {
+        if (count_ == 0) return S_OK;
+        HRESULT hr = mapper.MapCameraPointsToColorSpace(count_, cameraPoints_, count_, colorPoints_);
+        if (FAILED(hr)) clear();
+        return hr;
+    }
+
+    // Color-space position of a queued joint, false if it was not queued
+    bool colorPoint(int body, JointType joint, ColorSpacePoint& point) const {
+        int i = index_[body][joint];
+        if (i < 0) return false;
+        point = colorPoints_[i];
+        return true;
+    }
+
+    // Pixel of a queued joint, false if it was not queued or falls outside
+    // a width x height image (the mapper returns -infinity for points it
+    // cannot project)
+    bool pixel(int body, JointType joint, int width, int height, int& x, int& y) const {
+        ColorSpacePoint point;
+        if (!colorPoint(body, joint, point)) return false;
+        if (!(point.X >= 0.0f && point.X < width && point.Y >= 0.0f && point.Y < height)) return false;
+        x = static_cast<int>(point.X);
+        y = static_cast<int>(point.Y);
+        return true;
+    }
+
+    int size() const { return count_; }
+
+private:
+    int index_[BODY_COUNT][JointType_Count];
+    CameraSpacePoint cameraPoints_[MAX_POINTS];
+    ColorSpacePoint colorPoints_[MAX_POINTS];
+    int count_ = 0;
+};
@@ -0,0 +1,166 @@
+// Joint smoothing state for every body the sensor can track, kept across
+// frames. Each body is bound to one of BODY_COUNT slots by its TrackingId
+// when it appears and released when it is no longer tracked, so a new person
+// never inherits someone else's history.
+//
+// The samples are stored structure-of-arrays: one float lane per
+// (slot, joint) for each of x, y, z and a weight (1 for a tracked sample,
+// 0 otherwise). endFrame() smooths all 6 x 25 joints in one vectorized pass
+// (AVX, SSE2 or scalar, chosen at compile time).
+#pragma once
+
+#include "BodySlots.h"
+#include "FrameSource.h"
+
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define JOINT_FILTER_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JOINT_FILTER_SSE2 1
+#endif
+
+class JointFilterBank {
+public:
+    // Moving average over the tracked samples of the last WINDOW frames
+    static const size_t WINDOW = 5;
+
+    // Lanes for BODY_COUNT x JointType_Count joints, padded so every lane
+    // array is a whole number of 64-byte cache lines
+    static const size_t LANES = BODY_COUNT * JointType_Count;
+    static const size_t LANE_STRIDE = (LANES + 15) / 16 * 16;
+
+    JointFilterBank() { clear(); }
+
+    void clear() {
+        memset(history_, 0, sizeof(history_));
+        memset(smoothed_, 0, sizeof(smoothed_));
+        slots_.clear();
+        row_ = 0;
+    }
+
+    // Starts a frame: the oldest row of the window is overwritten by the
+    // bodies passed to addBody() before endFrame()
+    void beginFrame() {
+        row_ = row_ + 1 == WINDOW ? 0 : row_ + 1;
+        memset(history_[row_], 0, sizeof(history_[row_]));
+        slots_.beginFrame();
+    }
+
+    // Adds one tracked body's joints to the current frame. Returns the slot
+    // the body is bound to, or -1 if all slots are taken by other bodies.
+    int addBody(UINT64 trackingId, const Joint* joints) {
+        int slot = slots_.bind(trackingId);
+        if (slot < 0) return -1;
+
+        float* x = history_[row_][0] + slot * JointType_Count;
+        float* y = history_[row_][1] + slot * JointType_Count;
+        float* z = history_[row_][2] + slot * JointType_Count;
+        float* w = history_[row_][3] + slot * JointType_Count;
+        for (int j = 0; j < JointType_Count; ++j) {
+            if (joints[j].TrackingState != TrackingState_Tracked) continue;
+            x[j] = joints[j].Position.X;
+            y[j] = joints[j].Position.Y;
+            z[j] = joints[j].Position.Z;
+            w[j] = 1.0f;
+        }
+        return slot;
+    }
+
+    // Adds every tracked body of a FrameSource body frame
+    void addBodies(const BodyFrameData& frame) {
+        for (int i = 0; i < BODY_COUNT; ++i) {
+            if (frame.bodies[i].isTracked) addBody(frame.bodies[i].trackingId, frame.bodies[i].joints);
+        }
+    }
+
+    // Releases the slots of bodies that were not added this frame and
+    // smooths every joint
+    void endFrame() {
+        slots_.endFrame([this](int slot) { release(slot); });
+        smooth();
+    }
+
+    // Slot bound to `trackingId`, -1 if the body is not being filtered
+    int slotOf(UINT64 trackingId) const { return slots_.slotOf(trackingId); }
+
+    // Smoothed position of a joint after endFrame(). False when the joint
+    // had no tracked sample in the window.
+    bool smoothed(int slot, JointType joint, CameraSpacePoint& position) const {
+        size_t lane = static_cast<size_t>(slot) * JointType_Count + joint;
+        if (slot < 0 || slot >= BODY_COUNT || smoothed_[3][lane] == 0.0f) return false;
+        position.X = smoothed_[0][lane];
+        position.Y = smoothed_[1][lane];
+        position.Z = smoothed_[2][lane];
+        return true;
+    }
+
+    // Body lifecycle counters
+    const BodySlots& slots() const { return slots_; }
+
+private:
+    // Erases a released slot's history so its next body starts clean
+    void release(int slot) {
+        for (size_t r = 0; r < WINDOW; ++r) {
+            for (size_t axis = 0; axis < 4; ++axis) {
+                memset(history_[r][axis] + slot * JointType_Count, 0, JointType_Count * sizeof(float));
+            }
+        }
+    }
+
+    // smoothed = sum(w * p) / sum(w) over the window, per lane. Untracked
+    // samples are stored as 0 with weight 0, so the sums need no masking.
+    void smooth() {
+        size_t lane = 0;
+#if defined(JOINT_FILTER_AVX)
+        const __m256 one = _mm256_set1_ps(1.0f);
+        for (; lane < LANE_STRIDE; lane += 8) {
+            __m256 sum[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+            for (size_t r = 0; r < WINDOW; ++r) {
+                for (size_t axis = 0; axis < 4; ++axis) {
+                    sum[axis] = _mm256_add_ps(sum[axis], _mm256_load_ps(history_[r][axis] + lane));
+                }
+            }
+            __m256 divisor = _mm256_max_ps(sum[3], one);
+            for (size_t axis = 0; axis < 3; ++axis) {
+                _mm256_store_ps(smoothed_[axis] + lane, _mm256_div_ps(sum[axis], divisor));
+            }
+            _mm256_store_ps(smoothed_[3] + lane, sum[3]);
+        }
+#elif defined(JOINT_FILTER_SSE2)
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; lane < LANE_STRIDE; lane += 4) {
+            __m128 sum[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+            for (size_t r = 0; r < WINDOW; ++r) {
+                for (size_t axis = 0; axis < 4; ++axis) {
+                    sum[axis] = _mm_add_ps(sum[axis], _mm_load_ps(history_[r][axis] + lane));
+                }
+            }
+            __m128 divisor = _mm_max_ps(sum[3], one);
+            for (size_t axis = 0; axis < 3; ++axis) {
+                _mm_store_ps(smoothed_[axis] + lane, _mm_div_ps(sum[axis], divisor));
+            }
+            _mm_store_ps(smoothed_[3] + lane, sum[3]);
+        }
+#endif
+        for (; lane < LANE_STRIDE; ++lane) {
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (size_t r = 0; r < WINDOW; ++r) {
+                for (size_t axis = 0; axis < 4; ++axis) sum[axis] += history_[r][axis][lane];
+            }
+            float divisor = sum[3] > 1.0f ? sum[3] : 1.0f;
+            for (size_t axis = 0; axis < 3; ++axis) smoothed_[axis][lane] = sum[axis] / divisor;
+            smoothed_[3][lane] = sum[3];
+        }
+    }
+
+    // history_[row][axis][lane], axis 0..2 = x, y, z and 3 = weight
+    alignas(64) float history_[WINDOW][4][LANE_STRIDE];
+    // Smoothed x, y, z and the number of tracked samples behind them
+    alignas(64) float smoothed_[4][LANE_STRIDE];
+
+    BodySlots slots_;
+    size_t row_ = 0;
+};
@@ -0,0 +1,243 @@
+// Euler angles of a joint orientation quaternion, in degrees, as printed by
+// the pitch/yaw/roll program. Kinect joint orientations are relative to the
+// camera, with the bone along the joint's Y axis.
+//
+// CalculatePitch/Yaw/Roll are the exact double-precision reference.
+// EulerAngleBatch converts every joint of every body at once in float, with
+// polynomial atan2 and asin, to within EulerAngleBatch::MAX_ERROR_DEGREES.
+#pragma once
+
+#include "FrameSource.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define EULER_ANGLES_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EULER_ANGLES_SSE2 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+inline double CalculatePitch(const Vector4& quaternion) {
+    double value1 = 2.0 * (quaternion.w * quaternion.x + quaternion.y * quaternion.z);
+    double value2 = 1.0 - 2.0 * (quaternion.x * quaternion.x + quaternion.y * quaternion.y);
+    double pitch = atan2(value1, value2);
+    return pitch * (180.0 / M_PI);
+}
+
+inline double CalculateYaw(const Vector4& quaternion) {
+    double value = 2.0 * (quaternion.w * quaternion.y - quaternion.z * quaternion.x);
+    value = (value > 1.0) ? 1.0 : (value < -1.0 ? -1.0 : value); // Manual clamp
+    double yaw = asin(value);
+    return yaw * (180.0 / M_PI);
+}
+
+inline double CalculateRoll(const Vector4& quaternion) {
+    double value1 = 2.0 * (quaternion.w * quaternion.z + quaternion.x * quaternion.y);
+    double value2 = 1.0 - 2.0 * (quaternion.y * quaternion.y + quaternion.z * quaternion.z);
+    double roll = atan2(value1, value2);
+    return roll * (180.0 / M_PI);
+}
+
+struct EulerAngles {
+    double pitch, yaw, roll;
+};
+
+// All three angles, sharing the products of the quaternion; the same
+// values as the three functions above
+inline EulerAngles CalculateEulerAngles(const Vector4& quaternion) {
+    float x = quaternion.x, y = quaternion.y, z = quaternion.z, w = quaternion.w;
+    float yy = y * y;
+    double yaw = 2.0 * (w * y - z * x);
+    yaw = yaw > 1.0 ? 1.0 : (yaw < -1.0 ? -1.0 : yaw);
+    return {
+        atan2(2.0 * (w * x + y * z), 1.0 - 2.0 * (x * x + yy)) * (180.0 / M_PI),
+        asin(yaw) * (180.0 / M_PI),
+        atan2(2.0 * (w * z + x * y), 1.0 - 2.0 * (yy + z * z)) * (180.0 / M_PI)
+    };
+}
+
+// Float atan2 for the batched kernels: a degree-11 minimax polynomial for
+// atan on [0, 1] (error below 1.7e-6 rad, 0.0001 degrees) of min/max of |y|
+// and |x|, swapped for |y| > |x|, mirrored for x < 0 and given the sign of
+// y. A scalar version and the AVX or SSE2 one the build allows.
+const float FAST_ATAN[6] = { -0.01172120f, 0.05265332f, -0.11643287f, 0.19354346f, -0.33262347f, 0.99997726f };
+const float FAST_ATAN_HALF_PI = static_cast<float>(M_PI / 2.0);
+const float FAST_ATAN_PI = static_cast<float>(M_PI);
+
+inline float fastAtan2(float y, float x) {
+    float ax = std::fabs(x), ay = std::fabs(y);
+    float high = std::max(ax, ay);
+    float a = high > 0.0f ? std::min(ax, ay) / high : 0.0f;
+    float s = a * a;
+    float r = FAST_ATAN[0];
+    for (int i = 1; i < 6; ++i) r = r * s + FAST_ATAN[i];
+    r *= a;
+    if (ay > ax) r = FAST_ATAN_HALF_PI - r;
+    if (x < 0.0f) r = FAST_ATAN_PI - r;
+    return std::copysign(r, y);
+}
+
+#if defined(EULER_ANGLES_AVX)
+// and/andnot/or: vblendvps is several times slower on some cores
+inline __m256 selectLanes(__m256 mask, __m256 ifTrue, __m256 ifFalse) {
+    return _mm256_or_ps(_mm256_and_ps(mask, ifTrue), _mm256_andnot_ps(mask, ifFalse));
+}
+
+inline __m256 fastAtan2(__m256 y, __m256 x) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign, x), ay = _mm256_andnot_ps(sign, y);
+    // 0 / FLT_MIN = 0 for atan2(0, 0)
+    __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(FLT_MIN)));
+    __m256 s = _mm256_mul_ps(a, a);
+    __m256 r = _mm256_set1_ps(FAST_ATAN[0]);
+    for (int i = 1; i < 6; ++i) r = _mm256_add_ps(_mm256_mul_ps(r, s), _mm256_set1_ps(FAST_ATAN[i]));
+    r = _mm256_mul_ps(r, a);
+    r = selectLanes(_mm256_cmp_ps(ay, ax, _CMP_GT_OQ), _mm256_sub_ps(_mm256_set1_ps(FAST_ATAN_HALF_PI), r), r);
+    r = selectLanes(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_sub_ps(_mm256_set1_ps(FAST_ATAN_PI), r), r);
+    return _mm256_or_ps(r, _mm256_and_ps(sign, y));
+}
+#elif defined(EULER_ANGLES_SSE2)
+inline __m128 selectLanes(__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+    return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+
+inline __m128 fastAtan2(__m128 y, __m128 x) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign, x), ay = _mm_andnot_ps(sign, y);
+    // 0 / FLT_MIN = 0 for atan2(0, 0)
+    __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN)));
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 r = _mm_set1_ps(FAST_ATAN[0]);
+    for (int i = 1; i < 6; ++i) r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(FAST_ATAN[i]));
+    r = _mm_mul_ps(r, a);
+    r = selectLanes(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(FAST_ATAN_HALF_PI), r), r);
+    r = selectLanes(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(FAST_ATAN_PI), r), r);
+    return _mm_or_ps(r, _mm_and_ps(sign, y));
+}
+#endif
+
+// Pitch, yaw and roll of all BODY_COUNT x 25 joint orientations in one pass.
+// The quaternions are stored structure-of-arrays, one float lane per
+// (body, joint) for each of x, y, z and w, and compute() converts 8 (AVX),
+// 4 (SSE2) or 1 lane at a time, chosen at compile time.
+//
+//   EulerAngleBatch angles;
+//   angles.setBodies(bodyFrame);
+//   angles.compute();
+//   float yaw = angles.yaw(body, JointType_KneeLeft);
+//
+// atan2 is fastAtan2() above; asin(v) is atan2(v, sqrt(1 - v^2)). With the
+// float rounding, every angle is within
+// MAX_ERROR_DEGREES of CalculatePitch/Yaw/Roll (0.00013 measured on random
+// unit quaternions, including yaw at +-90). Pitch and roll of +-180 may come
+// out as -+180.
+class EulerAngleBatch {
+public:
+    static const size_t LANES = BODY_COUNT * JointType_Count;
+    static const size_t LANE_STRIDE = (LANES + 15) / 16 * 16;
+
+    static constexpr double MAX_ERROR_DEGREES = 0.0005;
+
+    EulerAngleBatch() { clear(); }
+
+    // Every lane the identity rotation (all angles 0)
+    void clear() {
+        memset(quaternion_, 0, sizeof(quaternion_));
+        std::fill(quaternion_[3], quaternion_[3] + LANE_STRIDE, 1.0f);
+        memset(angles_, 0, sizeof(angles_));
+    }
+
+    // The 25 orientations of body `body` (0 to BODY_COUNT - 1)
+    void setBody(int body, const JointOrientation* orientations) {
+        size_t lane = static_cast<size_t>(body) * JointType_Count;
+        for (int j = 0; j < JointType_Count; ++j, ++lane) {
+            const Vector4& q = orientations[j].Orientation;
+            quaternion_[0][lane] = q.x;
+            quaternion_[1][lane] = q.y;
+            quaternion_[2][lane] = q.z;
+            quaternion_[3][lane] = q.w;
+        }
+    }
+
+    // Every body of a FrameSource body frame, tracked or not, in its frame index
+    void setBodies(const BodyFrameData& frame) {
+        for (int i = 0; i < BODY_COUNT; ++i) setBody(i, frame.bodies[i].orientations);
+    }
+
+    // Converts every lane; the angles stay valid until the next compute()
+    void compute() {
+        size_t lane = 0;
+#if defined(EULER_ANGLES_AVX)
+        for (; lane < LANE_STRIDE; lane += 8) {
+            __m256 x = _mm256_load_ps(quaternion_[0] + lane), y = _mm256_load_ps(quaternion_[1] + lane);
+            __m256 z = _mm256_load_ps(quaternion_[2] + lane), w = _mm256_load_ps(quaternion_[3] + lane);
+            const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), degrees = _mm256_set1_ps(DEGREES);
+            __m256 yy = _mm256_mul_ps(y, y);
+            __m256 pitchY = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(w, x), _mm256_mul_ps(y, z)));
+            __m256 pitchX = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(x, x), yy)));
+            __m256 rollY = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(w, z), _mm256_mul_ps(x, y)));
+            __m256 rollX = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, _mm256_mul_ps(z, z))));
+            __m256 sine = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(w, y), _mm256_mul_ps(z, x)));
+            sine = _mm256_max_ps(_mm256_min_ps(sine, one), _mm256_set1_ps(-1.0f));
+            __m256 cosine = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_sub_ps(one, sine), _mm256_add_ps(one, sine)));
+            _mm256_store_ps(angles_[0] + lane, _mm256_mul_ps(fastAtan2(pitchY, pitchX), degrees));
+            _mm256_store_ps(angles_[1] + lane, _mm256_mul_ps(fastAtan2(sine, cosine), degrees));
+            _mm256_store_ps(angles_[2] + lane, _mm256_mul_ps(fastAtan2(rollY, rollX), degrees));
+        }
+#elif defined(EULER_ANGLES_SSE2)
+        for (; lane < LANE_STRIDE; lane += 4) {
+            __m128 x = _mm_load_ps(quaternion_[0] + lane), y = _mm_load_ps(quaternion_[1] + lane);
+            __m128 z = _mm_load_ps(quaternion_[2] + lane), w = _mm_load_ps(quaternion_[3] + lane);
+            const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), degrees = _mm_set1_ps(DEGREES);
+            __m128 yy = _mm_mul_ps(y, y);
+            __m128 pitchY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, x), _mm_mul_ps(y, z)));
+            __m128 pitchX = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), yy)));
+            __m128 rollY = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(w, z), _mm_mul_ps(x, y)));
+            __m128 rollX = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, _mm_mul_ps(z, z))));
+            __m128 sine = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(w, y), _mm_mul_ps(z, x)));
+            sine = _mm_max_ps(_mm_min_ps(sine, one), _mm_set1_ps(-1.0f));
+            __m128 cosine = _mm_sqrt_ps(_mm_mul_ps(_mm_sub_ps(one, sine), _mm_add_ps(one, sine)));
+            _mm_store_ps(angles_[0] + lane, _mm_mul_ps(fastAtan2(pitchY, pitchX), degrees));
+            _mm_store_ps(angles_[1] + lane, _mm_mul_ps(fastAtan2(sine, cosine), degrees));
+            _mm_store_ps(angles_[2] + lane, _mm_mul_ps(fastAtan2(rollY, rollX), degrees));
+        }
+#endif
+        for (; lane < LANE_STRIDE; ++lane) {
+            float x = quaternion_[0][lane], y = quaternion_[1][lane], z = quaternion_[2][lane], w = quaternion_[3][lane];
+            float sine = std::max(-1.0f, std::min(1.0f, 2.0f * (w * y - z * x)));
+            angles_[0][lane] = fastAtan2(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * DEGREES;
+            angles_[1][lane] = fastAtan2(sine, std::sqrt((1.0f - sine) * (1.0f + sine))) * DEGREES;
+            angles_[2][lane] = fastAtan2(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * DEGREES;
+        }
+    }
+
+    // Angles in degrees after compute()
+    float pitch(int body, JointType joint) const { return angles_[0][laneOf(body, joint)]; }
+    float yaw(int body, JointType joint) const { return angles_[1][laneOf(body, joint)]; }
+    float roll(int body, JointType joint) const { return angles_[2][laneOf(body, joint)]; }
+
+    EulerAngles angles(int body, JointType joint) const {
+        size_t lane = laneOf(body, joint);
+        return { angles_[0][lane], angles_[1][lane], angles_[2][lane] };
+    }
+
+private:
+    static constexpr float DEGREES = static_cast<float>(180.0 / M_PI);
+    static size_t laneOf(int body, JointType joint) {
+        return static_cast<size_t>(body) * JointType_Count + joint;
+    }
+
+    // quaternion_[component][lane], component 0..3 = x, y, z, w
+    alignas(64) float quaternion_[4][LANE_STRIDE];
+    // angles_[angle][lane], angle 0..2 = pitch, yaw, roll in degrees
+    alignas(64) float angles_[3][LANE_STRIDE];
+};
@@ -0,0 +1,334 @@
+// Low-latency joint smoothing. A moving average delays a joint by half its
+// window (about two frames for five samples), which shifts every threshold
+// crossing the tests time. The filters here follow motion with little lag
+// and still damp the sensor's jitter:
+//
+//   OneEuroFilter            low-pass whose cutoff rises with speed: heavy
+//                            smoothing at rest, almost none while moving
+//   DoubleExponentialFilter  Holt's level + trend smoothing
+//   KalmanFilter1D           constant-velocity Kalman filter
+//
+// All three smooth one coordinate with the same interface,
+// `float update(float value, float dt)` and `reset()`, where dt is the time
+// since the previous sample in seconds. JointSmoother runs one filter per
+// axis for every joint of every tracked body; the filter is chosen per joint
+// and all joints are updated in one batched pass per frame.
+#pragma once
+
+#include "BodySlots.h"
+#include "FrameClock.h"
+#include "FrameSource.h"
+
+#include <cmath>
+#include <cstring>
+
+enum SmoothingFilterType {
+    SmoothingFilter_None,
+    SmoothingFilter_OneEuro,
+    SmoothingFilter_DoubleExponential,
+    SmoothingFilter_Kalman,
+    SmoothingFilter_Count
+};
+
+inline const char* smoothingFilterName(SmoothingFilterType type) {
+    switch (type) {
+    case SmoothingFilter_None: return "none";
+    case SmoothingFilter_OneEuro: return "one-euro";
+    case SmoothingFilter_DoubleExponential: return "double-exponential";
+    case SmoothingFilter_Kalman: return "kalman";
+    default: return "?";
+    }
+}
+
+// Defaults are tuned for Kinect joint positions in metres at 30 Hz
+struct OneEuroParams {
+    float minCutoff = 1.0f;        // Hz, cutoff at rest; lower = smoother when still
+    float beta = 20.0f;            // cutoff increase per m/s of speed; higher = less lag
+    float derivativeCutoff = 1.0f; // Hz, for the speed estimate
+};
+
+struct DoubleExponentialParams {
+    float smoothing = 0.5f; // weight of the new sample in the level, 0..1
+    float trend = 0.5f;     // weight of the new slope in the trend, 0..1
+};
+
+struct KalmanParams {
+    float processNoise = 0.1f;         // acceleration noise density, (m/s^2)^2 / Hz
+    float measurementNoise = 2.5e-5f;  // sample variance, m^2 (5 mm standard deviation)
+};
+
+struct SmoothingParams {
+    OneEuroParams oneEuro;
+    DoubleExponentialParams doubleExponential;
+    KalmanParams kalman;
+};
+
+class OneEuroFilter {
+public:
+    float update(float value, float dt, const OneEuroParams& params) {
+        if (!primed_ || dt <= 0.0f) {
+            if (!primed_) value_ = value;
+            primed_ = true;
+            return value_;
+        }
+        float speed = (value - value_) / dt;
+        speed_ += alpha(params.derivativeCutoff, dt) * (speed - speed_);
+        float cutoff = params.minCutoff + params.beta * std::fabs(speed_);
+        value_ += alpha(cutoff, dt) * (value - value_);
+        return value_;
+    }
+
+    float update(float value, float dt) { return update(value, dt, OneEuroParams()); }
+
+    void reset() {
+        primed_ = false;
+        value_ = speed_ = 0.0f;
+    }
+
+private:
+    // Smoothing factor of a first-order low-pass with `cutoff` Hz
+    static float alpha(float cutoff, float dt) {
+        float tau = 1.0f / (2.0f * 3.14159265f * cutoff);
+        return 1.0f / (1.0f + tau / dt);
+    }
+
+    float value_ = 0.0f;
+    float speed_ = 0.0f;
+    bool primed_ = false;
+};
+
+// Works per sample, like the SDK's own double-exponential joint filter; dt
+// is only used to skip duplicate samples
+class DoubleExponentialFilter {
+public:
+    float update(float value, float dt, const DoubleExponentialParams& params) {
+        if (!primed_) {
+            level_ = value;
+            trend_ = 0.0f;
+            primed_ = true;
+            return level_;
+        }
+        if (dt <= 0.0f) return level_;
+        float previousLevel = level_;
+        level_ = params.smoothing * value + (1.0f - params.smoothing) * (level_ + trend_);
+        trend_ = params.trend * (level_ - previousLevel) + (1.0f - params.trend) * trend_;
+        return level_;
+    }
+
+    float update(float value, float dt) { return update(value, dt, DoubleExponentialParams()); }
+
+    void reset() {
+        primed_ = false;
+        level_ = trend_ = 0.0f;
+    }
+
+private:
+    float level_ = 0.0f;
+    float trend_ = 0.0f;
+    bool primed_ = false;
+};
+
+// State [position, velocity], white-noise acceleration model
+class KalmanFilter1D {
+public:
+    float update(float value, float dt, const KalmanParams& params) {
+        if (!primed_) {
+            position_ = value;
+            velocity_ = 0.0f;
+            p00_ = params.measurementNoise;
+            p01_ = 0.0f;
+            p11_ = 1.0f; // velocity unknown, ~1 m/s
+            primed_ = true;
+            return position_;
+        }
+        if (dt <= 0.0f) return position_;
+
+        // Predict
+        position_ += velocity_ * dt;
+        float q = params.processNoise;
+        float dt2 = dt * dt;
+        p00_ += dt * (2.0f * p01_ + dt * p11_) + q * dt2 * dt / 3.0f;
+        p01_ += dt * p11_ + q * dt2 / 2.0f;
+        p11_ += q * dt;
+
+        // Correct with the measured position
+        float s = p00_ + params.measurementNoise;
+        float k0 = p00_ / s;
+        float k1 = p01_ / s;
+        float residual = value - position_;
+        position_ += k0 * residual;
+        velocity_ += k1 * residual;
+        p11_ -= k1 * p01_;
+        p01_ -= k0 * p01_;
+        p00_ -= k0 * p00_;
+        return position_;
+    }
+
+    float update(float value, float dt) { return update(value, dt, KalmanParams()); }
+
+    void reset() {
+        primed_ = false;
+        position_ = velocity_ = 0.0f;
+        p00_ = p01_ = p11_ = 0.0f;
+    }
+
+private:
+    float position_ = 0.0f;
+    float velocity_ = 0.0f;
+    float p00_ = 0.0f, p01_ = 0.0f, p11_ = 0.0f; // covariance
+    bool primed_ = false;
+};
+
+class JointSmoother {
+public:
+    // One lane per axis of every joint of every slot
+    static const size_t LANES = BODY_COUNT * JointType_Count * 3;
+
+    explicit JointSmoother(SmoothingFilterType type = SmoothingFilter_OneEuro, const SmoothingParams& params = SmoothingParams())
+        : params_(params) {
+        for (int j = 0; j < JointType_Count; ++j) jointFilters_[j] = type;
+        clear();
+    }
+
+    // Filter used for `joint` on every body. Resets that joint's state.
+    void setFilter(JointType joint, SmoothingFilterType type) {
+        jointFilters_[joint] = type;
+        for (int slot = 0; slot < BODY_COUNT; ++slot) resetJoint(slot, joint);
+        buildLaneLists();
+    }
+
+    SmoothingFilterType filter(JointType joint) const { return jointFilters_[joint]; }
+    SmoothingParams& params() { return params_; }
+
+    void clear() {
+        for (size_t lane = 0; lane < LANES; ++lane) resetLane(lane);
+        slots_.clear();
+        buildLaneLists();
+    }
+
+    // Starts a frame captured at `time` (the body frame's RelativeTime)
+    void beginFrame(TIMESPAN time) {
+        frameTime_ = time;
+        slots_.beginFrame();
+        memset(hasSample_, 0, sizeof(hasSample_));
+    }
+
+    // Adds one tracked body's joints. Returns its slot, -1 if all are taken.
+    int addBody(UINT64 trackingId, const Joint* joints) {
+        int slot = slots_.bind(trackingId);
+        if (slot < 0) return -1;
+        for (int j = 0; j < JointType_Count; ++j) {
+            if (joints[j].TrackingState != TrackingState_Tracked) continue;
+            size_t lane = laneOf(slot, j);
+            samples_[lane] = joints[j].Position.X;
+            samples_[lane + 1] = joints[j].Position.Y;
+            samples_[lane + 2] = joints[j].Position.Z;
+            hasSample_[lane] = hasSample_[lane + 1] = hasSample_[lane + 2] = true;
+        }
+        return slot;
+    }
+
+    void addBodies(const BodyFrameData& frame) {
+        for (int i = 0; i < BODY_COUNT; ++i) {
+            if (frame.bodies[i].isTracked) addBody(frame.bodies[i].trackingId, frame.bodies[i].joints);
+        }
+    }
+
+    // Releases bodies that were not added and updates every joint that has
+    // a sample this frame, one filter type at a time
+    void endFrame() {
+        slots_.endFrame([this](int slot) {
+            for (int j = 0; j < JointType_Count; ++j) resetJoint(slot, static_cast<JointType>(j));
+        });
+
+        updateLanes(SmoothingFilter_None, [this](size_t lane, float dt) {
+            (void)dt;
+            return samples_[lane];
+        });
+        updateLanes(SmoothingFilter_OneEuro, [this](size_t lane, float dt) {
+            return oneEuro_[lane].update(samples_[lane], dt, params_.oneEuro);
+        });
+        updateLanes(SmoothingFilter_DoubleExponential, [this](size_t lane, float dt) {
+            return doubleExponential_[lane].update(samples_[lane], dt, params_.doubleExponential);
+        });
+        updateLanes(SmoothingFilter_Kalman, [this](size_t lane, float dt) {
+            return kalman_[lane].update(samples_[lane], dt, params_.kalman);
+        });
+    }
+
+    int slotOf(UINT64 trackingId) const { return slots_.slotOf(trackingId); }
+    const BodySlots& slots() const { return slots_; }
+
+    // Smoothed position of a joint, false if it has never been tracked
+    // since its body appeared
+    bool smoothed(int slot, JointType joint, CameraSpacePoint& position) const {
+        if (slot < 0 || slot >= BODY_COUNT) return false;
+        size_t lane = laneOf(slot, joint);
+        if (lastTime_[lane] == NO_SAMPLE) return false;
+        position.X = output_[lane];
+        position.Y = output_[lane + 1];
+        position.Z = output_[lane + 2];
+        return true;
+    }
+
+private:
+    static const TIMESPAN NO_SAMPLE = -1;
+
+    static size_t laneOf(int slot, int joint) { return (static_cast<size_t>(slot) * JointType_Count + joint) * 3; }
+
+    // The lanes of each filter type, so a frame's update is one tight loop
+    // per type with no per-lane dispatch
+    void buildLaneLists() {
+        for (int type = 0; type < SmoothingFilter_Count; ++type) laneCount_[type] = 0;
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            for (int j = 0; j < JointType_Count; ++j) {
+                int type = jointFilters_[j];
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    lanes_[type][laneCount_[type]++] = static_cast<uint16_t>(laneOf(slot, j) + axis);
+                }
+            }
+        }
+    }
+
+    template<class Update>
+    void updateLanes(SmoothingFilterType type, Update update) {
+        const uint16_t* lanes = lanes_[type];
+        for (size_t i = 0, n = laneCount_[type]; i < n; ++i) {
+            size_t lane = lanes[i];
+            if (!hasSample_[lane]) continue;
+            float dt = lastTime_[lane] == NO_SAMPLE ? 0.0f : static_cast<float>(ticksToSeconds(frameTime_ - lastTime_[lane]));
+            output_[lane] = update(lane, dt);
+            lastTime_[lane] = frameTime_;
+        }
+    }
+
+    void resetJoint(int slot, JointType joint) {
+        size_t lane = laneOf(slot, joint);
+        for (size_t axis = 0; axis < 3; ++axis) resetLane(lane + axis);
+    }
+
+    void resetLane(size_t lane) {
+        oneEuro_[lane].reset();
+        doubleExponential_[lane].reset();
+        kalman_[lane].reset();
+        output_[lane] = 0.0f;
+        lastTime_[lane] = NO_SAMPLE;
+    }
+
+    SmoothingParams params_;
+    SmoothingFilterType jointFilters_[JointType_Count];
+    BodySlots slots_;
+    TIMESPAN frameTime_ = 0;
+
+    uint16_t lanes_[SmoothingFilter_Count][LANES];
+    size_t laneCount_[SmoothingFilter_Count];
+
+    float samples_[LANES];
+    bool hasSample_[LANES];
+    float output_[LANES];
+    TIMESPAN lastTime_[LANES];
+
+    OneEuroFilter oneEuro_[LANES];
+    DoubleExponentialFilter doubleExponential_[LANES];
+    KalmanFilter1D kalman_[LANES];
+};
@@ -0,0 +1,160 @@
+// Test results as JSON lines, one object per line, for runs nobody watches.
+// JsonResultWriter takes the ProtocolEngine's events and pairs each
+// Started with its Stopped or Aborted (per protocol, body slot and timer).
+// For every finished phase it writes one "test" record:
+//
+//   {"record":"test","source":"walk.ksession","test":"timed-up-and-go","slot":0,"timer":"",
+//    "start":3.412,"stop":13.051,"seconds":9.639,
+//    "phases":[{"until":"reached the target depth","seconds":4.870},{"until":"sat down","seconds":4.769}]}
+//
+// Times are seconds of sensor time from the start of the stream. A protocol's
+// notes while a timer runs split it into phases, each ending at the event
+// named by "until". Aborted timers are written as "aborted" records, and
+// each source ends with one "summary" record per protocol and a "session"
+// record with the frame count and the processing speed.
+#pragma once
+
+#include "FrameClock.h"
+#include "ProtocolEngine.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// `text` as a JSON string literal
+inline std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\r': quoted += "\\r"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                quoted += escaped;
+            } else {
+                quoted += c;
+            }
+        }
+    }
+    return quoted + "\"";
+}
+
+class JsonResultWriter {
+public:
+    explicit JsonResultWriter(std::ostream& out) : out_(out) {
+        out_ << std::fixed << std::setprecision(3);
+    }
+
+    // Names the stream the following records come from ("live" or a recording
+    // path) and forgets timers left open by the previous one
+    void beginSource(const std::string& source) {
+        source_ = source;
+        open_.clear();
+    }
+
+    void event(const ProtocolEvent& event) {
+        Key key(event.protocol, event.body, event.timer);
+        switch (event.type) {
+        case ProtocolEvent_Started:
+            open_[key] = Open{ event.time, event.time, {} };
+            break;
+        case ProtocolEvent_Note: {
+            auto it = open_.find(key);
+            if (it == open_.end()) break;
+            it->second.phases.emplace_back(event.message, ticksToSeconds(event.time - it->second.phaseStart));
+            it->second.phaseStart = event.time;
+            break;
+        }
+        case ProtocolEvent_Stopped: {
+            auto it = open_.find(key);
+            if (it == open_.end()) break;
+            it->second.phases.emplace_back(event.message, ticksToSeconds(event.time - it->second.phaseStart));
+            writeTest(event, it->second);
+            open_.erase(it);
+            break;
+        }
+        case ProtocolEvent_Aborted:
+            // Without a timer name the abort ends every timer of the body
+            for (auto it = open_.begin(); it != open_.end();) {
+                const Key& open = it->first;
+                if (std::get<0>(open) == event.protocol && std::get<1>(open) == event.body &&
+                    (event.timer[0] == '\0' || std::get<2>(open) == event.timer)) {
+                    writeAborted(event, std::get<2>(open), it->second);
+                    it = open_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            break;
+        }
+    }
+
+    void summary(const TestProtocol& protocol) {
+        ProtocolResult result = protocol.result();
+        out_ << "{\"record\":\"summary\",\"source\":" << jsonString(source_)
+             << ",\"test\":" << jsonString(protocol.name())
+             << ",\"complete\":" << (result.complete ? "true" : "false")
+             << ",\"seconds\":" << result.seconds
+             << ",\"summary\":" << jsonString(result.summary) << "}\n";
+        out_.flush();
+    }
+
+    // `streamSeconds` of sensor time processed in `wallSeconds`
+    void session(uint64_t frames, double streamSeconds, double wallSeconds) {
+        out_ << "{\"record\":\"session\",\"source\":" << jsonString(source_)
+             << ",\"frames\":" << frames
+             << ",\"stream_seconds\":" << streamSeconds
+             << ",\"wall_seconds\":" << wallSeconds
+             << ",\"speedup\":" << (wallSeconds > 0.0 ? streamSeconds / wallSeconds : 0.0) << "}\n";
+        out_.flush();
+    }
+
+private:
+    typedef std::tuple<std::string, int, std::string> Key; // protocol, body slot, timer
+
+    struct Open {
+        TIMESPAN start;
+        TIMESPAN phaseStart;
+        std::vector<std::pair<std::string, double>> phases; // ending event, seconds
+    };
+
+    void writeHead(const char* record, const ProtocolEvent& event, const std::string& timer, const Open& open) {
+        out_ << "{\"record\":\"" << record << "\",\"source\":" << jsonString(source_)
+             << ",\"test\":" << jsonString(event.protocol)
+             << ",\"slot\":" << event.body
+             << ",\"timer\":" << jsonString(timer)
+             << ",\"start\":" << ticksToSeconds(open.start)
+             << ",\"stop\":" << ticksToSeconds(event.time);
+    }
+
+    void writeTest(const ProtocolEvent& event, const Open& open) {
+        writeHead("test", event, event.timer, open);
+        out_ << ",\"seconds\":" << event.seconds << ",\"phases\":[";
+        for (size_t i = 0; i < open.phases.size(); ++i) {
+            out_ << (i ? "," : "") << "{\"until\":" << jsonString(open.phases[i].first)
+                 << ",\"seconds\":" << open.phases[i].second << "}";
+        }
+        out_ << "]}\n";
+        out_.flush();
+    }
+
+    void writeAborted(const ProtocolEvent& event, const std::string& timer, const Open& open) {
+        writeHead("aborted", event, timer, open);
+        out_ << ",\"reason\":" << jsonString(event.message) << "}\n";
+        out_.flush();
+    }
+
+    std::ostream& out_;
+    std::string source_;
+    std::map<Key, Open> open_;
+};
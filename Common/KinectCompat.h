@@ -0,0 +1,133 @@
+// Lets the shared code build with or without the Kinect for Windows SDK.
+// On Windows the real Kinect.h is used. Everywhere else (offline replay on
+// Linux) the few SDK types the programs rely on are declared here with the
+// same names, values and layouts.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <Kinect.h>
+
+#pragma comment(lib, "kinect20.lib")
+
+#else
+
+typedef int32_t HRESULT;
+typedef unsigned char BYTE;
+typedef unsigned char BOOLEAN;
+typedef uint16_t UINT16;
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef INT64 TIMESPAN; // 100 ns ticks, same as the SDK
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_PENDING ((HRESULT)0x8000000AL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#ifndef _countof
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#endif
+
+#define BODY_COUNT 6
+
+typedef enum _JointType {
+    JointType_SpineBase = 0,
+    JointType_SpineMid = 1,
+    JointType_Neck = 2,
+    JointType_Head = 3,
+    JointType_ShoulderLeft = 4,
+    JointType_ElbowLeft = 5,
+    JointType_WristLeft = 6,
+    JointType_HandLeft = 7,
+    JointType_ShoulderRight = 8,
+    JointType_ElbowRight = 9,
+    JointType_WristRight = 10,
+    JointType_HandRight = 11,
+    JointType_HipLeft = 12,
+    JointType_KneeLeft = 13,
+    JointType_AnkleLeft = 14,
+    JointType_FootLeft = 15,
+    JointType_HipRight = 16,
+    JointType_KneeRight = 17,
+    JointType_AnkleRight = 18,
+    JointType_FootRight = 19,
+    JointType_SpineShoulder = 20,
+    JointType_HandTipLeft = 21,
+    JointType_ThumbLeft = 22,
+    JointType_HandTipRight = 23,
+    JointType_ThumbRight = 24,
+    JointType_Count = 25
+} JointType;
+
+typedef enum _TrackingState {
+    TrackingState_NotTracked = 0,
+    TrackingState_Inferred = 1,
+    TrackingState_Tracked = 2
+} TrackingState;
+
+typedef struct _CameraSpacePoint {
+    float X;
+    float Y;
+    float Z;
+} CameraSpacePoint;
+
+typedef struct _ColorSpacePoint {
+    float X;
+    float Y;
+} ColorSpacePoint;
+
+typedef struct _DepthSpacePoint {
+    float X;
+    float Y;
+} DepthSpacePoint;
+
+typedef struct _Vector4 {
+    float x;
+    float y;
+    float z;
+    float w;
+} Vector4;
+
+// The SDK names these members after their types; the elaborated specifiers
+// keep that legal in C++.
+typedef struct _Joint {
+    enum _JointType JointType;
+    CameraSpacePoint Position;
+    enum _TrackingState TrackingState;
+} Joint;
+
+typedef struct _JointOrientation {
+    enum _JointType JointType;
+    Vector4 Orientation;
+} JointOrientation;
+
+#endif
+
+// Kinect v2 stream dimensions
+const int DEPTH_WIDTH = 512;
+const int DEPTH_HEIGHT = 424;
+const int COLOR_WIDTH = 1920;
+const int COLOR_HEIGHT = 1080;
+
+// TIMESPAN ticks per second
+const INT64 TICKS_PER_SECOND = 10000000;
+
+template<class Interface>
+inline void SafeRelease(Interface*& interfaceToRelease) {
+    if (interfaceToRelease) {
+        interfaceToRelease->Release();
+        interfaceToRelease = nullptr;
+    }
+}
@@ -0,0 +1,174 @@
+// Live Kinect v2 backend for the FrameSource contract, plus openFrameSource()
+// which picks the live sensor or a recorded session.
+#pragma once
+
+#include "ReplayFrameSource.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+
+class KinectFrameSource : public FrameSource {
+public:
+    ~KinectFrameSource() { close(); }
+
+    // Opens the sensor and a reader for every requested FrameStream flag
+    HRESULT open(UINT streams) {
+        HRESULT hr = GetDefaultKinectSensor(&sensor_);
+        if (FAILED(hr) || !sensor_) return FAILED(hr) ? hr : E_FAIL;
+
+        hr = sensor_->Open();
+        if (SUCCEEDED(hr)) hr = sensor_->get_CoordinateMapper(&coordinateMapper_);
+
+        if (SUCCEEDED(hr) && (streams & FrameStream_Depth)) {
+            IDepthFrameSource* source = nullptr;
+            hr = sensor_->get_DepthFrameSource(&source);
+            if (SUCCEEDED(hr)) hr = source->OpenReader(&depthReader_);
+            SafeRelease(source);
+        }
+        if (SUCCEEDED(hr) && (streams & FrameStream_BodyIndex)) {
+            IBodyIndexFrameSource* source = nullptr;
+            hr = sensor_->get_BodyIndexFrameSource(&source);
+            if (SUCCEEDED(hr)) hr = source->OpenReader(&bodyIndexReader_);
+            SafeRelease(source);
+        }
+        if (SUCCEEDED(hr) && (streams & FrameStream_Body)) {
+            IBodyFrameSource* source = nullptr;
+            hr = sensor_->get_BodyFrameSource(&source);
+            if (SUCCEEDED(hr)) hr = source->OpenReader(&bodyReader_);
+            SafeRelease(source);
+        }
+        if (SUCCEEDED(hr) && (streams & FrameStream_Color)) {
+            IColorFrameSource* source = nullptr;
+            hr = sensor_->get_ColorFrameSource(&source);
+            if (SUCCEEDED(hr)) hr = source->OpenReader(&colorReader_);
+            SafeRelease(source);
+        }
+
+        if (FAILED(hr)) close();
+        return hr;
+    }
+
+    void close() {
+        SafeRelease(depthReader_);
+        SafeRelease(bodyIndexReader_);
+        SafeRelease(bodyReader_);
+        SafeRelease(colorReader_);
+        SafeRelease(coordinateMapper_);
+        if (sensor_) sensor_->Close();
+        SafeRelease(sensor_);
+    }
+
+    HRESULT AcquireLatestDepthFrame(DepthFrameData& frame) override {
+        if (!depthReader_) return E_PENDING;
+
+        IDepthFrame* depthFrame = nullptr;
+        HRESULT hr = depthReader_->AcquireLatestFrame(&depthFrame);
+        if (SUCCEEDED(hr)) hr = depthFrame->get_RelativeTime(&frame.relativeTime);
+        if (SUCCEEDED(hr)) hr = depthFrame->CopyFrameDataToArray(static_cast<UINT>(frame.pixels.size()), frame.pixels.data());
+        SafeRelease(depthFrame);
+        return hr;
+    }
+
+    HRESULT AcquireLatestBodyIndexFrame(BodyIndexFrameData& frame) override {
+        if (!bodyIndexReader_) return E_PENDING;
+
+        IBodyIndexFrame* bodyIndexFrame = nullptr;
+        HRESULT hr = bodyIndexReader_->AcquireLatestFrame(&bodyIndexFrame);
+        if (SUCCEEDED(hr)) hr = bodyIndexFrame->get_RelativeTime(&frame.relativeTime);
+        if (SUCCEEDED(hr)) hr = bodyIndexFrame->CopyFrameDataToArray(static_cast<UINT>(frame.pixels.size()), frame.pixels.data());
+        SafeRelease(bodyIndexFrame);
+        return hr;
+    }
+
+    HRESULT AcquireLatestBodyFrame(BodyFrameData& frame) override {
+        if (!bodyReader_) return E_PENDING;
+
+        IBodyFrame* bodyFrame = nullptr;
+        HRESULT hr = bodyReader_->AcquireLatestFrame(&bodyFrame);
+        if (SUCCEEDED(hr)) hr = bodyFrame->get_RelativeTime(&frame.relativeTime);
+
+        IBody* bodies[BODY_COUNT] = { 0 };
+        if (SUCCEEDED(hr)) hr = bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
+
+        if (SUCCEEDED(hr)) {
+            for (int i = 0; i < BODY_COUNT; ++i) {
+                BodyData& body = frame.bodies[i];
+                BOOLEAN isTracked = false;
+                if (bodies[i]) bodies[i]->get_IsTracked(&isTracked);
+
+                body.isTracked = isTracked != 0;
+                body.trackingId = 0;
+                if (body.isTracked) {
+                    bodies[i]->get_TrackingId(&body.trackingId);
+                    bodies[i]->GetJoints(_countof(body.joints), body.joints);
+                    bodies[i]->GetJointOrientations(_countof(body.orientations), body.orientations);
+                }
+            }
+        }
+
+        for (int i = 0; i < BODY_COUNT; ++i) {
+            SafeRelease(bodies[i]);
+        }
+        SafeRelease(bodyFrame);
+        return hr;
+    }
+
+    HRESULT AcquireLatestColorFrame(ColorFrameData& frame) override {
+        if (!colorReader_) return E_PENDING;
+
+        IColorFrame* colorFrame = nullptr;
+        HRESULT hr = colorReader_->AcquireLatestFrame(&colorFrame);
+        if (SUCCEEDED(hr)) hr = colorFrame->get_RelativeTime(&frame.relativeTime);
+        if (SUCCEEDED(hr)) {
+            hr = colorFrame->CopyConvertedFrameDataToArray(static_cast<UINT>(frame.bgra.size()), frame.bgra.data(), ColorImageFormat_Bgra);
+        }
+        SafeRelease(colorFrame);
+        return hr;
+    }
+
+    HRESULT MapCameraPointsToColorSpace(UINT cameraPointCount, const CameraSpacePoint* cameraPoints,
+        UINT colorPointCount, ColorSpacePoint* colorPoints) override {
+        if (!coordinateMapper_) return E_FAIL;
+        return coordinateMapper_->MapCameraPointsToColorSpace(cameraPointCount, cameraPoints, colorPointCount, colorPoints);
+    }
+
+private:
+    IKinectSensor* sensor_ = nullptr;
+    ICoordinateMapper* coordinateMapper_ = nullptr;
+    IDepthFrameReader* depthReader_ = nullptr;
+    IBodyIndexFrameReader* bodyIndexReader_ = nullptr;
+    IBodyFrameReader* bodyReader_ = nullptr;
+    IColorFrameReader* colorReader_ = nullptr;
+};
+
+#endif
+
+// Opens the recorded session at `replayPath`, or the live sensor when the path
+// is empty. Prints the reason and returns nullptr on failure.
+inline std::unique_ptr<FrameSource> openFrameSource(const std::string& replayPath, UINT streams, double replaySpeed = 0.0) {
+    if (!replayPath.empty()) {
+        std::unique_ptr<ReplayFrameSource> replay(new ReplayFrameSource(replaySpeed));
+        if (!replay->open(replayPath)) {
+            std::cerr << "Failed to open recorded session: " << replayPath << std::endl;
+            return nullptr;
+        }
+        return replay;
+    }
+
+#ifdef _WIN32
+    std::unique_ptr<KinectFrameSource> kinect(new KinectFrameSource());
+    HRESULT hr = kinect->open(streams);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to initialize Kinect sensor! HRESULT: " << hr << std::endl;
+        return nullptr;
+    }
+    return kinect;
+#else
+    (void)streams;
+    std::cerr << "No Kinect runtime on this platform, pass a recorded session to replay." << std::endl;
+    return nullptr;
+#endif
+}
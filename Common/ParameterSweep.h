@@ -0,0 +1,344 @@
+// Tuning the test thresholds against labelled recordings. A sweep runs the
+// protocols over the same recordings once per parameter set and scores each
+// set against hand-labelled test times:
+//
+//   error    seconds off per label: |measured - labelled| for a matched
+//            label, the labelled time for a missed one, plus the measured
+//            time of every timed phase no label matches
+//   latency  mean time from a labelled start or stop to the frame the
+//            protocol reported it on (negative when it reports early)
+//
+// Sets no other set beats on both are the Pareto front.
+//
+// Each recording is decoded once into a DecodedSession: its synchronized
+// body frames and the torso distance of each depth frame, neither of which
+// depends on the swept parameters. Every parameter set replays the shared
+// sessions with playSession(), so a sweep reads and measures each file once
+// however many sets it tries. The sessions are read-only after decoding and
+// can be played by many threads at once.
+//
+// Labels are CSV lines "recording,test,start,stop": the recording path,
+// the protocol name (walking-speed, timed-up-and-go, one-leg-stand) and the
+// true start and stop in seconds of sensor time, the time base of the Batch
+// Runner's records.
+#pragma once
+
+#include "ReplayFrameSource.h"
+#include "TestProtocols.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Everything a sweep can vary
+struct SweepParams {
+    // Walking gate positions in metres: the setup the recordings were made
+    // with, the runners' defaults unless set. Not swept.
+    float walkStartDistance = WALK_START_DISTANCE;
+    float walkStopDistance = WALK_STOP_DISTANCE;
+    GateParams gate;           // walking-speed gates
+    TugParams tug;
+    OneLegStandParams oneLeg;
+    OneEuroParams smoothing;   // shared joint smoothing (read by the TUG)
+};
+
+struct SweepParameter {
+    const char* name;
+    float& (*field)(SweepParams& params);
+};
+
+const SweepParameter SWEEP_PARAMETERS[] = {
+    { "walk.hysteresis", [](SweepParams& p) -> float& { return p.gate.hysteresis; } },
+    { "tug.chair_depth", [](SweepParams& p) -> float& { return p.tug.chairDepth; } },
+    { "tug.target_depth", [](SweepParams& p) -> float& { return p.tug.targetDepth; } },
+    { "tug.y_change", [](SweepParams& p) -> float& { return p.tug.yChangeThreshold; } },
+    { "tug.depth_tolerance", [](SweepParams& p) -> float& { return p.tug.depthTolerance; } },
+    { "tug.y_tolerance", [](SweepParams& p) -> float& { return p.tug.yCoordTolerance; } },
+    { "tug.knee_flexion", [](SweepParams& p) -> float& { return p.tug.kneeFlexionThreshold; } },
+    { "one_leg.raise_z", [](SweepParams& p) -> float& { return p.oneLeg.footRaiseThresholdZ; } },
+    { "one_leg.raise_y", [](SweepParams& p) -> float& { return p.oneLeg.footRaiseThresholdY; } },
+    { "smooth.min_cutoff", [](SweepParams& p) -> float& { return p.smoothing.minCutoff; } },
+    { "smooth.beta", [](SweepParams& p) -> float& { return p.smoothing.beta; } }
+};
+
+inline const SweepParameter* findSweepParameter(const std::string& name) {
+    for (const SweepParameter& parameter : SWEEP_PARAMETERS) {
+        if (name == parameter.name) return &parameter;
+    }
+    return nullptr;
+}
+
+// Bits of the tests a sweep runs, in protocol order
+enum SweepTest : unsigned {
+    SweepTest_Walk = 0x1,
+    SweepTest_Tug = 0x2,
+    SweepTest_OneLeg = 0x4
+};
+
+inline unsigned sweepTestOf(const std::string& protocol) {
+    if (protocol == "walking-speed") return SweepTest_Walk;
+    if (protocol == "timed-up-and-go") return SweepTest_Tug;
+    if (protocol == "one-leg-stand") return SweepTest_OneLeg;
+    return 0;
+}
+
+class DecodedSession {
+public:
+    struct Frame {
+        TIMESPAN relativeTime = 0;
+        UINT streams = 0;     // FrameStream flags present in the bundle
+        int body = -1;        // index into bodies(), -1 without a body frame
+        DepthRoiResult torso; // valid with a depth frame
+    };
+
+    // Reads the whole recording; false if it cannot be opened
+    bool decode(const std::string& path) {
+        path_ = path;
+        frames_.clear();
+        bodies_.clear();
+
+        ReplayFrameSource source(0.0);
+        if (!source.open(path)) return false;
+        UINT streams = source.header().streams & (FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body);
+        if (!streams) return false;
+        FrameSynchronizer sync(streams, (streams & FrameStream_Body) ? FrameStream_Body : FrameStream_Depth, MissingStream_Partial);
+        DepthRoi roi;
+        roi.setBudget(0.0); // every row, as the Batch Runner scores recordings
+
+        FrameBundle bundle;
+        for (;;) {
+            bool finished = source.IsFinished();
+            if (finished) sync.flush();
+            sync.poll(source);
+            bool popped = false;
+            while (sync.pop(bundle)) {
+                popped = true;
+                Frame frame;
+                frame.relativeTime = bundle.relativeTime;
+                frame.streams = bundle.streams;
+                if (bundle.has(FrameStream_Body)) {
+                    frame.body = static_cast<int>(bodies_.size());
+                    bodies_.push_back(*bundle.body);
+                }
+                if (bundle.has(FrameStream_Depth)) {
+                    if (bundle.has(FrameStream_BodyIndex)) roi.measure(bundle.depth->pixels.data(), bundle.bodyIndex->pixels.data(), frame.torso);
+                    else roi.measure(bundle.depth->pixels.data(), frame.torso);
+                }
+                frames_.push_back(frame);
+            }
+            if (!popped && finished) break;
+        }
+        return true;
+    }
+
+    const std::string& path() const { return path_; }
+    const std::vector<Frame>& frames() const { return frames_; }
+    const BodyFrameData& body(int index) const { return bodies_[index]; }
+
+private:
+    std::string path_;
+    std::vector<Frame> frames_;
+    std::vector<BodyFrameData> bodies_;
+};
+
+// A protocol event and the frame it was reported on
+struct SweepEvent {
+    ProtocolEvent event;
+    TIMESPAN reportedAt;
+};
+
+// Runs the `tests` (SweepTest bits) with `params` over `session` the way
+// ProtocolEngine would, and returns every event raised
+inline std::vector<SweepEvent> playSession(const DecodedSession& session, const SweepParams& params, unsigned tests) {
+    WalkingSpeedProtocol walk(params.walkStartDistance, params.walkStopDistance, params.gate);
+    TugProtocol tug(SessionMode_Concurrent, params.tug);
+    OneLegStandProtocol oneLeg(params.oneLeg);
+    std::vector<TestProtocol*> protocols;
+    if (tests & SweepTest_Walk) protocols.push_back(&walk);
+    if (tests & SweepTest_Tug) protocols.push_back(&tug);
+    if (tests & SweepTest_OneLeg) protocols.push_back(&oneLeg);
+
+    SmoothingParams smoothing;
+    smoothing.oneEuro = params.smoothing;
+    JointSmoother smoother(SmoothingFilter_OneEuro, smoothing);
+    JointAngleEngine angles;
+    bool kneeAngles = (tests & SweepTest_Tug) && params.tug.kneeFlexionThreshold > 0.0f;
+    FramePool<BodyFrameData> bodyPool(1);
+    FrameBundle bundle;
+    bundle.body = bodyPool.lease();
+
+    std::vector<ProtocolEvent> frameEvents;
+    std::vector<SweepEvent> events;
+    for (const DecodedSession::Frame& decoded : session.frames()) {
+        ProtocolFrame frame;
+        frame.relativeTime = decoded.relativeTime;
+        frame.bundle = &bundle;
+        bundle.relativeTime = decoded.relativeTime;
+        bundle.streams = decoded.streams & ~(FrameStream_Depth | FrameStream_BodyIndex); // only the torso distance is kept
+        if (decoded.body >= 0) {
+            *bundle.body = session.body(decoded.body);
+            if (tests & SweepTest_Tug) {
+                smoother.beginFrame(decoded.relativeTime);
+                smoother.addBodies(*bundle.body);
+                smoother.endFrame();
+                frame.joints = &smoother;
+            }
+            if (kneeAngles) {
+                angles.beginFrame(decoded.relativeTime);
+                angles.addBodies(*bundle.body, &smoother);
+                angles.endFrame();
+                frame.angles = &angles;
+            }
+        }
+        if (decoded.streams & FrameStream_Depth) frame.torso = &decoded.torso;
+
+        frameEvents.clear();
+        for (TestProtocol* protocol : protocols) protocol->onFrame(frame, frameEvents);
+        for (ProtocolEvent& event : frameEvents) {
+            for (TestProtocol* protocol : protocols) protocol->onEvent(event);
+            events.push_back({ std::move(event), decoded.relativeTime });
+        }
+    }
+    return events;
+}
+
+struct SweepLabel {
+    std::string recording;
+    std::string test; // protocol name
+    double start = 0.0;
+    double stop = 0.0;
+};
+
+// Reads "recording,test,start,stop" lines; a first line that does not parse is taken as a header
+inline bool readSweepLabels(const std::string& path, std::vector<SweepLabel>& labels, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Failed to open " + path;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        SweepLabel label;
+        std::string start, stop;
+        std::getline(fields, label.recording, ',');
+        std::getline(fields, label.test, ',');
+        std::getline(fields, start, ',');
+        std::getline(fields, stop, ',');
+        char* end = nullptr;
+        label.start = std::strtod(start.c_str(), &end);
+        bool ok = !start.empty() && *end == '\0';
+        label.stop = std::strtod(stop.c_str(), &end);
+        ok = ok && !stop.empty() && *end == '\0' && sweepTestOf(label.test) != 0 && label.stop > label.start;
+        if (!ok) {
+            if (number == 1) continue;
+            error = path + ":" + std::to_string(number) + ": expected recording,test,start,stop";
+            return false;
+        }
+        labels.push_back(label);
+    }
+    return true;
+}
+
+struct SweepScore {
+    double error = 0.0;   // s per label
+    double latency = std::numeric_limits<double>::infinity(); // s, infinite when no label matched
+    int matched = 0;
+    int missed = 0;
+    int falsePasses = 0;
+};
+
+// Adds one session's events to the running totals of `score`, against the
+// labels of that session. Call finishSweepScore() once every session is in.
+inline void scoreSweepSession(const std::vector<SweepEvent>& events, const std::vector<const SweepLabel*>& labels,
+    SweepScore& score, double& errorSum, double& latencySum) {
+    // Completed timed phases, paired per protocol, body slot and timer
+    struct Phase {
+        std::string test;
+        double start, stop, startReported, stopReported;
+        bool matched;
+    };
+    std::vector<Phase> phases;
+    std::map<std::tuple<std::string, int, std::string>, SweepEvent> open;
+    for (const SweepEvent& item : events) {
+        const ProtocolEvent& event = item.event;
+        auto key = std::make_tuple(std::string(event.protocol), event.body, std::string(event.timer));
+        if (event.type == ProtocolEvent_Started) {
+            open[key] = item;
+        } else if (event.type == ProtocolEvent_Stopped) {
+            auto it = open.find(key);
+            if (it == open.end()) continue;
+            phases.push_back({ event.protocol, ticksToSeconds(it->second.event.time), ticksToSeconds(event.time),
+                ticksToSeconds(it->second.reportedAt), ticksToSeconds(item.reportedAt), false });
+            open.erase(it);
+        } else if (event.type == ProtocolEvent_Aborted) {
+            for (auto it = open.begin(); it != open.end();) {
+                if (std::get<0>(it->first) == event.protocol && std::get<1>(it->first) == event.body &&
+                    (event.timer[0] == '\0' || std::get<2>(it->first) == event.timer)) it = open.erase(it);
+                else ++it;
+            }
+        }
+    }
+
+    // Each label takes the unmatched phase of its test that overlaps it most
+    for (const SweepLabel* label : labels) {
+        Phase* best = nullptr;
+        double bestOverlap = 0.0;
+        for (Phase& phase : phases) {
+            if (phase.matched || phase.test != label->test) continue;
+            double overlap = std::min(phase.stop, label->stop) - std::max(phase.start, label->start);
+            if (overlap > bestOverlap) {
+                best = &phase;
+                bestOverlap = overlap;
+            }
+        }
+        double labelled = label->stop - label->start;
+        if (!best) {
+            ++score.missed;
+            errorSum += labelled;
+            continue;
+        }
+        best->matched = true;
+        ++score.matched;
+        errorSum += std::fabs((best->stop - best->start) - labelled);
+        latencySum += ((best->startReported - label->start) + (best->stopReported - label->stop)) / 2.0;
+    }
+    for (const Phase& phase : phases) {
+        if (phase.matched) continue;
+        ++score.falsePasses;
+        errorSum += phase.stop - phase.start;
+    }
+}
+
+inline void finishSweepScore(SweepScore& score, size_t labels, double errorSum, double latencySum) {
+    score.error = labels ? errorSum / labels : 0.0;
+    if (score.matched > 0) score.latency = latencySum / score.matched;
+}
+
+// Indices of the scores no other score beats on both error and latency, by increasing error
+inline std::vector<size_t> paretoFront(const std::vector<SweepScore>& scores) {
+    std::vector<size_t> order(scores.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (scores[a].error != scores[b].error) return scores[a].error < scores[b].error;
+        return scores[a].latency < scores[b].latency;
+    });
+    std::vector<size_t> front;
+    double bestLatency = std::numeric_limits<double>::infinity();
+    for (size_t i : order) {
+        if (front.empty() || scores[i].latency < bestLatency) {
+            front.push_back(i);
+            bestLatency = scores[i].latency;
+        }
+    }
+    return front;
+}
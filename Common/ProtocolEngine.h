@@ -0,0 +1,276 @@
+// One acquisition and processing pipeline for every clinical test. Each test
+// program used to open the sensor, run its own frame loop, smooth its own
+// joints and keep its own timers. With the engine, a test is a TestProtocol
+// plugin. The engine reads the source once, pairs the streams by timestamp
+// and computes the shared per-frame data once: smoothed joints, the clinical
+// joint angles (Common/JointAngles.h) and the torso distance. It then hands
+// the same frame to every protocol it is running. Protocols can be added and
+// removed between frames without reopening the sensor, and several can run
+// over the same frames at once.
+//
+// Per frame, each protocol's onFrame() may raise events (timer started,
+// stopped, ...). Once every protocol has seen the frame, each event is passed
+// to the onEvent() of every protocol, so one test can react to another.
+//
+// With setTrace(), the engine writes its timeline to a TraceWriter: polling
+// and pairing, each bundle's smoothing, joint angles, depth ROI and protocol
+// passes, every event raised, and gaps in the anchor stream longer than 1.5
+// frames.
+#pragma once
+
+#include "DepthRoi.h"
+#include "FrameSynchronizer.h"
+#include "JointAngles.h"
+#include "JointSmoothing.h"
+#include "TraceWriter.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One synchronized frame as the protocols see it
+struct ProtocolFrame {
+    TIMESPAN relativeTime = 0;             // anchor frame time
+    const FrameBundle* bundle = nullptr;   // the raw frames; check bundle->has(stream)
+    const JointSmoother* joints = nullptr; // smoothed joints, null without a body frame
+    const JointAngleEngine* angles = nullptr; // angles of the smoothed joints, null without a body frame
+    const DepthRoiResult* torso = nullptr; // distance to the person in view, null without a depth frame
+};
+
+enum ProtocolEventType {
+    ProtocolEvent_Started, // a timed phase began
+    ProtocolEvent_Stopped, // a timed phase ended with a result
+    ProtocolEvent_Aborted, // a timed phase was abandoned (subject lost, ...)
+    ProtocolEvent_Note     // anything else worth logging
+};
+
+struct ProtocolEvent {
+    ProtocolEventType type = ProtocolEvent_Note;
+    const char* protocol = "";  // name() of the protocol that raised it
+    TIMESPAN time = 0;          // sensor time the event happened at
+    int body = -1;              // session slot, -1 when not per body
+    const char* timer = "";     // which timer, for protocols running several per body
+    double seconds = 0.0;       // measured time, for ProtocolEvent_Stopped
+    std::string message;
+};
+
+struct ProtocolResult {
+    bool complete = false; // at least one timed phase finished
+    double seconds = 0.0;  // the latest measured time
+    std::string summary;
+};
+
+class TestProtocol {
+public:
+    virtual ~TestProtocol() = default;
+
+    virtual const char* name() const = 0;
+
+    // FrameStream flags the protocol reads
+    virtual UINT streams() const = 0;
+
+    virtual void onFrame(const ProtocolFrame& frame, std::vector<ProtocolEvent>& events) = 0;
+
+    // Every event raised during the frame, by any protocol including this one
+    virtual void onEvent(const ProtocolEvent& event) { (void)event; }
+
+    virtual ProtocolResult result() const = 0;
+
+    // Lines for an on-screen overlay; `now` is the time of the frame shown
+    virtual void status(TIMESPAN now, std::vector<std::string>& lines) const = 0;
+
+    // Back to the state before the first frame
+    virtual void reset() = 0;
+
+protected:
+    // Appends an event and returns it, for callers setting the optional fields
+    ProtocolEvent& raise(std::vector<ProtocolEvent>& events, ProtocolEventType type, TIMESPAN time, int body,
+        const std::string& message, double seconds = 0.0) const {
+        ProtocolEvent event;
+        event.type = type;
+        event.protocol = name();
+        event.time = time;
+        event.body = body;
+        event.seconds = seconds;
+        event.message = message;
+        events.push_back(std::move(event));
+        return events.back();
+    }
+};
+
+class ProtocolEngine {
+public:
+    // `streams` are the FrameStream flags `source` was opened with. Body
+    // frames drive the engine when they are among them, depth frames otherwise.
+    ProtocolEngine(FrameSource& source, UINT streams)
+        : source_(source), streams_(streams),
+          sync_(streams, (streams & FrameStream_Body) ? FrameStream_Body : FrameStream_Depth, MissingStream_Partial),
+          smoother_(SmoothingFilter_OneEuro) {}
+
+    // Starts running `protocol` (owned by the caller) from the next frame.
+    // Returns false if it needs a stream the source was not opened with.
+    bool add(TestProtocol& protocol) {
+        if ((protocol.streams() & streams_) != protocol.streams()) return false;
+        if (std::find(protocols_.begin(), protocols_.end(), &protocol) == protocols_.end()) protocols_.push_back(&protocol);
+        return true;
+    }
+
+    void remove(TestProtocol& protocol) {
+        protocols_.erase(std::remove(protocols_.begin(), protocols_.end(), &protocol), protocols_.end());
+    }
+
+    void clear() { protocols_.clear(); }
+
+    const std::vector<TestProtocol*>& protocols() const { return protocols_; }
+
+    // Time allowed per depth ROI pass before it samples fewer rows; 0 (for
+    // offline scoring) measures every row, so results do not depend on load
+    void setDepthBudget(double milliseconds) { depthRoi_.setBudget(milliseconds); }
+
+    // Writes the engine's timeline to `trace` (owned by the caller, null to stop)
+    void setTrace(TraceWriter* trace) { trace_ = trace; }
+
+    // Processes every bundle that is ready. Returns false once a recording
+    // has been played to the end and drained.
+    bool step() {
+        stepEvents_.clear();
+        // Checked before polling: frames read by this poll must still be popped
+        bool finished = source_.IsFinished();
+        {
+            TraceSpan span(trace_, "engine", "poll and pair");
+            if (finished) sync_.flush();
+            sync_.poll(source_);
+        }
+        if (trace_ && sync_.droppedBundles() != droppedBundles_) {
+            trace_->instant("frames", "bundles dropped", "count", static_cast<double>(sync_.droppedBundles() - droppedBundles_));
+            droppedBundles_ = sync_.droppedBundles();
+        }
+
+        bool popped = false;
+        while (sync_.pop(bundle_)) {
+            popped = true;
+            process(bundle_);
+            // Keep the newest frame with color for drawing
+            if (bundle_.has(FrameStream_Color)) {
+                std::swap(bundle_, display_);
+                hasDisplay_ = true;
+            }
+        }
+        return popped || !finished;
+    }
+
+    // Newest processed bundle that has a color frame
+    bool hasDisplay() const { return hasDisplay_; }
+    const FrameBundle& display() const { return display_; }
+
+    // Events raised during the last step(), in order. The engine keeps no
+    // older ones, so a live run can go on indefinitely; callers copy what
+    // they need before the next step().
+    const std::vector<ProtocolEvent>& events() const { return stepEvents_; }
+
+    uint64_t frames() const { return frames_; }
+
+    // Anchor times of the first and the newest processed frame
+    TIMESPAN firstTime() const { return firstTime_; }
+    TIMESPAN time() const { return time_; }
+
+    FrameSource& source() { return source_; }
+    const FrameSynchronizer& synchronizer() const { return sync_; }
+
+    // Filters used for the shared smoothed joints
+    JointSmoother& smoother() { return smoother_; }
+    const JointSmoother& smoother() const { return smoother_; }
+
+    // Clinical joint angles of the last body frame, with their history
+    const JointAngleEngine& angles() const { return angles_; }
+
+private:
+    // Stream flags read by any running protocol
+    UINT needed() const {
+        UINT streams = 0;
+        for (const TestProtocol* protocol : protocols_) streams |= protocol->streams();
+        return streams;
+    }
+
+    void process(const FrameBundle& bundle) {
+        TraceSpan span(trace_, "engine", "process");
+        if (trace_) {
+            trace_->instant("frames", "bundle", "sensor_ms", ticksToSeconds(bundle.relativeTime) * 1000.0);
+            // The anchor stream runs at 30 Hz; a longer gap is a dropped frame
+            if (frames_ > 0 && bundle.relativeTime - time_ > FRAME_GAP) {
+                trace_->instant("frames", "frame gap", "gap_ms", ticksToSeconds(bundle.relativeTime - time_) * 1000.0);
+            }
+        }
+
+        ProtocolFrame frame;
+        frame.relativeTime = bundle.relativeTime;
+        frame.bundle = &bundle;
+
+        // Shared data, computed only when a running protocol reads the stream
+        UINT used = needed();
+        if ((used & FrameStream_Body) && bundle.has(FrameStream_Body)) {
+            TraceSpan smoothSpan(trace_, "engine", "smooth joints");
+            smoother_.beginFrame(bundle.relativeTime);
+            smoother_.addBodies(*bundle.body);
+            smoother_.endFrame();
+            frame.joints = &smoother_;
+
+            TraceSpan anglesSpan(trace_, "engine", "joint angles");
+            angles_.beginFrame(bundle.relativeTime);
+            angles_.addBodies(*bundle.body, &smoother_);
+            angles_.endFrame();
+            frame.angles = &angles_;
+        }
+        if ((used & FrameStream_Depth) && bundle.has(FrameStream_Depth)) {
+            TraceSpan roiSpan(trace_, "engine", "depth roi");
+            if (bundle.has(FrameStream_BodyIndex)) {
+                depthRoi_.measure(bundle.depth->pixels.data(), bundle.bodyIndex->pixels.data(), torso_);
+            } else {
+                depthRoi_.measure(bundle.depth->pixels.data(), torso_);
+            }
+            frame.torso = &torso_;
+        }
+
+        frameEvents_.clear();
+        {
+            TraceSpan protocolSpan(trace_, "engine", "protocols");
+            for (TestProtocol* protocol : protocols_) protocol->onFrame(frame, frameEvents_);
+            for (const ProtocolEvent& event : frameEvents_) {
+                for (TestProtocol* protocol : protocols_) protocol->onEvent(event);
+                stepEvents_.push_back(event);
+            }
+        }
+        if (trace_) {
+            for (const ProtocolEvent& event : frameEvents_) {
+                trace_->instant("protocol", std::string(event.protocol) + ": " + event.message, "sensor_ms", ticksToSeconds(event.time) * 1000.0);
+            }
+        }
+        if (frames_++ == 0) firstTime_ = bundle.relativeTime;
+        time_ = bundle.relativeTime;
+    }
+
+    static constexpr TIMESPAN FRAME_GAP = TICKS_PER_SECOND / 20; // 1.5 frames at 30 Hz
+
+    FrameSource& source_;
+    UINT streams_;
+    FrameSynchronizer sync_;
+    FrameBundle bundle_;
+    FrameBundle display_;
+    bool hasDisplay_ = false;
+
+    std::vector<TestProtocol*> protocols_;
+    JointSmoother smoother_;
+    JointAngleEngine angles_;
+    DepthRoi depthRoi_;
+    DepthRoiResult torso_;
+
+    std::vector<ProtocolEvent> frameEvents_;
+    std::vector<ProtocolEvent> stepEvents_;
+    uint64_t frames_ = 0;
+    TIMESPAN firstTime_ = 0;
+
+    TraceWriter* trace_ = nullptr;
+    uint64_t droppedBundles_ = 0;
+    TIMESPAN time_ = 0;
+};
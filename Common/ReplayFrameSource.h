@@ -0,0 +1,257 @@
+// Replays a recorded .ksession file through the FrameSource contract so the
+// test programs can run without a sensor, on any platform.
+#pragma once
+
+#include "SessionIndex.h"
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+// Nominal Kinect v2 color camera intrinsics, used instead of the sensor's
+// coordinate mapper during replay. Good to a few pixels for overlays.
+const float REPLAY_COLOR_FX = 1081.37f;
+const float REPLAY_COLOR_FY = 1081.37f;
+const float REPLAY_COLOR_CX = 959.5f;
+const float REPLAY_COLOR_CY = 539.5f;
+
+class ReplayFrameSource : public FrameSource {
+public:
+    // speed <= 0 hands out every recorded frame as fast as it is consumed;
+    // speed > 0 follows the recorded timestamps (1.0 = real time).
+    explicit ReplayFrameSource(double speed = 0.0) : speed_(speed) {}
+
+    bool open(const std::string& path) {
+        path_ = path;
+        indexOpen_ = false;
+        endTime_ = INT64_MAX;
+        resetPlayback();
+        return reader_.open(path);
+    }
+
+    // Jumps to the last keyframe at or before `time` using the session's
+    // memory-mapped index, so only the requested window is read
+    bool seek(TIMESPAN time) {
+        if (!indexOpen_) indexOpen_ = index_.open(path_);
+        if (!indexOpen_ || index_.size() == 0) return false;
+
+        resetPlayback();
+        return reader_.seek(index_[index_.seekKeyFrame(time)].offset);
+    }
+
+    // Treats records after `time` as the end of the session
+    void setEndTime(TIMESPAN time) { endTime_ = time; }
+
+    const SessionFileHeader& header() const { return reader_.header(); }
+
+    HRESULT AcquireLatestDepthFrame(DepthFrameData& frame) override {
+        return acquire(FrameStream_Depth, depth_, frame);
+    }
+
+    HRESULT AcquireLatestBodyIndexFrame(BodyIndexFrameData& frame) override {
+        return acquire(FrameStream_BodyIndex, bodyIndex_, frame);
+    }
+
+    HRESULT AcquireLatestBodyFrame(BodyFrameData& frame) override {
+        return acquire(FrameStream_Body, body_, frame);
+    }
+
+    HRESULT AcquireLatestColorFrame(ColorFrameData& frame) override {
+        return acquire(FrameStream_Color, color_, frame);
+    }
+
+    HRESULT MapCameraPointsToColorSpace(UINT cameraPointCount, const CameraSpacePoint* cameraPoints,
+        UINT colorPointCount, ColorSpacePoint* colorPoints) override {
+        if (!cameraPoints || !colorPoints || colorPointCount < cameraPointCount) return E_INVALIDARG;
+
+        for (UINT i = 0; i < cameraPointCount; ++i) {
+            const CameraSpacePoint& p = cameraPoints[i];
+            if (p.Z <= 0.0f) {
+                colorPoints[i] = { -1.0f, -1.0f };
+                continue;
+            }
+            colorPoints[i].X = REPLAY_COLOR_CX + REPLAY_COLOR_FX * p.X / p.Z;
+            colorPoints[i].Y = REPLAY_COLOR_CY - REPLAY_COLOR_FY * p.Y / p.Z;
+        }
+        return S_OK;
+    }
+
+    // Finished once the file is exhausted and either every stream the consumer
+    // reads has been handed out or it keeps coming back empty-handed
+    bool IsFinished() const override {
+        if (!finished_) return false;
+        if (emptyAfterEnd_ >= 2) return true;
+        for (uint32_t stream = FrameStream_Depth; stream <= FrameStream_Color; stream <<= 1) {
+            if ((requested_ & stream) && isFresh(stream)) return false;
+        }
+        return true;
+    }
+
+private:
+    template<class Frame>
+    struct Slot {
+        Frame frame;
+        bool fresh = false;
+    };
+
+    void resetPlayback() {
+        finished_ = false;
+        emptyAfterEnd_ = 0;
+        hasPending_ = false;
+        clockStarted_ = false;
+        requested_ = 0;
+        for (int i = 0; i < 4; ++i) {
+            deliveries_[i] = blockedAt_[i] = 0;
+            blockedOn_[i] = 0;
+        }
+        depth_.fresh = bodyIndex_.fresh = body_.fresh = color_.fresh = false;
+    }
+
+    template<class Frame>
+    HRESULT acquire(uint32_t stream, Slot<Frame>& slot, Frame& frame) {
+        if (!(reader_.header().streams & stream)) return E_PENDING;
+        requested_ |= stream;
+
+        if (speed_ > 0.0) {
+            advanceTo(replayTime());
+        }
+        else if (!slot.fresh) {
+            advanceUntil(stream);
+        }
+
+        if (!slot.fresh) {
+            if (finished_) ++emptyAfterEnd_;
+            return E_PENDING;
+        }
+        // Hand over the slot's buffers and keep the caller's old ones for the
+        // next read, so delivering a frame never copies pixel data
+        using std::swap;
+        swap(frame, slot.frame);
+        slot.fresh = false;
+        emptyAfterEnd_ = 0;
+        ++deliveries_[streamIndex(stream)];
+        return S_OK;
+    }
+
+    static int streamIndex(uint32_t stream) {
+        switch (stream) {
+        case FrameStream_Depth: return 0;
+        case FrameStream_BodyIndex: return 1;
+        case FrameStream_Body: return 2;
+        default: return 3;
+        }
+    }
+
+    bool isFresh(uint32_t stream) const {
+        switch (stream) {
+        case FrameStream_Depth: return depth_.fresh;
+        case FrameStream_BodyIndex: return bodyIndex_.fresh;
+        case FrameStream_Body: return body_.fresh;
+        case FrameStream_Color: return color_.fresh;
+        default: return false;
+        }
+    }
+
+    bool peekRecord() {
+        if (hasPending_) return true;
+        if (finished_ || !reader_.readRecordHeader(pending_) || pending_.relativeTime > endTime_) {
+            finished_ = true;
+            return false;
+        }
+        hasPending_ = true;
+        return true;
+    }
+
+    // Reads the pending record's payload into its stream slot
+    void consumeRecord() {
+        bool ok = false;
+        switch (pending_.stream) {
+        case FrameStream_Depth:
+            ok = reader_.readDepthPayload(pending_, depth_.frame);
+            depth_.fresh = ok;
+            break;
+        case FrameStream_BodyIndex:
+            ok = reader_.readBodyIndexPayload(pending_, bodyIndex_.frame);
+            bodyIndex_.fresh = ok;
+            break;
+        case FrameStream_Body:
+            ok = reader_.readBodyPayload(pending_, body_.frame);
+            body_.fresh = ok;
+            break;
+        case FrameStream_Color:
+            ok = reader_.readColorPayload(pending_, color_.frame);
+            color_.fresh = ok;
+            break;
+        }
+        hasPending_ = false;
+        if (!ok) finished_ = true;
+    }
+
+    // Free-run: read forward until a frame of `stream` arrives. Reading over a
+    // frame the consumer has not picked up yet would drop it, so stop there
+    // once and let the consumer catch up; if it does not (e.g. it only reads
+    // that stream after this one succeeds), drop it on the next call.
+    void advanceUntil(uint32_t stream) {
+        int index = streamIndex(stream);
+        while (peekRecord()) {
+            uint32_t blocker = pending_.stream;
+            if (blocker != stream && (requested_ & blocker) && isFresh(blocker)) {
+                uint64_t blockerDeliveries = deliveries_[streamIndex(blocker)];
+                if (blockedOn_[index] != blocker || blockedAt_[index] != blockerDeliveries) {
+                    blockedOn_[index] = blocker;
+                    blockedAt_[index] = blockerDeliveries;
+                    return;
+                }
+            }
+
+            uint32_t consumed = pending_.stream;
+            consumeRecord();
+            if (consumed == stream) break;
+        }
+    }
+
+    void advanceTo(TIMESPAN target) {
+        while (peekRecord() && pending_.relativeTime <= target) {
+            consumeRecord();
+        }
+    }
+
+    // Recorded time that corresponds to "now" on the replay clock
+    TIMESPAN replayTime() {
+        if (!clockStarted_) {
+            if (!peekRecord()) return 0;
+            clockStarted_ = true;
+            clockStart_ = std::chrono::steady_clock::now();
+            firstTime_ = pending_.relativeTime;
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStart_).count();
+        return firstTime_ + static_cast<TIMESPAN>(elapsed * speed_ * TICKS_PER_SECOND);
+    }
+
+    SessionReader reader_;
+    std::string path_;
+    SessionIndex index_;
+    bool indexOpen_ = false;
+    TIMESPAN endTime_ = INT64_MAX;
+    double speed_;
+    bool finished_ = false;
+    int emptyAfterEnd_ = 0;
+
+    SessionRecordHeader pending_ = {};
+    bool hasPending_ = false;
+
+    bool clockStarted_ = false;
+    std::chrono::steady_clock::time_point clockStart_;
+    TIMESPAN firstTime_ = 0;
+
+    // Free-run bookkeeping, indexed by streamIndex()
+    UINT requested_ = 0;
+    uint64_t deliveries_[4] = {};
+    uint32_t blockedOn_[4] = {};
+    uint64_t blockedAt_[4] = {};
+
+    Slot<DepthFrameData> depth_;
+    Slot<BodyIndexFrameData> bodyIndex_;
+    Slot<BodyFrameData> body_;
+    Slot<ColorFrameData> color_;
+};
@@ -0,0 +1,174 @@
+// Fixed-window smoothing filters that keep their samples in a fixed-size
+// ring, so each new sample costs O(1) (O(N) for the median) with no heap
+// allocation. They replace the std::deque + std::accumulate smoothers.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+// Last N samples, oldest overwritten first
+template<class T, size_t N>
+class RingBuffer {
+public:
+    static_assert(N > 0, "RingBuffer capacity must be at least 1");
+
+    // Appends `value`; returns true and sets `evicted` when the ring was full
+    bool push(T value, T& evicted) {
+        bool wasFull = count_ == N;
+        if (wasFull) evicted = slots_[next_];
+        slots_[next_] = value;
+        next_ = next_ + 1 == N ? 0 : next_ + 1;
+        if (!wasFull) ++count_;
+        return wasFull;
+    }
+
+    void clear() {
+        next_ = 0;
+        count_ = 0;
+    }
+
+    // i = 0 is the oldest sample
+    T operator[](size_t i) const {
+        size_t first = count_ == N ? next_ : 0;
+        size_t index = first + i;
+        return slots_[index >= N ? index - N : index];
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == N; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T slots_[N] = {};
+    size_t next_ = 0;
+    size_t count_ = 0;
+};
+
+// Moving average over the last N samples (fewer until the window fills).
+// Keeps a running sum; for floating-point T the sum is compensated
+// (Neumaier) so adding and removing samples for hours does not drift.
+template<class T, size_t N>
+class RingFilter {
+public:
+    static_assert(std::is_arithmetic<T>::value, "RingFilter needs an arithmetic sample type");
+
+    // Integer samples are summed in 64 bits, floating-point ones in T
+    typedef typename std::conditional<std::is_floating_point<T>::value, T, long long>::type Sum;
+
+    // Adds a sample and returns the new average
+    T push(T value) {
+        T evicted;
+        if (samples_.push(value, evicted)) add(-static_cast<Sum>(evicted));
+        add(static_cast<Sum>(value));
+        return mean();
+    }
+
+    // Average of the samples in the window, 0 when empty
+    T mean() const {
+        if (samples_.empty()) return T();
+        return static_cast<T>((sum_ + compensation_) / static_cast<Sum>(samples_.size()));
+    }
+
+    Sum sum() const { return sum_ + compensation_; }
+
+    void reset() {
+        samples_.clear();
+        sum_ = Sum();
+        compensation_ = Sum();
+    }
+
+    size_t size() const { return samples_.size(); }
+    bool full() const { return samples_.full(); }
+    static constexpr size_t window() { return N; }
+
+private:
+    void add(Sum value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            Sum total = sum_ + value;
+            // Low-order bits lost by the addition, from whichever operand was smaller
+            if ((sum_ < 0 ? -sum_ : sum_) >= (value < 0 ? -value : value)) {
+                compensation_ += (sum_ - total) + value;
+            } else {
+                compensation_ += (value - total) + sum_;
+            }
+            sum_ = total;
+        } else {
+            sum_ += value;
+        }
+    }
+
+    RingBuffer<T, N> samples_;
+    Sum sum_ = Sum();
+    Sum compensation_ = Sum();
+};
+
+// Running median over the last N samples. A sorted copy of the window is
+// updated by one binary-search erase and insert per sample. Rejects the
+// single-frame depth spikes that a mean smears over the whole window.
+template<class T, size_t N>
+class MedianFilter {
+public:
+    // Adds a sample and returns the new median
+    T push(T value) {
+        T evicted;
+        size_t count = samples_.size();
+        if (samples_.push(value, evicted)) {
+            T* position = std::lower_bound(sorted_, sorted_ + count, evicted);
+            std::copy(position + 1, sorted_ + count, position);
+            --count;
+        }
+        T* position = std::upper_bound(sorted_, sorted_ + count, value);
+        std::copy_backward(position, sorted_ + count, sorted_ + count + 1);
+        *position = value;
+        return median();
+    }
+
+    // Middle sample (the lower of the two middle ones for an even count), 0 when empty
+    T median() const {
+        size_t count = samples_.size();
+        return count ? sorted_[(count - 1) / 2] : T();
+    }
+
+    void reset() { samples_.clear(); }
+
+    size_t size() const { return samples_.size(); }
+    bool full() const { return samples_.full(); }
+    static constexpr size_t window() { return N; }
+
+private:
+    RingBuffer<T, N> samples_;
+    T sorted_[N] = {};
+};
+
+// Exponential moving average: value = alpha * sample + (1 - alpha) * value.
+// No window to store; the first sample initializes the output.
+template<class T>
+class ExponentialFilter {
+public:
+    explicit ExponentialFilter(T alpha) : alpha_(alpha) {}
+
+    // Alpha with the same average sample age as an N-sample moving average
+    static ExponentialFilter forWindow(size_t n) { return ExponentialFilter(T(2) / static_cast<T>(n + 1)); }
+
+    T push(T sample) {
+        value_ = primed_ ? value_ + alpha_ * (sample - value_) : sample;
+        primed_ = true;
+        return value_;
+    }
+
+    T value() const { return value_; }
+
+    void reset() {
+        value_ = T();
+        primed_ = false;
+    }
+
+    T alpha() const { return alpha_; }
+
+private:
+    T alpha_;
+    T value_ = T();
+    bool primed_ = false;
+};
@@ -0,0 +1,373 @@
+// Recorded-session file format (.ksession)
+//
+//   SessionFileHeader
+//   { SessionRecordHeader, payload } ...   one record per frame, in arrival order
+//
+// Payloads are stored raw and little-endian:
+//   depth      DEPTH_WIDTH * DEPTH_HEIGHT UINT16 (mm)
+//   body index DEPTH_WIDTH * DEPTH_HEIGHT BYTE
+//   color      COLOR_WIDTH * COLOR_HEIGHT * 4 BYTE (BGRA)
+//   body       uint32 tracked-slot mask, then one RecordedBody per set bit
+//
+// Beside every session the writer leaves an index (<session>.kidx):
+//   SessionIndexHeader, then one SessionIndexEntry per record
+// mapping sensor time to the record's byte offset (see SessionIndex.h).
+#pragma once
+
+#include "FrameSource.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#pragma pack(push, 1)
+
+struct SessionFileHeader {
+    char magic[4];       // "KSES"
+    uint32_t version;
+    uint32_t streams;    // FrameStream flags present in the file
+    uint16_t depthWidth;
+    uint16_t depthHeight;
+    uint16_t colorWidth;
+    uint16_t colorHeight;
+    uint32_t reserved;
+};
+
+struct SessionRecordHeader {
+    uint32_t stream;       // a single FrameStream flag
+    uint32_t payloadBytes;
+    int64_t relativeTime;  // sensor TIMESPAN (100 ns ticks)
+};
+
+struct RecordedJoint {
+    float x, y, z;
+    uint32_t trackingState;
+};
+
+struct RecordedBody {
+    uint64_t trackingId;
+    RecordedJoint joints[JointType_Count];
+    float orientations[JointType_Count][4]; // x, y, z, w
+};
+
+struct SessionIndexHeader {
+    char magic[4];         // "KIDX"
+    uint32_t version;
+    uint64_t entryCount;
+    uint64_t sessionBytes; // size of the session file the index describes
+};
+
+struct SessionIndexEntry {
+    int64_t relativeTime;
+    uint64_t offset;       // of the SessionRecordHeader in the session file
+    uint32_t stream;
+    uint32_t flags;        // SessionIndexFlags
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(SessionFileHeader) == 24, "session header layout changed");
+static_assert(sizeof(SessionRecordHeader) == 16, "record header layout changed");
+static_assert(sizeof(RecordedBody) == 808, "recorded body layout changed");
+static_assert(sizeof(SessionIndexHeader) == 24, "index header layout changed");
+static_assert(sizeof(SessionIndexEntry) == 24, "index entry layout changed");
+
+// A keyframe is a record of the session's primary stream (depth when it was
+// recorded). Replay started at a keyframe sees every stream from that tick on.
+enum SessionIndexFlags : uint32_t {
+    SessionIndex_KeyFrame = 0x1
+};
+
+const uint32_t SESSION_FORMAT_VERSION = 1;
+const uint32_t SESSION_INDEX_VERSION = 1;
+const size_t SESSION_IO_BUFFER_BYTES = 16 * 1024 * 1024;
+
+inline FILE* openSessionFile(const std::string& path, const char* mode) {
+#ifdef _MSC_VER
+    FILE* file = nullptr;
+    if (fopen_s(&file, path.c_str(), mode) != 0) return nullptr;
+    return file;
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+inline std::string sessionIndexPath(const std::string& sessionPath) {
+    return sessionPath + ".kidx";
+}
+
+// Lowest FrameStream flag present, used to mark keyframes
+inline uint32_t keyFrameStream(uint32_t streams) {
+    return streams & (~streams + 1);
+}
+
+inline bool writeSessionIndex(const std::string& indexPath, const std::vector<SessionIndexEntry>& entries, uint64_t sessionBytes) {
+    FILE* file = openSessionFile(indexPath, "wb");
+    if (!file) return false;
+
+    SessionIndexHeader header = {};
+    memcpy(header.magic, "KIDX", 4);
+    header.version = SESSION_INDEX_VERSION;
+    header.entryCount = entries.size();
+    header.sessionBytes = sessionBytes;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        (entries.empty() || fwrite(entries.data(), sizeof(SessionIndexEntry), entries.size(), file) == entries.size());
+    return fclose(file) == 0 && ok;
+}
+
+// Expected payload size of a fixed-size stream, 0 for the variable-size body stream
+inline uint32_t fixedPayloadBytes(uint32_t stream) {
+    switch (stream) {
+    case FrameStream_Depth: return DEPTH_WIDTH * DEPTH_HEIGHT * sizeof(UINT16);
+    case FrameStream_BodyIndex: return DEPTH_WIDTH * DEPTH_HEIGHT;
+    case FrameStream_Color: return COLOR_WIDTH * COLOR_HEIGHT * 4;
+    default: return 0;
+    }
+}
+
+// Packs the tracked bodies of a frame into `payload`
+inline void encodeBodyPayload(const BodyFrameData& frame, std::vector<BYTE>& payload) {
+    uint32_t trackedMask = 0;
+    for (int i = 0; i < BODY_COUNT; ++i) {
+        if (frame.bodies[i].isTracked) trackedMask |= 1u << i;
+    }
+
+    payload.resize(sizeof(uint32_t));
+    memcpy(payload.data(), &trackedMask, sizeof(uint32_t));
+
+    for (int i = 0; i < BODY_COUNT; ++i) {
+        if (!(trackedMask & (1u << i))) continue;
+
+        const BodyData& body = frame.bodies[i];
+        RecordedBody recorded = {};
+        recorded.trackingId = body.trackingId;
+        for (int j = 0; j < JointType_Count; ++j) {
+            recorded.joints[j].x = body.joints[j].Position.X;
+            recorded.joints[j].y = body.joints[j].Position.Y;
+            recorded.joints[j].z = body.joints[j].Position.Z;
+            recorded.joints[j].trackingState = static_cast<uint32_t>(body.joints[j].TrackingState);
+            recorded.orientations[j][0] = body.orientations[j].Orientation.x;
+            recorded.orientations[j][1] = body.orientations[j].Orientation.y;
+            recorded.orientations[j][2] = body.orientations[j].Orientation.z;
+            recorded.orientations[j][3] = body.orientations[j].Orientation.w;
+        }
+
+        size_t offset = payload.size();
+        payload.resize(offset + sizeof(RecordedBody));
+        memcpy(payload.data() + offset, &recorded, sizeof(RecordedBody));
+    }
+}
+
+// Unpacks a body payload; returns false if it is truncated
+inline bool decodeBodyPayload(const BYTE* payload, size_t payloadBytes, BodyFrameData& frame) {
+    if (payloadBytes < sizeof(uint32_t)) return false;
+
+    uint32_t trackedMask = 0;
+    memcpy(&trackedMask, payload, sizeof(uint32_t));
+    size_t offset = sizeof(uint32_t);
+
+    for (int i = 0; i < BODY_COUNT; ++i) {
+        BodyData& body = frame.bodies[i];
+        body.isTracked = (trackedMask & (1u << i)) != 0;
+        if (!body.isTracked) {
+            body.trackingId = 0;
+            continue;
+        }
+
+        if (offset + sizeof(RecordedBody) > payloadBytes) return false;
+        RecordedBody recorded;
+        memcpy(&recorded, payload + offset, sizeof(RecordedBody));
+        offset += sizeof(RecordedBody);
+
+        body.trackingId = recorded.trackingId;
+        for (int j = 0; j < JointType_Count; ++j) {
+            body.joints[j].JointType = static_cast<JointType>(j);
+            body.joints[j].Position = { recorded.joints[j].x, recorded.joints[j].y, recorded.joints[j].z };
+            body.joints[j].TrackingState = static_cast<TrackingState>(recorded.joints[j].trackingState);
+            body.orientations[j].JointType = static_cast<JointType>(j);
+            body.orientations[j].Orientation = { recorded.orientations[j][0], recorded.orientations[j][1],
+                recorded.orientations[j][2], recorded.orientations[j][3] };
+        }
+    }
+    return true;
+}
+
+class SessionWriter {
+public:
+    ~SessionWriter() { close(); }
+
+    bool open(const std::string& path, UINT streams) {
+        close();
+        file_ = openSessionFile(path, "wb");
+        if (!file_) return false;
+
+        indexPath_ = sessionIndexPath(path);
+        index_.clear();
+        index_.reserve(1 << 16);
+        bytesWritten_ = 0;
+
+        ioBuffer_.resize(SESSION_IO_BUFFER_BYTES);
+        setvbuf(file_, ioBuffer_.data(), _IOFBF, ioBuffer_.size());
+
+        SessionFileHeader header = {};
+        memcpy(header.magic, "KSES", 4);
+        header.version = SESSION_FORMAT_VERSION;
+        header.streams = streams;
+        header.depthWidth = DEPTH_WIDTH;
+        header.depthHeight = DEPTH_HEIGHT;
+        header.colorWidth = COLOR_WIDTH;
+        header.colorHeight = COLOR_HEIGHT;
+        streams_ = streams;
+        return writeBytes(&header, sizeof(header));
+    }
+
+    bool writeDepthFrame(const DepthFrameData& frame) {
+        return writeRecord(FrameStream_Depth, frame.relativeTime, frame.pixels.data(), fixedPayloadBytes(FrameStream_Depth));
+    }
+
+    bool writeBodyIndexFrame(const BodyIndexFrameData& frame) {
+        return writeRecord(FrameStream_BodyIndex, frame.relativeTime, frame.pixels.data(), fixedPayloadBytes(FrameStream_BodyIndex));
+    }
+
+    bool writeColorFrame(const ColorFrameData& frame) {
+        return writeRecord(FrameStream_Color, frame.relativeTime, frame.bgra.data(), fixedPayloadBytes(FrameStream_Color));
+    }
+
+    bool writeBodyFrame(const BodyFrameData& frame) {
+        encodeBodyPayload(frame, bodyPayload_);
+        return writeRecord(FrameStream_Body, frame.relativeTime, bodyPayload_.data(), static_cast<uint32_t>(bodyPayload_.size()));
+    }
+
+    // Closes the session and writes its index; false if either failed
+    bool close() {
+        if (!file_) return true;
+
+        bool ok = fclose(file_) == 0;
+        file_ = nullptr;
+        return writeSessionIndex(indexPath_, index_, bytesWritten_) && ok;
+    }
+
+    bool isOpen() const { return file_ != nullptr; }
+
+private:
+    bool writeBytes(const void* data, size_t bytes) {
+        bool ok = fwrite(data, 1, bytes, file_) == bytes;
+        bytesWritten_ += bytes;
+        return ok;
+    }
+
+    bool writeRecord(uint32_t stream, TIMESPAN relativeTime, const void* payload, uint32_t payloadBytes) {
+        if (!file_ || !(streams_ & stream)) return false;
+
+        SessionIndexEntry entry = { relativeTime, bytesWritten_, stream, 0 };
+        if (stream == keyFrameStream(streams_)) entry.flags |= SessionIndex_KeyFrame;
+        index_.push_back(entry);
+
+        SessionRecordHeader record = { stream, payloadBytes, relativeTime };
+        return writeBytes(&record, sizeof(record)) && writeBytes(payload, payloadBytes);
+    }
+
+    FILE* file_ = nullptr;
+    UINT streams_ = 0;
+    uint64_t bytesWritten_ = 0;
+    std::string indexPath_;
+    std::vector<SessionIndexEntry> index_;
+    std::vector<char> ioBuffer_;
+    std::vector<BYTE> bodyPayload_;
+};
+
+// Sequential reader: call readRecordHeader(), then exactly one of the
+// read*Payload() calls or skipPayload() for that record.
+class SessionReader {
+public:
+    ~SessionReader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        file_ = openSessionFile(path, "rb");
+        if (!file_) return false;
+
+        ioBuffer_.resize(SESSION_IO_BUFFER_BYTES);
+        setvbuf(file_, ioBuffer_.data(), _IOFBF, ioBuffer_.size());
+
+        if (fread(&header_, sizeof(header_), 1, file_) != 1 ||
+            memcmp(header_.magic, "KSES", 4) != 0 ||
+            header_.version != SESSION_FORMAT_VERSION ||
+            header_.depthWidth != DEPTH_WIDTH || header_.depthHeight != DEPTH_HEIGHT ||
+            header_.colorWidth != COLOR_WIDTH || header_.colorHeight != COLOR_HEIGHT) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    const SessionFileHeader& header() const { return header_; }
+
+    // False at end of file or on a corrupt record
+    bool readRecordHeader(SessionRecordHeader& record) {
+        if (!file_ || fread(&record, sizeof(record), 1, file_) != 1) return false;
+
+        uint32_t expected = fixedPayloadBytes(record.stream);
+        if (expected != 0 && record.payloadBytes != expected) return false;
+        if (expected == 0 && record.stream != FrameStream_Body) return false;
+        return true;
+    }
+
+    bool readDepthPayload(const SessionRecordHeader& record, DepthFrameData& frame) {
+        frame.relativeTime = record.relativeTime;
+        frame.pixels.resize(record.payloadBytes / sizeof(UINT16));
+        return readBytes(frame.pixels.data(), record.payloadBytes);
+    }
+
+    bool readBodyIndexPayload(const SessionRecordHeader& record, BodyIndexFrameData& frame) {
+        frame.relativeTime = record.relativeTime;
+        frame.pixels.resize(record.payloadBytes);
+        return readBytes(frame.pixels.data(), record.payloadBytes);
+    }
+
+    bool readColorPayload(const SessionRecordHeader& record, ColorFrameData& frame) {
+        frame.relativeTime = record.relativeTime;
+        if (frame.bgra.size() != record.payloadBytes) frame.bgra = AlignedBuffer(record.payloadBytes);
+        return readBytes(frame.bgra.data(), record.payloadBytes);
+    }
+
+    bool readBodyPayload(const SessionRecordHeader& record, BodyFrameData& frame) {
+        bodyPayload_.resize(record.payloadBytes);
+        if (!readBytes(bodyPayload_.data(), record.payloadBytes)) return false;
+        frame.relativeTime = record.relativeTime;
+        return decodeBodyPayload(bodyPayload_.data(), bodyPayload_.size(), frame);
+    }
+
+    bool skipPayload(const SessionRecordHeader& record) {
+        return fseek(file_, static_cast<long>(record.payloadBytes), SEEK_CUR) == 0;
+    }
+
+    // Repositions at a record header, e.g. an offset from the session index
+    bool seek(uint64_t offset) {
+        if (!file_) return false;
+#ifdef _MSC_VER
+        return _fseeki64(file_, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+private:
+    bool readBytes(void* data, size_t bytes) {
+        return fread(data, 1, bytes, file_) == bytes;
+    }
+
+    FILE* file_ = nullptr;
+    SessionFileHeader header_ = {};
+    std::vector<char> ioBuffer_;
+    std::vector<BYTE> bodyPayload_;
+};
@@ -0,0 +1,237 @@
+// Random access into recorded sessions through the .kidx frame index.
+// Both files are memory-mapped, so jumping to a time window only touches the
+// pages of the frames that are actually read.
+#pragma once
+
+#include "SessionFormat.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file_, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        size_ = static_cast<uint64_t>(fileSize.QuadPart);
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) data_ = static_cast<const BYTE*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size_ = static_cast<uint64_t>(info.st_size);
+            void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) data_ = static_cast<const BYTE*>(mapped);
+        }
+        ::close(fd); // the mapping keeps the file alive
+#endif
+        if (!data_) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) munmap(const_cast<BYTE*>(data_), size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const BYTE* data() const { return data_; }
+    uint64_t size() const { return size_; }
+
+private:
+    const BYTE* data_ = nullptr;
+    uint64_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+// Scans a session and writes its .kidx, for recordings made without one
+inline bool buildSessionIndex(const std::string& sessionPath) {
+    SessionReader reader;
+    if (!reader.open(sessionPath)) return false;
+
+    uint32_t keyStream = keyFrameStream(reader.header().streams);
+    std::vector<SessionIndexEntry> entries;
+    uint64_t offset = sizeof(SessionFileHeader);
+
+    SessionRecordHeader record;
+    while (reader.readRecordHeader(record)) {
+        SessionIndexEntry entry = { record.relativeTime, offset, record.stream, 0 };
+        if (record.stream == keyStream) entry.flags |= SessionIndex_KeyFrame;
+        entries.push_back(entry);
+
+        offset += sizeof(SessionRecordHeader) + record.payloadBytes;
+        if (!reader.skipPayload(record)) break;
+    }
+    return writeSessionIndex(sessionIndexPath(sessionPath), entries, offset);
+}
+
+// Memory-mapped view of a session's .kidx
+class SessionIndex {
+public:
+    // Maps the index beside `sessionPath`, rebuilding it first if it is
+    // missing or was written for a different version of the session
+    bool open(const std::string& sessionPath) {
+        std::error_code error;
+        uint64_t sessionBytes = std::filesystem::file_size(sessionPath, error);
+        return !error && open(sessionPath, sessionBytes);
+    }
+
+    bool open(const std::string& sessionPath, uint64_t sessionBytes) {
+        std::string indexPath = sessionIndexPath(sessionPath);
+        if (!mapAndValidate(indexPath, sessionBytes)) {
+            if (!buildSessionIndex(sessionPath) || !mapAndValidate(indexPath, sessionBytes)) return false;
+        }
+        return true;
+    }
+
+    size_t size() const { return count_; }
+    const SessionIndexEntry& operator[](size_t i) const { return entries_[i]; }
+
+    TIMESPAN startTime() const { return count_ ? entries_[0].relativeTime : 0; }
+    TIMESPAN endTime() const { return count_ ? entries_[count_ - 1].relativeTime : 0; }
+
+    // First entry with relativeTime >= time (size() if none)
+    size_t lowerBound(TIMESPAN time) const {
+        const SessionIndexEntry* end = entries_ + count_;
+        const SessionIndexEntry* it = std::lower_bound(entries_, end, time,
+            [](const SessionIndexEntry& entry, TIMESPAN t) { return entry.relativeTime < t; });
+        return static_cast<size_t>(it - entries_);
+    }
+
+    // Last keyframe at or before `time`, so replay from there covers `time`
+    // with every stream (0 if `time` precedes the first keyframe)
+    size_t seekKeyFrame(TIMESPAN time) const {
+        size_t i = lowerBound(time);
+        if (i == count_ || entries_[i].relativeTime > time) {
+            if (i == 0) return 0;
+            --i;
+        }
+        while (i > 0 && !(entries_[i].flags & SessionIndex_KeyFrame)) --i;
+        return i;
+    }
+
+private:
+    bool mapAndValidate(const std::string& indexPath, uint64_t sessionBytes) {
+        entries_ = nullptr;
+        count_ = 0;
+        if (!file_.open(indexPath) || file_.size() < sizeof(SessionIndexHeader)) return false;
+
+        SessionIndexHeader header;
+        memcpy(&header, file_.data(), sizeof(header));
+        if (memcmp(header.magic, "KIDX", 4) != 0 || header.version != SESSION_INDEX_VERSION ||
+            header.sessionBytes != sessionBytes ||
+            file_.size() != sizeof(header) + header.entryCount * sizeof(SessionIndexEntry)) {
+            file_.close();
+            return false;
+        }
+
+        entries_ = reinterpret_cast<const SessionIndexEntry*>(file_.data() + sizeof(header));
+        count_ = static_cast<size_t>(header.entryCount);
+        return true;
+    }
+
+    MappedFile file_;
+    const SessionIndexEntry* entries_ = nullptr;
+    size_t count_ = 0;
+};
+
+// Zero-copy random access to a memory-mapped session. Payload pointers stay
+// valid while the MappedSession is open.
+class MappedSession {
+public:
+    bool open(const std::string& sessionPath) {
+        if (!file_.open(sessionPath) || file_.size() < sizeof(SessionFileHeader)) return false;
+
+        memcpy(&header_, file_.data(), sizeof(header_));
+        if (memcmp(header_.magic, "KSES", 4) != 0 || header_.version != SESSION_FORMAT_VERSION) {
+            file_.close();
+            return false;
+        }
+        return index_.open(sessionPath, file_.size());
+    }
+
+    const SessionFileHeader& header() const { return header_; }
+    const SessionIndex& index() const { return index_; }
+
+    // Record payload of index entry `i`, nullptr if it runs past the end of the file
+    const BYTE* payload(size_t i, uint32_t* payloadBytes = nullptr) const {
+        const SessionIndexEntry& entry = index_[i];
+        if (entry.offset + sizeof(SessionRecordHeader) > file_.size()) return nullptr;
+
+        SessionRecordHeader record;
+        memcpy(&record, file_.data() + entry.offset, sizeof(record));
+        if (entry.offset + sizeof(record) + record.payloadBytes > file_.size()) return nullptr;
+
+        if (payloadBytes) *payloadBytes = record.payloadBytes;
+        return file_.data() + entry.offset + sizeof(record);
+    }
+
+    const UINT16* depthPixels(size_t i) const {
+        if (index_[i].stream != FrameStream_Depth) return nullptr;
+        return reinterpret_cast<const UINT16*>(payload(i));
+    }
+
+    const BYTE* bodyIndexPixels(size_t i) const {
+        if (index_[i].stream != FrameStream_BodyIndex) return nullptr;
+        return payload(i);
+    }
+
+    const BYTE* colorPixels(size_t i) const {
+        if (index_[i].stream != FrameStream_Color) return nullptr;
+        return payload(i);
+    }
+
+    bool readBodyFrame(size_t i, BodyFrameData& frame) const {
+        uint32_t payloadBytes = 0;
+        const BYTE* data = index_[i].stream == FrameStream_Body ? payload(i, &payloadBytes) : nullptr;
+        if (!data) return false;
+        frame.relativeTime = index_[i].relativeTime;
+        return decodeBodyPayload(data, payloadBytes, frame);
+    }
+
+private:
+    MappedFile file_;
+    SessionFileHeader header_ = {};
+    SessionIndex index_;
+};
@@ -0,0 +1,173 @@
+// The Kinect v2 skeleton as compile-time tables: the bones the programs
+// draw, each joint's parent and the body part (joint group) it belongs to.
+// Subsets by group are built at compile time, e.g.
+//
+//   constexpr auto legBones = bonesOf<JointGroup_Legs>();   // std::array<Bone, 8>
+//   forEachBone<JointGroup_Body>([&](const Bone& bone) { ... });
+//
+// forEachBone()/forEachJoint() expand into one call per element, so the
+// compiler sees a straight run of constant joint indices and no loop.
+#pragma once
+
+#include "KinectCompat.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+struct Bone {
+    JointType parent; // towards SpineBase
+    JointType child;
+};
+
+enum JointGroup : unsigned {
+    JointGroup_Spine = 0x01,    // SpineBase, SpineMid, SpineShoulder, Neck, Head
+    JointGroup_LeftArm = 0x02,  // shoulder to hand
+    JointGroup_RightArm = 0x04,
+    JointGroup_LeftLeg = 0x08,  // hip to foot
+    JointGroup_RightLeg = 0x10,
+    JointGroup_Hands = 0x20,    // hand tips and thumbs
+    JointGroup_Arms = JointGroup_LeftArm | JointGroup_RightArm,
+    JointGroup_Legs = JointGroup_LeftLeg | JointGroup_RightLeg,
+    JointGroup_Body = JointGroup_Spine | JointGroup_Arms | JointGroup_Legs, // every joint SKELETON_BONES connects
+    JointGroup_All = JointGroup_Body | JointGroup_Hands
+};
+
+// Parent of every joint, indexed by JointType; SpineBase is the root and its own parent
+constexpr std::array<JointType, JointType_Count> JOINT_PARENTS = {{
+    JointType_SpineBase,     // SpineBase
+    JointType_SpineBase,     // SpineMid
+    JointType_SpineShoulder, // Neck
+    JointType_Neck,          // Head
+    JointType_SpineShoulder, // ShoulderLeft
+    JointType_ShoulderLeft,  // ElbowLeft
+    JointType_ElbowLeft,     // WristLeft
+    JointType_WristLeft,     // HandLeft
+    JointType_SpineShoulder, // ShoulderRight
+    JointType_ShoulderRight, // ElbowRight
+    JointType_ElbowRight,    // WristRight
+    JointType_WristRight,    // HandRight
+    JointType_SpineBase,     // HipLeft
+    JointType_HipLeft,       // KneeLeft
+    JointType_KneeLeft,      // AnkleLeft
+    JointType_AnkleLeft,     // FootLeft
+    JointType_SpineBase,     // HipRight
+    JointType_HipRight,      // KneeRight
+    JointType_KneeRight,     // AnkleRight
+    JointType_AnkleRight,    // FootRight
+    JointType_SpineMid,      // SpineShoulder
+    JointType_HandLeft,      // HandTipLeft
+    JointType_WristLeft,     // ThumbLeft
+    JointType_HandRight,     // HandTipRight
+    JointType_WristRight     // ThumbRight
+}};
+
+// Group of every joint, indexed by JointType
+constexpr std::array<JointGroup, JointType_Count> JOINT_GROUPS = {{
+    JointGroup_Spine, JointGroup_Spine, JointGroup_Spine, JointGroup_Spine,
+    JointGroup_LeftArm, JointGroup_LeftArm, JointGroup_LeftArm, JointGroup_LeftArm,
+    JointGroup_RightArm, JointGroup_RightArm, JointGroup_RightArm, JointGroup_RightArm,
+    JointGroup_LeftLeg, JointGroup_LeftLeg, JointGroup_LeftLeg, JointGroup_LeftLeg,
+    JointGroup_RightLeg, JointGroup_RightLeg, JointGroup_RightLeg, JointGroup_RightLeg,
+    JointGroup_Spine,
+    JointGroup_Hands, JointGroup_Hands, JointGroup_Hands, JointGroup_Hands
+}};
+
+// The 20 bones drawn by the skeleton programs (hand tips and thumbs left out)
+constexpr std::array<Bone, 20> SKELETON_BONES = {{
+    { JointType_Neck, JointType_Head },
+    { JointType_SpineShoulder, JointType_Neck },
+    { JointType_SpineMid, JointType_SpineShoulder },
+    { JointType_SpineBase, JointType_SpineMid },
+    { JointType_SpineShoulder, JointType_ShoulderLeft },
+    { JointType_SpineShoulder, JointType_ShoulderRight },
+    { JointType_SpineBase, JointType_HipLeft },
+    { JointType_SpineBase, JointType_HipRight },
+    { JointType_ShoulderLeft, JointType_ElbowLeft },
+    { JointType_ElbowLeft, JointType_WristLeft },
+    { JointType_WristLeft, JointType_HandLeft },
+    { JointType_ShoulderRight, JointType_ElbowRight },
+    { JointType_ElbowRight, JointType_WristRight },
+    { JointType_WristRight, JointType_HandRight },
+    { JointType_HipLeft, JointType_KneeLeft },
+    { JointType_KneeLeft, JointType_AnkleLeft },
+    { JointType_AnkleLeft, JointType_FootLeft },
+    { JointType_HipRight, JointType_KneeRight },
+    { JointType_KneeRight, JointType_AnkleRight },
+    { JointType_AnkleRight, JointType_FootRight }
+}};
+
+constexpr bool inGroups(JointType joint, unsigned groups) { return (JOINT_GROUPS[joint] & groups) != 0; }
+
+// A bone belongs to its child's group: the hip bones are leg bones
+constexpr bool inGroups(const Bone& bone, unsigned groups) { return inGroups(bone.child, groups); }
+
+constexpr size_t jointCount(unsigned groups) {
+    size_t count = 0;
+    for (int j = 0; j < JointType_Count; ++j) {
+        if (inGroups(static_cast<JointType>(j), groups)) ++count;
+    }
+    return count;
+}
+
+constexpr size_t boneCount(unsigned groups) {
+    size_t count = 0;
+    for (const Bone& bone : SKELETON_BONES) {
+        if (inGroups(bone, groups)) ++count;
+    }
+    return count;
+}
+
+// The joints of `Groups`, in JointType order
+template<unsigned Groups>
+constexpr std::array<JointType, jointCount(Groups)> jointsOf() {
+    std::array<JointType, jointCount(Groups)> joints{};
+    size_t n = 0;
+    for (int j = 0; j < JointType_Count; ++j) {
+        if (inGroups(static_cast<JointType>(j), Groups)) joints[n++] = static_cast<JointType>(j);
+    }
+    return joints;
+}
+
+// The bones of `Groups`, in SKELETON_BONES order
+template<unsigned Groups>
+constexpr std::array<Bone, boneCount(Groups)> bonesOf() {
+    std::array<Bone, boneCount(Groups)> bones{};
+    size_t n = 0;
+    for (const Bone& bone : SKELETON_BONES) {
+        if (inGroups(bone, Groups)) bones[n++] = bone;
+    }
+    return bones;
+}
+
+// One instance per subset, so the tables exist once however often they are used
+template<unsigned Groups>
+struct SkeletonSubset {
+    static constexpr std::array<JointType, jointCount(Groups)> joints = jointsOf<Groups>();
+    static constexpr std::array<Bone, boneCount(Groups)> bones = bonesOf<Groups>();
+};
+
+template<unsigned Groups, class F, size_t... I>
+inline void forEachJoint(F& f, std::index_sequence<I...>) {
+    (f(SkeletonSubset<Groups>::joints[I]), ...);
+}
+
+template<unsigned Groups, class F, size_t... I>
+inline void forEachBone(F& f, std::index_sequence<I...>) {
+    (f(SkeletonSubset<Groups>::bones[I]), ...);
+}
+
+// Calls `f(JointType)` for every joint of `Groups`, unrolled
+template<unsigned Groups, class F>
+inline void forEachJoint(F f) {
+    forEachJoint<Groups>(f, std::make_index_sequence<jointCount(Groups)>());
+}
+
+// Calls `f(const Bone&)` for every bone of `Groups`, unrolled
+template<unsigned Groups, class F>
+inline void forEachBone(F f) {
+    forEachBone<Groups>(f, std::make_index_sequence<boneCount(Groups)>());
+}
+
+static_assert(jointCount(JointGroup_All) == JointType_Count, "every joint has a group");
+static_assert(boneCount(JointGroup_Body) == SKELETON_BONES.size(), "every bone joins body joints");
@@ -0,0 +1,63 @@
+// Bounded lock-free single-producer/single-consumer queue. One thread may
+// push and one (other) thread may pop; neither ever blocks or allocates.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+template<class T, size_t Capacity>
+class SpscRing {
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only. Moves `item` into the ring, or leaves it untouched and
+    // returns false when the ring is full.
+    bool tryPush(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ == Capacity) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ == Capacity) return false;
+        }
+        slots_[tail & (Capacity - 1)] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Moves the oldest item into `item`, false when empty.
+    bool tryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) return false;
+        }
+        item = std::move(slots_[head & (Capacity - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Snapshot only; exact when called from the producer or the consumer
+    // while the other side is idle
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    // Each side keeps its own index and a cached copy of the other side's on
+    // a separate cache line, so the two threads do not false-share
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    size_t tailCache_ = 0;
+
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    size_t headCache_ = 0;
+
+    alignas(64) T slots_[Capacity];
+};
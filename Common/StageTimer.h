@@ -0,0 +1,215 @@
+// Latency of each stage of a frame loop (acquire, convert, map, draw, show,
+// ...), cheap enough to leave on. A StageTimer measures one pass through a
+// stage with steady_clock and records it in a latency histogram owned by the
+// calling thread, so recording takes no lock and shares no cache line with
+// other threads. report() merges every thread's histograms and prints the
+// count, p50, p99, p99.9 and max of each stage. It can be called at any time
+// from any thread, e.g. on a key press and on exit.
+//
+//   StageProfiler profiler;
+//   const int acquire = profiler.stage("acquire");
+//   ...
+//   { StageTimer timer(profiler, acquire); source.AcquireLatestColorFrame(frame); }
+//
+// With setTrace(), every timed stage is also written as a span to a
+// TraceWriter (Common/TraceWriter.h) timeline.
+//
+// The histograms are log-linear, in the manner of HdrHistogram: every power
+// of two from 128 ns up is split into 64 equal buckets, so a recorded value is
+// off by less than 1.6%, over 1 ns to about 2 minutes, in 16 KB per stage and
+// thread. A StageTimer costs two clock reads, well under 0.1 us.
+#pragma once
+
+#include "TraceWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 6;                      // 64 buckets per power of two
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_MSB = 36;                             // values up to 2^37 ns (137 s)
+    static const int BUCKETS = (MAX_MSB - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    LatencyHistogram() {
+        for (std::atomic<uint64_t>& count : counts_) count.store(0, std::memory_order_relaxed);
+    }
+
+    // Single writer: only the owning thread records, readers may snapshot concurrently
+    void record(uint64_t nanoseconds) {
+        std::atomic<uint64_t>& count = counts_[index(nanoseconds)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (nanoseconds > max_.load(std::memory_order_relaxed)) max_.store(nanoseconds, std::memory_order_relaxed);
+    }
+
+    // Adds this histogram's counts to `counts` (BUCKETS entries)
+    void addTo(uint64_t* counts, uint64_t& max) const {
+        for (int i = 0; i < BUCKETS; ++i) counts[i] += counts_[i].load(std::memory_order_relaxed);
+        uint64_t m = max_.load(std::memory_order_relaxed);
+        if (m > max) max = m;
+    }
+
+    static int index(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) return static_cast<int>(value);
+        int msb = mostSignificantBit(value);
+        if (msb > MAX_MSB) return BUCKETS - 1;
+        int shift = msb - SUB_BUCKET_BITS;
+        return SUB_BUCKETS * shift + static_cast<int>(value >> shift);
+    }
+
+    // Largest value that lands in bucket `index`
+    static uint64_t highestValue(int index) {
+        if (index < 2 * SUB_BUCKETS) return static_cast<uint64_t>(index);
+        int shift = index / SUB_BUCKETS - 1;
+        uint64_t lowest = static_cast<uint64_t>(index - SUB_BUCKETS * shift) << shift;
+        return lowest + (uint64_t(1) << shift) - 1;
+    }
+
+    // Value at `percentile` (0-100) of merged counts
+    static uint64_t valueAt(const uint64_t* counts, uint64_t total, double percentile) {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return highestValue(i);
+        }
+        return highestValue(BUCKETS - 1);
+    }
+
+private:
+    static int mostSignificantBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long msb;
+        _BitScanReverse64(&msb, value);
+        return static_cast<int>(msb);
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    std::atomic<uint64_t> counts_[BUCKETS];
+    std::atomic<uint64_t> max_{ 0 };
+};
+
+class StageProfiler {
+public:
+    static const int MAX_STAGES = 16;
+
+    // Registers a stage and returns its id; call before the frame loop starts
+    int stage(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < stageCount_; ++i) {
+            if (names_[i] == name) return i;
+        }
+        if (stageCount_ == MAX_STAGES) return MAX_STAGES - 1;
+        names_[stageCount_] = name;
+        return stageCount_++;
+    }
+
+    void record(int stage, uint64_t nanoseconds) {
+        local().histograms[stage].record(nanoseconds);
+    }
+
+    void record(int stage, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        record(stage, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        if (trace_) trace_->complete("stage", names_[stage], start, end);
+    }
+
+    // Also writes every timed stage to `trace` (null to stop); set before timing starts
+    void setTrace(TraceWriter* trace) { trace_ = trace; }
+
+    // Count, p50, p99, p99.9 and max of every stage, in microseconds
+    void report(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint64_t> counts(LatencyHistogram::BUCKETS);
+        out << std::left << std::setw(12) << "stage" << std::right << std::setw(10) << "count"
+            << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us"
+            << std::setw(10) << "max us" << "\n";
+        for (int s = 0; s < stageCount_; ++s) {
+            std::fill(counts.begin(), counts.end(), 0);
+            uint64_t max = 0;
+            for (const std::unique_ptr<ThreadStages>& thread : threads_) thread->histograms[s].addTo(counts.data(), max);
+            uint64_t total = 0;
+            for (uint64_t count : counts) total += count;
+
+            out << std::left << std::setw(12) << names_[s] << std::right << std::setw(10) << total
+                << std::fixed << std::setprecision(1);
+            for (double percentile : { 50.0, 99.0, 99.9 }) {
+                out << std::setw(10) << LatencyHistogram::valueAt(counts.data(), total, percentile) / 1000.0;
+            }
+            out << std::setw(10) << max / 1000.0 << "\n";
+        }
+        out.flush();
+    }
+
+private:
+    struct ThreadStages {
+        std::thread::id thread = std::this_thread::get_id();
+        LatencyHistogram histograms[MAX_STAGES];
+    };
+
+    // This thread's histograms, created on its first record. They belong to
+    // the profiler, so a finished thread's samples stay in the report.
+    ThreadStages& local() {
+        thread_local const StageProfiler* owner = nullptr;
+        thread_local ThreadStages* stages = nullptr;
+        if (owner != this) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stages = nullptr;
+            for (const std::unique_ptr<ThreadStages>& thread : threads_) {
+                if (thread->thread == std::this_thread::get_id()) stages = thread.get();
+            }
+            if (!stages) {
+                threads_.emplace_back(new ThreadStages());
+                stages = threads_.back().get();
+            }
+            owner = this;
+        }
+        return *stages;
+    }
+
+    mutable std::mutex mutex_;
+    std::string names_[MAX_STAGES];
+    int stageCount_ = 0;
+    std::vector<std::unique_ptr<ThreadStages>> threads_;
+    TraceWriter* trace_ = nullptr;
+};
+
+// Records the time from construction to stop() or destruction into `stage`
+class StageTimer {
+public:
+    StageTimer(StageProfiler& profiler, int stage)
+        : profiler_(profiler), stage_(stage), start_(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer() { stop(); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void stop() {
+        if (stage_ < 0) return;
+        profiler_.record(stage_, start_, std::chrono::steady_clock::now());
+        stage_ = -1;
+    }
+
+private:
+    StageProfiler& profiler_;
+    int stage_;
+    std::chrono::steady_clock::time_point start_;
+};
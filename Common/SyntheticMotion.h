@@ -0,0 +1,545 @@
+// Synthetic subjects for load and regression runs without a sensor or a
+// patient. Each actor is a 25-joint skeleton that follows one test:
+//
+//   SyntheticMotion_Walk         walks along Z from `distance` to `target`
+//                                at `speed`, then stands
+//   SyntheticMotion_Tug          sits on a chair at `distance`, stands up,
+//                                walks to `target`, turns, walks back, turns
+//                                and sits down (Timed Up and Go)
+//   SyntheticMotion_OneLegStand  stands at `distance`, raises one foot for
+//                                `holdSeconds` with sway, touches down,
+//                                rests and raises the other
+//   SyntheticMotion_Stand        stands and sways
+//
+// Frames come at any rate for up to BODY_COUNT actors. bodyFrame() gives
+// the skeletons and depthFrame() renders matching depth and body-index
+// frames: every bone as a capsule in front of a floor and a back wall, seen
+// through the nominal depth camera intrinsics. writeSession() stores the
+// run as a .ksession file, and SyntheticFrameSource hands it out in memory
+// through the FrameSource contract.
+//
+//   SyntheticMotion motion(60.0);
+//   SyntheticActor tug;
+//   tug.motion = SyntheticMotion_Tug;
+//   motion.addActor(tug);
+//   motion.writeSession("tug60.ksession", FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body);
+//
+// The same seed gives the same frames. Joint orientations follow the body's
+// heading only; no color frames are produced.
+#pragma once
+
+#include "SessionFormat.h"
+#include "SkeletonTopology.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+enum SyntheticMotionType {
+    SyntheticMotion_Stand,
+    SyntheticMotion_Walk,
+    SyntheticMotion_Tug,
+    SyntheticMotion_OneLegStand
+};
+
+struct SyntheticActor {
+    SyntheticMotionType motion = SyntheticMotion_Stand;
+    float x = 0.0f;            // m, sideways from the sensor axis
+    float distance = 4.0f;     // m: walk start, TUG chair, stance depth
+    float target = 0.8f;       // m: walk end, TUG turning point
+    float speed = 1.2f;        // m/s while walking
+    double delay = 1.0;        // s standing (TUG: seated) before the motion starts
+    double holdSeconds = 8.0;  // one-leg stand: time on each leg
+    bool rightFootFirst = true; // one-leg stand: foot raised first
+};
+
+// Nominal Kinect v2 depth camera intrinsics and mounting
+const float SYNTHETIC_DEPTH_FX = 365.5f;
+const float SYNTHETIC_DEPTH_FY = 365.5f;
+const float SYNTHETIC_DEPTH_CX = 255.5f;
+const float SYNTHETIC_DEPTH_CY = 211.5f;
+const float SYNTHETIC_CAMERA_HEIGHT = 0.8f; // m above the floor
+const float SYNTHETIC_BACK_WALL = 7.5f;     // m
+
+class SyntheticMotion {
+public:
+    static constexpr double RISE_SECONDS = 1.5;  // TUG sit-to-stand and stand-to-sit
+    static constexpr double TURN_SECONDS = 1.2;  // TUG 180 degree turn
+    static constexpr double RAISE_SECONDS = 0.3; // one-leg stand foot lift and touch-down
+    static constexpr double REST_SECONDS = 2.0;  // one-leg stand between the legs
+    static constexpr double TAIL_SECONDS = 1.0;  // still frames after the last actor finishes
+
+    explicit SyntheticMotion(double fps = 30.0, unsigned seed = 1) : fps_(fps), seed_(seed) {}
+
+    // Adds an actor in the next body slot; returns the slot, or -1 when all are taken
+    int addActor(const SyntheticActor& actor) {
+        if (actors_.size() == BODY_COUNT) return -1;
+        actors_.push_back(actor);
+        return static_cast<int>(actors_.size()) - 1;
+    }
+
+    const std::vector<SyntheticActor>& actors() const { return actors_; }
+
+    double fps() const { return fps_; }
+
+    // Joint position noise, m (standard deviation); depth noise, mm (uniform +-)
+    void setNoise(float jointNoise, int depthNoise) {
+        jointNoise_ = jointNoise;
+        depthNoise_ = depthNoise;
+    }
+
+    // Until every actor has finished, plus TAIL_SECONDS
+    double seconds() const {
+        double seconds = 0.0;
+        for (const SyntheticActor& actor : actors_) seconds = std::max(seconds, actor.delay + motionSeconds(actor));
+        return seconds + TAIL_SECONDS;
+    }
+
+    int frameCount() const { return static_cast<int>(seconds() * fps_) + 1; }
+
+    // Frames are numbered from 0; the first is stamped one frame period in
+    TIMESPAN frameTime(int frame) const {
+        return static_cast<TIMESPAN>(std::llround((frame + 1) * TICKS_PER_SECOND / fps_));
+    }
+
+    void bodyFrame(int frame, BodyFrameData& out) const {
+        out.relativeTime = frameTime(frame);
+        std::mt19937 random(seed_ * 7919u + static_cast<unsigned>(frame));
+        std::normal_distribution<float> noise(0.0f, jointNoise_);
+        double t = frame / fps_;
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            BodyData& body = out.bodies[slot];
+            if (slot >= static_cast<int>(actors_.size())) {
+                body = BodyData();
+                continue;
+            }
+            body.isTracked = true;
+            body.trackingId = 1000 + slot;
+            pose(posture(actors_[slot], t), body);
+            for (Joint& joint : body.joints) {
+                joint.Position.X += noise(random);
+                joint.Position.Y += noise(random);
+                joint.Position.Z += noise(random);
+            }
+        }
+    }
+
+    // Renders the bodies of `body` into `depth` and `bodyIndex` (relativeTime copied)
+    void depthFrame(const BodyFrameData& body, DepthFrameData& depth, BodyIndexFrameData& bodyIndex) const {
+        depth.relativeTime = bodyIndex.relativeTime = body.relativeTime;
+        if (background_.empty()) makeBackground();
+        std::copy(background_.begin(), background_.end(), depth.pixels.begin());
+        std::fill(bodyIndex.pixels.begin(), bodyIndex.pixels.end(), static_cast<BYTE>(255));
+
+        for (int slot = 0; slot < BODY_COUNT; ++slot) {
+            const BodyData& data = body.bodies[slot];
+            if (!data.isTracked) continue;
+            for (const Bone& bone : SKELETON_BONES) {
+                drawCapsule(data.joints[bone.parent].Position, data.joints[bone.child].Position, boneRadius(bone.child),
+                    static_cast<BYTE>(slot), depth, bodyIndex);
+            }
+            const CameraSpacePoint& head = data.joints[JointType_Head].Position;
+            drawCapsule(head, head, 0.11f, static_cast<BYTE>(slot), depth, bodyIndex);
+        }
+
+        if (depthNoise_ > 0) {
+            uint32_t state = static_cast<uint32_t>(body.relativeTime) * 2654435761u + seed_ + 1;
+            for (UINT16& pixel : depth.pixels) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                if (pixel) pixel = static_cast<UINT16>(pixel + static_cast<int>(state % (2 * depthNoise_ + 1)) - depthNoise_);
+            }
+        }
+    }
+
+    // Writes every frame of the requested streams (color is ignored); false on a write error
+    bool writeSession(const std::string& path, UINT streams) const {
+        SessionWriter writer;
+        if (!writer.open(path, streams & ~FrameStream_Color)) return false;
+        BodyFrameData body;
+        DepthFrameData depth;
+        BodyIndexFrameData bodyIndex;
+        bool ok = true;
+        for (int frame = 0, frames = frameCount(); frame < frames && ok; ++frame) {
+            bodyFrame(frame, body);
+            if (streams & (FrameStream_Depth | FrameStream_BodyIndex)) depthFrame(body, depth, bodyIndex);
+            if (streams & FrameStream_Depth) ok = writer.writeDepthFrame(depth) && ok;
+            if (streams & FrameStream_BodyIndex) ok = writer.writeBodyIndexFrame(bodyIndex) && ok;
+            if (streams & FrameStream_Body) ok = writer.writeBodyFrame(body) && ok;
+        }
+        return writer.close() && ok;
+    }
+
+private:
+    // Where an actor is and what its limbs do at one instant
+    struct Posture {
+        float x = 0.0f, z = 0.0f;
+        float heading = 0.0f;   // rad, 0 = facing the sensor
+        float sit = 0.0f;       // 0 standing .. 1 seated
+        float gaitPhase = 0.0f; // rad, left leg; the right leg is half a cycle behind
+        float stride = 0.0f;    // rad of thigh swing each way
+        float raise[2] = {};    // left, right foot: 0 down .. 1 raised
+        float sway = 0.0f;      // m, sideways
+    };
+
+    static constexpr float PI = 3.14159265f;
+    static constexpr float THIGH = 0.42f;
+    static constexpr float SHIN = 0.42f;
+    static constexpr float ANKLE_HEIGHT = 0.08f;
+    static constexpr float STEP_LENGTH = 0.65f; // m per step
+
+    static float ramp(double t, double start, double seconds) {
+        double x = std::min(std::max((t - start) / seconds, 0.0), 1.0);
+        return static_cast<float>(x * x * (3.0 - 2.0 * x));
+    }
+
+    static double walkSeconds(const SyntheticActor& actor) {
+        return std::fabs(actor.target - actor.distance) / std::max(actor.speed, 0.1f);
+    }
+
+    static double motionSeconds(const SyntheticActor& actor) {
+        switch (actor.motion) {
+        case SyntheticMotion_Walk: return walkSeconds(actor);
+        case SyntheticMotion_Tug: return 2.0 * (RISE_SECONDS + walkSeconds(actor) + TURN_SECONDS);
+        case SyntheticMotion_OneLegStand: return 2.0 * (actor.holdSeconds + 2.0 * RAISE_SECONDS) + REST_SECONDS;
+        default: return 0.0;
+        }
+    }
+
+    // Walking from `from` towards `to` for `t` seconds, facing the way it goes
+    static void walk(const SyntheticActor& actor, float from, float to, double t, Posture& posture) {
+        float direction = to < from ? -1.0f : 1.0f;
+        posture.z = from + direction * actor.speed * static_cast<float>(t);
+        posture.heading = to < from ? 0.0f : PI;
+        posture.gaitPhase = static_cast<float>(PI * actor.speed / STEP_LENGTH * t);
+        posture.stride = std::min(0.45f, 0.3f * actor.speed / 1.2f);
+    }
+
+    static Posture posture(const SyntheticActor& actor, double time) {
+        Posture posture;
+        posture.x = actor.x;
+        posture.z = actor.distance;
+        double t = time - actor.delay;
+        double walkTime = walkSeconds(actor);
+
+        switch (actor.motion) {
+        case SyntheticMotion_Walk:
+            if (t > 0.0 && t < walkTime) walk(actor, actor.distance, actor.target, t, posture);
+            else if (t >= walkTime) posture.z = actor.target;
+            break;
+
+        case SyntheticMotion_Tug: {
+            double out = RISE_SECONDS, turn = out + walkTime, back = turn + TURN_SECONDS;
+            double turnHome = back + walkTime, sit = turnHome + TURN_SECONDS;
+            posture.sit = 1.0f - ramp(t, 0.0, RISE_SECONDS) + ramp(t, sit, RISE_SECONDS);
+            if (t > out && t < turn) {
+                walk(actor, actor.distance, actor.target, t - out, posture);
+            } else if (t >= turn && t < back) {
+                // Turning on the spot with short steps
+                posture.z = actor.target;
+                posture.heading = PI * ramp(t, turn, TURN_SECONDS);
+                posture.gaitPhase = static_cast<float>(PI * (t - turn) / 0.5);
+                posture.stride = 0.1f;
+            } else if (t >= back && t < turnHome) {
+                walk(actor, actor.target, actor.distance, t - back, posture);
+            } else if (t >= turnHome && t < sit) {
+                posture.heading = PI + PI * ramp(t, turnHome, TURN_SECONDS);
+                posture.gaitPhase = static_cast<float>(PI * (t - turnHome) / 0.5);
+                posture.stride = 0.1f;
+            }
+            break;
+        }
+
+        case SyntheticMotion_OneLegStand: {
+            int first = actor.rightFootFirst ? 1 : 0;
+            double hold = actor.holdSeconds + RAISE_SECONDS;
+            double second = hold + RAISE_SECONDS + REST_SECONDS;
+            posture.raise[first] = ramp(t, 0.0, RAISE_SECONDS) - ramp(t, hold, RAISE_SECONDS);
+            posture.raise[1 - first] = ramp(t, second, RAISE_SECONDS) - ramp(t, second + hold, RAISE_SECONDS);
+            float balance = std::max(posture.raise[0], posture.raise[1]);
+            posture.sway = balance * static_cast<float>(0.015 * std::sin(2.0 * PI * 0.5 * time) + 0.008 * std::sin(2.0 * PI * 1.3 * time));
+            break;
+        }
+
+        default:
+            break;
+        }
+        // Everyone sways a little while standing
+        posture.sway += 0.005f * static_cast<float>(std::sin(2.0 * PI * 0.25 * time + actor.x));
+        return posture;
+    }
+
+    // Joint positions of `posture`, built in the body's own frame (right, up,
+    // forward from the floor under the pelvis) and placed in camera space
+    static void pose(const Posture& posture, BodyData& body) {
+        float right[JointType_Count], up[JointType_Count], forward[JointType_Count];
+        auto set = [&](int joint, float r, float u, float f) {
+            right[joint] = r;
+            up[joint] = u;
+            forward[joint] = f;
+        };
+
+        // Legs: thigh angle from vertical (forward positive) and knee bend
+        float thighAngle[2], shinAngle[2];
+        float sitAngle = posture.sit * PI / 2.0f;
+        for (int side = 0; side < 2; ++side) {
+            float phase = posture.gaitPhase + side * PI;
+            float swingBend = posture.stride > 0.0f ? 1.4f * posture.stride * std::max(0.0f, std::cos(phase)) : 0.0f;
+            thighAngle[side] = sitAngle + posture.stride * std::sin(phase) + 0.6f * posture.raise[side];
+            shinAngle[side] = thighAngle[side] - (sitAngle + swingBend + 1.4f * posture.raise[side]);
+        }
+        // The pelvis rests on the lower supporting leg
+        float legHeight = 0.0f;
+        for (int side = 0; side < 2; ++side) {
+            if (posture.raise[side] > 0.5f) continue;
+            legHeight = std::max(legHeight, THIGH * std::cos(thighAngle[side]) + SHIN * std::cos(shinAngle[side]));
+        }
+        float hipHeight = ANKLE_HEIGHT + legHeight;
+
+        static const JointType HIP[2] = { JointType_HipLeft, JointType_HipRight };
+        static const JointType KNEE[2] = { JointType_KneeLeft, JointType_KneeRight };
+        static const JointType ANKLE[2] = { JointType_AnkleLeft, JointType_AnkleRight };
+        static const JointType FOOT[2] = { JointType_FootLeft, JointType_FootRight };
+        for (int side = 0; side < 2; ++side) {
+            float r = side == 0 ? -0.09f : 0.09f;
+            set(HIP[side], r, hipHeight, 0.0f);
+            set(KNEE[side], r, hipHeight - THIGH * std::cos(thighAngle[side]), THIGH * std::sin(thighAngle[side]));
+            set(ANKLE[side], r, up[KNEE[side]] - SHIN * std::cos(shinAngle[side]), forward[KNEE[side]] + SHIN * std::sin(shinAngle[side]));
+            set(FOOT[side], r, up[ANKLE[side]] - 0.05f, forward[ANKLE[side]] + 0.1f);
+        }
+
+        // Trunk leans forward to get up from the chair and lowers with the hips
+        float lean = 0.4f * std::sin(PI * posture.sit) + 0.1f * posture.stride;
+        float base = hipHeight + 0.03f;
+        auto spine = [&](int joint, float r, float height) {
+            set(joint, r, base + height * std::cos(lean), height * std::sin(lean));
+        };
+        spine(JointType_SpineBase, 0.0f, 0.0f);
+        spine(JointType_SpineMid, 0.0f, 0.25f);
+        spine(JointType_SpineShoulder, 0.0f, 0.48f);
+        spine(JointType_Neck, 0.0f, 0.55f);
+        spine(JointType_Head, 0.0f, 0.67f);
+        spine(JointType_ShoulderLeft, -0.18f, 0.46f);
+        spine(JointType_ShoulderRight, 0.18f, 0.46f);
+
+        // Arms swing against the legs and spread for balance on one leg
+        static const JointType SHOULDER[2] = { JointType_ShoulderLeft, JointType_ShoulderRight };
+        static const JointType ELBOW[2] = { JointType_ElbowLeft, JointType_ElbowRight };
+        static const JointType WRIST[2] = { JointType_WristLeft, JointType_WristRight };
+        static const JointType HAND[2] = { JointType_HandLeft, JointType_HandRight };
+        static const JointType HAND_TIP[2] = { JointType_HandTipLeft, JointType_HandTipRight };
+        static const JointType THUMB[2] = { JointType_ThumbLeft, JointType_ThumbRight };
+        float spread = 0.4f * std::max(posture.raise[0], posture.raise[1]);
+        for (int side = 0; side < 2; ++side) {
+            float outward = side == 0 ? -1.0f : 1.0f;
+            float swing = -0.8f * posture.stride * std::sin(posture.gaitPhase + side * PI) + 0.3f * posture.sit;
+            float forearm = swing + 0.2f + 0.6f * posture.sit;
+            int s = SHOULDER[side];
+            set(ELBOW[side], right[s] + outward * 0.28f * std::sin(spread), up[s] - 0.28f * std::cos(swing) * std::cos(spread),
+                forward[s] + 0.28f * std::sin(swing));
+            int e = ELBOW[side];
+            set(WRIST[side], right[e] + outward * (0.02f + 0.25f * std::sin(spread)), up[e] - 0.25f * std::cos(forearm) * std::cos(spread),
+                forward[e] + 0.25f * std::sin(forearm));
+            int w = WRIST[side];
+            set(HAND[side], right[w], up[w] - 0.08f * std::cos(forearm), forward[w] + 0.08f * std::sin(forearm));
+            set(HAND_TIP[side], right[w], up[w] - 0.16f * std::cos(forearm), forward[w] + 0.16f * std::sin(forearm));
+            set(THUMB[side], right[w] - outward * 0.03f, up[w] - 0.06f, forward[w] + 0.05f);
+        }
+
+        // Into camera space: forward is -Z when facing the sensor, the body's right is +X
+        float sinHeading = std::sin(posture.heading), cosHeading = std::cos(posture.heading);
+        Vector4 orientation = { 0.0f, std::sin(posture.heading / 2.0f), 0.0f, std::cos(posture.heading / 2.0f) };
+        for (int j = 0; j < JointType_Count; ++j) {
+            float r = right[j] + posture.sway;
+            Joint& joint = body.joints[j];
+            joint.JointType = static_cast<JointType>(j);
+            joint.TrackingState = TrackingState_Tracked;
+            joint.Position.X = posture.x + r * cosHeading + forward[j] * sinHeading;
+            joint.Position.Y = up[j] - SYNTHETIC_CAMERA_HEIGHT;
+            joint.Position.Z = posture.z + r * sinHeading - forward[j] * cosHeading;
+            body.orientations[j].JointType = static_cast<JointType>(j);
+            body.orientations[j].Orientation = orientation;
+        }
+    }
+
+    static float boneRadius(JointType child) {
+        switch (child) {
+        case JointType_SpineMid:
+        case JointType_SpineShoulder: return 0.15f;
+        case JointType_HipLeft:
+        case JointType_HipRight: return 0.09f;
+        case JointType_KneeLeft:
+        case JointType_KneeRight: return 0.08f;
+        case JointType_ShoulderLeft:
+        case JointType_ShoulderRight:
+        case JointType_AnkleLeft:
+        case JointType_AnkleRight:
+        case JointType_Neck:
+        case JointType_Head: return 0.06f;
+        case JointType_ElbowLeft:
+        case JointType_ElbowRight: return 0.05f;
+        case JointType_FootLeft:
+        case JointType_FootRight: return 0.045f;
+        default: return 0.04f;
+        }
+    }
+
+    // Floor and back wall, without noise
+    void makeBackground() const {
+        background_.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+        for (int v = 0; v < DEPTH_HEIGHT; ++v) {
+            float rayY = (SYNTHETIC_DEPTH_CY - v) / SYNTHETIC_DEPTH_FY; // Y per metre of Z
+            float z = SYNTHETIC_BACK_WALL;
+            if (rayY < 0.0f) z = std::min(z, SYNTHETIC_CAMERA_HEIGHT / -rayY);
+            std::fill(background_.begin() + v * DEPTH_WIDTH, background_.begin() + (v + 1) * DEPTH_WIDTH,
+                static_cast<UINT16>(z * 1000.0f));
+        }
+    }
+
+    // A capsule of `radius` around a..b, nearest surface wins
+    static void drawCapsule(const CameraSpacePoint& a, const CameraSpacePoint& b, float radius, BYTE slot,
+        DepthFrameData& depth, BodyIndexFrameData& bodyIndex) {
+        const float NEAR_LIMIT = 0.3f;
+        if (a.Z < NEAR_LIMIT || b.Z < NEAR_LIMIT) return;
+        float ua = SYNTHETIC_DEPTH_CX + SYNTHETIC_DEPTH_FX * a.X / a.Z, va = SYNTHETIC_DEPTH_CY - SYNTHETIC_DEPTH_FY * a.Y / a.Z;
+        float ub = SYNTHETIC_DEPTH_CX + SYNTHETIC_DEPTH_FX * b.X / b.Z, vb = SYNTHETIC_DEPTH_CY - SYNTHETIC_DEPTH_FY * b.Y / b.Z;
+        float pixelRadius = SYNTHETIC_DEPTH_FX * radius / std::min(a.Z, b.Z);
+
+        int left = std::max(0, static_cast<int>(std::floor(std::min(ua, ub) - pixelRadius)));
+        int right = std::min(DEPTH_WIDTH - 1, static_cast<int>(std::ceil(std::max(ua, ub) + pixelRadius)));
+        int top = std::max(0, static_cast<int>(std::floor(std::min(va, vb) - pixelRadius)));
+        int bottom = std::min(DEPTH_HEIGHT - 1, static_cast<int>(std::ceil(std::max(va, vb) + pixelRadius)));
+
+        float du = ub - ua, dv = vb - va;
+        float length2 = du * du + dv * dv;
+        float radius2 = pixelRadius * pixelRadius;
+        for (int v = top; v <= bottom; ++v) {
+            for (int u = left; u <= right; ++u) {
+                float pu = u - ua, pv = v - va;
+                float s = length2 > 0.0f ? std::min(std::max((pu * du + pv * dv) / length2, 0.0f), 1.0f) : 0.0f;
+                float eu = pu - s * du, ev = pv - s * dv;
+                float distance2 = eu * eu + ev * ev;
+                if (distance2 > radius2) continue;
+                // Round surface: nearer than the axis by up to the radius
+                float z = a.Z + s * (b.Z - a.Z) - radius * std::sqrt(1.0f - distance2 / radius2);
+                UINT16 millimetres = static_cast<UINT16>(z * 1000.0f);
+                int i = v * DEPTH_WIDTH + u;
+                if (bodyIndex.pixels[i] != 255 && depth.pixels[i] <= millimetres) continue;
+                depth.pixels[i] = millimetres;
+                bodyIndex.pixels[i] = slot;
+            }
+        }
+    }
+
+    double fps_;
+    unsigned seed_;
+    float jointNoise_ = 0.0015f;
+    int depthNoise_ = 6;
+    std::vector<SyntheticActor> actors_;
+    mutable std::vector<UINT16> background_;
+};
+
+// Frames of a SyntheticMotion through the FrameSource contract, rendered on
+// request. speed <= 0 hands out every frame as fast as it is consumed;
+// speed > 0 follows the frame times (1.0 = real time), skipping frames the
+// consumer was too slow for, as a live sensor would.
+class SyntheticFrameSource : public FrameSource {
+public:
+    explicit SyntheticFrameSource(const SyntheticMotion& motion, double speed = 0.0)
+        : motion_(motion), speed_(speed), frames_(motion.frameCount()) {}
+
+    HRESULT AcquireLatestDepthFrame(DepthFrameData& frame) override {
+        int index = next(0);
+        if (index < 0) return E_PENDING;
+        render(index);
+        frame.relativeTime = depth_.relativeTime;
+        frame.pixels = depth_.pixels;
+        return S_OK;
+    }
+
+    HRESULT AcquireLatestBodyIndexFrame(BodyIndexFrameData& frame) override {
+        int index = next(1);
+        if (index < 0) return E_PENDING;
+        render(index);
+        frame.relativeTime = bodyIndex_.relativeTime;
+        frame.pixels = bodyIndex_.pixels;
+        return S_OK;
+    }
+
+    HRESULT AcquireLatestBodyFrame(BodyFrameData& frame) override {
+        int index = next(2);
+        if (index < 0) return E_PENDING;
+        motion_.bodyFrame(index, frame);
+        return S_OK;
+    }
+
+    HRESULT AcquireLatestColorFrame(ColorFrameData&) override { return E_PENDING; }
+
+    HRESULT MapCameraPointsToColorSpace(UINT cameraPointCount, const CameraSpacePoint* cameraPoints,
+        UINT colorPointCount, ColorSpacePoint* colorPoints) override {
+        if (!cameraPoints || !colorPoints || colorPointCount < cameraPointCount) return E_INVALIDARG;
+        for (UINT i = 0; i < cameraPointCount; ++i) {
+            const CameraSpacePoint& p = cameraPoints[i];
+            if (p.Z <= 0.0f) {
+                colorPoints[i] = { -1.0f, -1.0f };
+                continue;
+            }
+            // Nominal color intrinsics, as ReplayFrameSource
+            colorPoints[i].X = 959.5f + 1081.37f * p.X / p.Z;
+            colorPoints[i].Y = 539.5f - 1081.37f * p.Y / p.Z;
+        }
+        return S_OK;
+    }
+
+    // Finished once every stream that has been read has handed out the last frame
+    bool IsFinished() const override {
+        bool read = false;
+        for (int stream = 0; stream < 3; ++stream) {
+            if (next_[stream] == 0) continue;
+            read = true;
+            if (next_[stream] < frames_) return false;
+        }
+        return read;
+    }
+
+private:
+    // Index of the frame to hand out on `stream` (depth, body index, body), or -1
+    int next(int stream) {
+        int available = frames_;
+        if (speed_ > 0.0) {
+            if (!clockStarted_) {
+                clockStarted_ = true;
+                clockStart_ = std::chrono::steady_clock::now();
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStart_).count();
+            available = std::min(frames_, static_cast<int>(elapsed * speed_ * motion_.fps()) + 1);
+            if (available > next_[stream]) next_[stream] = available - 1; // the latest only
+        }
+        if (next_[stream] >= available) return -1;
+        return next_[stream]++;
+    }
+
+    // Depth and body index of frame `index`, shared by the two streams
+    void render(int index) {
+        if (rendered_ == index) return;
+        motion_.bodyFrame(index, body_);
+        motion_.depthFrame(body_, depth_, bodyIndex_);
+        rendered_ = index;
+    }
+
+    const SyntheticMotion& motion_;
+    double speed_;
+    int frames_;
+    int next_[3] = {};
+    int rendered_ = -1;
+    bool clockStarted_ = false;
+    std::chrono::steady_clock::time_point clockStart_;
+    BodyFrameData body_;
+    DepthFrameData depth_;
+    BodyIndexFrameData bodyIndex_;
+};
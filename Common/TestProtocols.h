@@ -0,0 +1,387 @@
+// The clinical tests as ProtocolEngine plugins (Common/ProtocolEngine.h).
+// Each keeps the logic of its standalone program:
+//
+//   WalkingSpeedProtocol  timed walk between two distance gates, on the
+//                         torso distance (Walking Speed Test V3)
+//   TugProtocol           Timed Up and Go on smoothed SpineMid, one session
+//                         per person in view (Time Up and Go Test V1), or
+//                         on knee flexion for sit-to-stand and back
+//   OneLegStandProtocol   right and left foot raise times of one subject
+//                         (Standing on One Leg With Eye Open V3)
+#pragma once
+
+#include "BodySessions.h"
+#include "FrameClock.h"
+#include "GateCrossing.h"
+#include "ProtocolEngine.h"
+#include "RingFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+inline std::string formatSeconds(double seconds) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << seconds << " s";
+    return text.str();
+}
+
+// Default walking gates, metres from the sensor: the setup of Walking Speed
+// Test V1-V3, used by the runners and the threshold sweep
+const float WALK_START_DISTANCE = 6.0f;
+const float WALK_STOP_DISTANCE = 1.0f;
+
+class WalkingSpeedProtocol : public TestProtocol {
+public:
+    WalkingSpeedProtocol(float startDistance = WALK_START_DISTANCE, float stopDistance = WALK_STOP_DISTANCE, const GateParams& gate = GateParams())
+        : startDistance_(startDistance), stopDistance_(stopDistance),
+          startGate_(startDistance, gateDirection(startDistance, stopDistance), gate),
+          stopGate_(stopDistance, gateDirection(startDistance, stopDistance), gate) {}
+
+    const char* name() const override { return "walking-speed"; }
+    UINT streams() const override { return FrameStream_Depth | FrameStream_BodyIndex; }
+
+    void onFrame(const ProtocolFrame& frame, std::vector<ProtocolEvent>& events) override {
+        if (!frame.torso) return;
+        depth_ = frame.torso->pixels > 0 ? depthFilter_.push(frame.torso->depth) : depthFilter_.mean();
+
+        TIMESPAN startTime = 0, stopTime = 0;
+        bool started = startGate_.update(frame.relativeTime, depth_, startTime);
+        bool stopped = stopGate_.update(frame.relativeTime, depth_, stopTime);
+        if (started && !timer_.isRunning()) {
+            timer_.start(startTime);
+            raise(events, ProtocolEvent_Started, startTime, -1, "passed the start gate");
+        }
+        if (stopped && timer_.isRunning()) {
+            double seconds = timer_.stop(stopTime);
+            ++walks_;
+            raise(events, ProtocolEvent_Stopped, stopTime, -1, "passed the stop gate", seconds);
+        }
+    }
+
+    ProtocolResult result() const override {
+        ProtocolResult result;
+        result.complete = walks_ > 0;
+        result.seconds = timer_.finalSeconds();
+        if (result.complete) {
+            std::ostringstream text;
+            text << formatSeconds(result.seconds) << " over " << std::fabs(stopDistance_ - startDistance_) << " m, "
+                 << std::fixed << std::setprecision(2) << std::fabs(stopDistance_ - startDistance_) / result.seconds << " m/s";
+            result.summary = text.str();
+        }
+        return result;
+    }
+
+    void status(TIMESPAN now, std::vector<std::string>& lines) const override {
+        std::ostringstream text;
+        text << "Walk: depth " << std::fixed << std::setprecision(2) << depth_ << " m";
+        if (timer_.isRunning() || walks_ > 0) text << ", time " << formatSeconds(timer_.elapsedSeconds(now));
+        lines.push_back(text.str());
+    }
+
+    void reset() override {
+        depthFilter_.reset();
+        startGate_.reset();
+        stopGate_.reset();
+        timer_.reset();
+        depth_ = 0.0f;
+        walks_ = 0;
+    }
+
+private:
+    float startDistance_;
+    float stopDistance_;
+    GateCrossing startGate_;
+    GateCrossing stopGate_;
+    RingFilter<float, 3> depthFilter_;
+    FrameTimer timer_;
+    float depth_ = 0.0f;
+    int walks_ = 0;
+};
+
+struct TugParams {
+    float chairDepth = 4.0f;        // Depth when sitting on the chair
+    float targetDepth = 1.0f;       // Target depth during walking
+    float yChangeThreshold = 0.1f;  // Threshold for Y-coordinate change
+    float depthTolerance = 0.1f;    // Allowable error in depth comparison
+    float yCoordTolerance = 0.05f;  // Allowable error in Y-coordinate comparison
+    // Degrees. Above 0, standing up is knee flexion falling below this and
+    // sitting down rising above it again, instead of the SpineMid Y change
+    float kneeFlexionThreshold = 0.0f;
+};
+
+class TugProtocol : public TestProtocol {
+public:
+    explicit TugProtocol(SessionMode mode = SessionMode_Concurrent, const TugParams& params = TugParams())
+        : params_(params), sessions_(mode) {}
+
+    const TugParams& params() const { return params_; }
+
+    const char* name() const override { return "timed-up-and-go"; }
+    UINT streams() const override { return FrameStream_Body; }
+
+    void onFrame(const ProtocolFrame& frame, std::vector<ProtocolEvent>& events) override {
+        if (!frame.joints) return;
+        sessions_.update(*frame.bundle->body, [&](int slot, const BodyData& body, Session& session) {
+            CameraSpacePoint spineMid;
+            if (body.joints[JointType_SpineMid].TrackingState != TrackingState_Tracked ||
+                !frame.joints->smoothed(frame.joints->slotOf(body.trackingId), JointType_SpineMid, spineMid)) return;
+            step(session, slot, spineMid.Z, spineMid.Y, kneeFlexion(frame, body), frame.relativeTime, events);
+        }, [&](int slot, Session& session) {
+            if (session.timer.isRunning()) raise(events, ProtocolEvent_Aborted, frame.relativeTime, slot, "lost during the test");
+        });
+    }
+
+    ProtocolResult result() const override {
+        ProtocolResult result;
+        result.complete = tests_ > 0;
+        result.seconds = lastSeconds_;
+        if (result.complete) result.summary = formatSeconds(lastSeconds_);
+        return result;
+    }
+
+    void status(TIMESPAN now, std::vector<std::string>& lines) const override {
+        sessions_.forEach([&](int slot, UINT64, const Session& session) {
+            std::ostringstream text;
+            text << "TUG body " << slot << ": ";
+            if (session.timer.isRunning()) text << formatSeconds(session.timer.elapsedSeconds(now));
+            else if (session.timer.finalSeconds() > 0.0) text << "done " << formatSeconds(session.timer.finalSeconds());
+            else if (session.seated) text << "seated";
+            else text << "waiting";
+            lines.push_back(text.str());
+        });
+    }
+
+    void reset() override {
+        sessions_ = BodySessions<Session>(sessions_.mode());
+        tests_ = 0;
+        lastSeconds_ = 0.0;
+    }
+
+private:
+    struct Session {
+        FrameTimer timer;
+        bool seated = false; // seen on the chair since the last test ended
+        bool reachedTargetDepth = false;
+        TIMESPAN previousFrameTime = 0;
+        float previousDepth = 0.0f;
+        float previousYCoordinate = 0.0f;
+        float previousKnee = NO_ANGLE;
+        float initialYCoordinate = -1.0f;
+    };
+
+    static constexpr float NO_ANGLE = -1.0f;
+
+    // Mean knee flexion of the legs measured this frame, NO_ANGLE if neither is
+    static float kneeFlexion(const ProtocolFrame& frame, const BodyData& body) {
+        if (!frame.angles) return NO_ANGLE;
+        int slot = frame.angles->slotOf(body.trackingId);
+        float left, right;
+        bool hasLeft = frame.angles->angle(slot, ClinicalAngle_KneeFlexionLeft, left);
+        bool hasRight = frame.angles->angle(slot, ClinicalAngle_KneeFlexionRight, right);
+        if (hasLeft && hasRight) return 0.5f * (left + right);
+        return hasLeft ? left : (hasRight ? right : NO_ANGLE);
+    }
+
+    // One SpineMid sample, as processWalkingTest() in Time Up and Go Test V1
+    void step(Session& session, int slot, float depth, float yCoordinate, float knee, TIMESPAN frameTime, std::vector<ProtocolEvent>& events) {
+        TIMESPAN lastTime = session.previousFrameTime ? session.previousFrameTime : frameTime;
+        float lastDepth = session.previousFrameTime ? session.previousDepth : depth;
+        float lastYCoordinate = session.previousFrameTime ? session.previousYCoordinate : yCoordinate;
+        float lastKnee = session.previousKnee != NO_ANGLE ? session.previousKnee : knee;
+        session.previousFrameTime = frameTime;
+        session.previousDepth = depth;
+        session.previousYCoordinate = yCoordinate;
+        session.previousKnee = knee;
+        if (params_.kneeFlexionThreshold > 0.0f) {
+            stepOnKnee(session, slot, depth, lastDepth, knee, lastKnee, lastTime, frameTime, events);
+            return;
+        }
+
+        if (!session.seated && std::fabs(depth - params_.chairDepth) < params_.depthTolerance) {
+            session.seated = true;
+            session.initialYCoordinate = yCoordinate;
+            raise(events, ProtocolEvent_Note, frameTime, slot, "seated on the chair");
+            return;
+        }
+
+        float yChange = std::fabs(yCoordinate - session.initialYCoordinate);
+        float lastYChange = std::fabs(lastYCoordinate - session.initialYCoordinate);
+        if (!session.timer.isRunning() && yChange > params_.yChangeThreshold) {
+            TIMESPAN standTime = crossingTime(lastTime, lastYChange, frameTime, yChange, params_.yChangeThreshold);
+            session.timer.start(standTime);
+            session.reachedTargetDepth = false;
+            raise(events, ProtocolEvent_Started, standTime, slot, "stood up");
+        }
+
+        if (session.timer.isRunning() && !session.reachedTargetDepth && std::fabs(depth - params_.targetDepth) < params_.depthTolerance) {
+            session.reachedTargetDepth = true;
+            raise(events, ProtocolEvent_Note, frameTime, slot, "reached the target depth");
+        }
+
+        if (session.timer.isRunning() && session.reachedTargetDepth &&
+            std::fabs(depth - params_.chairDepth) < params_.depthTolerance && yChange < params_.yCoordTolerance) {
+            TIMESPAN seatedTime = std::max(
+                belowOnsetTime(lastTime, std::fabs(lastDepth - params_.chairDepth), frameTime, std::fabs(depth - params_.chairDepth), params_.depthTolerance),
+                belowOnsetTime(lastTime, lastYChange, frameTime, yChange, params_.yCoordTolerance));
+            lastSeconds_ = session.timer.stop(seatedTime);
+            ++tests_;
+            session.seated = false;
+            session.initialYCoordinate = -1.0f;
+            raise(events, ProtocolEvent_Stopped, seatedTime, slot, "sat down", lastSeconds_);
+        }
+    }
+
+    // The same test with sit-to-stand and stand-to-sit on knee flexion: seated
+    // at the chair depth, stood up when the knees straighten past the
+    // threshold, done when back at the chair depth with the knees bent again
+    void stepOnKnee(Session& session, int slot, float depth, float lastDepth, float knee, float lastKnee,
+                    TIMESPAN lastTime, TIMESPAN frameTime, std::vector<ProtocolEvent>& events) {
+        float threshold = params_.kneeFlexionThreshold;
+        bool atChair = std::fabs(depth - params_.chairDepth) < params_.depthTolerance;
+        if (!session.seated && atChair && knee != NO_ANGLE && knee > threshold) {
+            session.seated = true;
+            raise(events, ProtocolEvent_Note, frameTime, slot, "seated on the chair");
+            return;
+        }
+
+        if (!session.timer.isRunning() && session.seated && knee != NO_ANGLE && knee < threshold) {
+            TIMESPAN standTime = crossingTime(lastTime, lastKnee, frameTime, knee, threshold);
+            session.timer.start(standTime);
+            session.reachedTargetDepth = false;
+            raise(events, ProtocolEvent_Started, standTime, slot, "stood up");
+        }
+
+        if (session.timer.isRunning() && !session.reachedTargetDepth && std::fabs(depth - params_.targetDepth) < params_.depthTolerance) {
+            session.reachedTargetDepth = true;
+            raise(events, ProtocolEvent_Note, frameTime, slot, "reached the target depth");
+        }
+
+        if (session.timer.isRunning() && session.reachedTargetDepth && atChair && knee != NO_ANGLE && knee > threshold) {
+            TIMESPAN seatedTime = std::max(
+                belowOnsetTime(lastTime, std::fabs(lastDepth - params_.chairDepth), frameTime, std::fabs(depth - params_.chairDepth), params_.depthTolerance),
+                aboveOnsetTime(lastTime, lastKnee, frameTime, knee, threshold));
+            lastSeconds_ = session.timer.stop(seatedTime);
+            ++tests_;
+            session.seated = false;
+            raise(events, ProtocolEvent_Stopped, seatedTime, slot, "sat down", lastSeconds_);
+        }
+    }
+
+    TugParams params_;
+    BodySessions<Session> sessions_;
+    int tests_ = 0;
+    double lastSeconds_ = 0.0;
+};
+
+struct OneLegStandParams {
+    float footRaiseThresholdZ = 0.1f;  // Depth difference
+    float footRaiseThresholdY = 0.01f; // Height difference
+};
+
+class OneLegStandProtocol : public TestProtocol {
+public:
+    explicit OneLegStandProtocol(const OneLegStandParams& params = OneLegStandParams())
+        : params_(params), sessions_(SessionMode_SubjectLock) {}
+
+    const OneLegStandParams& params() const { return params_; }
+
+    const char* name() const override { return "one-leg-stand"; }
+    UINT streams() const override { return FrameStream_Body; }
+
+    void onFrame(const ProtocolFrame& frame, std::vector<ProtocolEvent>& events) override {
+        if (!frame.bundle->has(FrameStream_Body)) return;
+        sessions_.update(*frame.bundle->body, [&](int slot, const BodyData& body, Session& session) {
+            step(session, slot, body, frame.relativeTime, events);
+        }, [&](int slot, Session& session) {
+            if (session.foot[0].isRunning() || session.foot[1].isRunning()) {
+                raise(events, ProtocolEvent_Aborted, frame.relativeTime, slot, "subject lost during the test");
+            }
+        });
+    }
+
+    ProtocolResult result() const override {
+        ProtocolResult result;
+        result.complete = rightSeconds_ > 0.0 || leftSeconds_ > 0.0;
+        result.seconds = std::max(rightSeconds_, leftSeconds_);
+        if (result.complete) result.summary = "right " + formatSeconds(rightSeconds_) + ", left " + formatSeconds(leftSeconds_);
+        return result;
+    }
+
+    void status(TIMESPAN now, std::vector<std::string>& lines) const override {
+        int slot = sessions_.slotOf(sessions_.subject());
+        if (slot < 0) {
+            lines.push_back("One leg: waiting for the subject");
+            return;
+        }
+        const Session& session = sessions_.state(slot);
+        lines.push_back("One leg: right " + formatSeconds(session.foot[0].elapsedSeconds(now)) +
+                        ", left " + formatSeconds(session.foot[1].elapsedSeconds(now)));
+    }
+
+    void reset() override {
+        sessions_ = BodySessions<Session>(SessionMode_SubjectLock);
+        rightSeconds_ = leftSeconds_ = 0.0;
+    }
+
+private:
+    struct Session {
+        FrameTimer foot[2]; // right, left
+        TIMESPAN previousFrameTime = 0;
+        float previousLeftY = 0.0f, previousRightY = 0.0f;
+        float previousLeftZ = 0.0f, previousRightZ = 0.0f;
+    };
+
+    // One body frame, as processFootRaise() in Standing on One Leg V3
+    void step(Session& session, int slot, const BodyData& body, TIMESPAN frameTime, std::vector<ProtocolEvent>& events) {
+        const Joint& leftFoot = body.joints[JointType_FootLeft];
+        const Joint& rightFoot = body.joints[JointType_FootRight];
+        if (leftFoot.TrackingState != TrackingState_Tracked || rightFoot.TrackingState != TrackingState_Tracked) return;
+
+        float leftZ = leftFoot.Position.Z, rightZ = rightFoot.Position.Z;
+        float leftY = leftFoot.Position.Y, rightY = rightFoot.Position.Y;
+        if (session.previousFrameTime == 0) {
+            session.previousFrameTime = frameTime;
+            session.previousLeftY = leftY, session.previousRightY = rightY;
+            session.previousLeftZ = leftZ, session.previousRightZ = rightZ;
+        }
+        float dz = std::fabs(leftZ - rightZ), lastDz = std::fabs(session.previousLeftZ - session.previousRightZ);
+        float dy = std::fabs(leftY - rightY), lastDy = std::fabs(session.previousLeftY - session.previousRightY);
+        float rightAbove = rightY - leftY, lastRightAbove = session.previousRightY - session.previousLeftY;
+        TIMESPAN lastTime = session.previousFrameTime;
+        bool apart = dz > params_.footRaiseThresholdZ || dy > params_.footRaiseThresholdY;
+
+        for (int side = 0; side < 2; ++side) {
+            FrameTimer& timer = session.foot[side];
+            float above = side == 0 ? rightAbove : -rightAbove;
+            float lastAbove = side == 0 ? lastRightAbove : -lastRightAbove;
+            const char* foot = side == 0 ? "right foot" : "left foot";
+            const char* footTimer = side == 0 ? "right" : "left";
+            if (apart) {
+                if (above > 0.0f && !timer.isRunning()) {
+                    // Raised once the feet were apart with this one higher
+                    TIMESPAN raised = std::max(
+                        eitherAboveOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, params_.footRaiseThresholdZ, params_.footRaiseThresholdY),
+                        aboveOnsetTime(lastTime, lastAbove, frameTime, above, 0.0f));
+                    timer.start(raised);
+                    raise(events, ProtocolEvent_Started, raised, slot, std::string(foot) + " raised").timer = footTimer;
+                }
+            } else if (timer.isRunning()) {
+                TIMESPAN lowered = bothBelowOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, params_.footRaiseThresholdZ, params_.footRaiseThresholdY);
+                double seconds = timer.stop(lowered);
+                (side == 0 ? rightSeconds_ : leftSeconds_) = seconds;
+                raise(events, ProtocolEvent_Stopped, lowered, slot, std::string(foot) + " lowered", seconds).timer = footTimer;
+            }
+        }
+
+        session.previousFrameTime = frameTime;
+        session.previousLeftY = leftY, session.previousRightY = rightY;
+        session.previousLeftZ = leftZ, session.previousRightZ = rightZ;
+    }
+
+    OneLegStandParams params_;
+    BodySessions<Session> sessions_;
+    double rightSeconds_ = 0.0;
+    double leftSeconds_ = 0.0;
+};
@@ -0,0 +1,233 @@
+// Timeline of a run in the Chrome trace event format, for chrome://tracing
+// or https://ui.perfetto.dev. Spans (stage durations), instants (frame
+// arrivals, protocol events, frame gaps) and counters are queued by any
+// thread and written to the file by a background thread, so tracing costs
+// the frame loop a short lock and no I/O.
+//
+//   TraceWriter trace;
+//   trace.open("run.trace.json");
+//   { TraceSpan span(&trace, "draw", "skeleton"); ... }
+//   trace.instant("protocol", "timed-up-and-go: stood up");
+//
+// Every call is a no-op on a TraceWriter that is not open, and TraceSpan
+// accepts a null writer, so instrumented code needs no checks. Timestamps are
+// steady_clock microseconds from open(). If the writer falls behind by more
+// than MAX_PENDING events, new events are dropped and counted in the trace.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class TraceWriter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr size_t MAX_PENDING = 1 << 20;
+
+    TraceWriter() = default;
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    ~TraceWriter() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        file_.open(path, std::ios::binary);
+        if (!file_) return false;
+        file_ << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        first_ = true;
+        pending_.clear();
+        dropped_ = 0;
+        origin_ = Clock::now();
+        stop_ = false;
+        open_.store(true, std::memory_order_release);
+        writer_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    // Writes everything queued and completes the file
+    void close() {
+        if (!open_.exchange(false)) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+        file_ << "\n]}\n";
+        file_.close();
+    }
+
+    bool isOpen() const { return open_.load(std::memory_order_acquire); }
+
+    // Span from `start` to `end` on the calling thread's track
+    void complete(const char* category, const std::string& name, Clock::time_point start, Clock::time_point end,
+        const char* argName = nullptr, double argValue = 0.0) {
+        if (!isOpen()) return;
+        Event event = make('X', category, name, start, argName, argValue);
+        event.duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        push(std::move(event));
+    }
+
+    // Point event on the calling thread's track
+    void instant(const char* category, const std::string& name, const char* argName = nullptr, double argValue = 0.0) {
+        if (!isOpen()) return;
+        push(make('i', category, name, Clock::now(), argName, argValue));
+    }
+
+    // Value plotted as its own track
+    void counter(const char* name, double value) {
+        if (!isOpen()) return;
+        push(make('C', "counter", name, Clock::now(), "value", value));
+    }
+
+    // Labels the calling thread's track ("main", "capture", ...)
+    void nameThread(const std::string& name) {
+        if (!isOpen()) return;
+        push(make('M', "", name, origin_, nullptr, 0.0));
+    }
+
+private:
+    struct Event {
+        char phase;
+        const char* category;
+        std::string name;
+        int64_t time;         // microseconds from open()
+        int64_t duration = 0; // 'X' only
+        unsigned thread;
+        const char* argName;
+        double argValue;
+    };
+
+    // Small id per thread, stable for the thread's lifetime
+    static unsigned threadId() {
+        static std::atomic<unsigned> next{ 1 };
+        thread_local unsigned id = next++;
+        return id;
+    }
+
+    Event make(char phase, const char* category, const std::string& name, Clock::time_point time,
+        const char* argName, double argValue) const {
+        Event event;
+        event.phase = phase;
+        event.category = category;
+        event.name = name;
+        event.time = std::chrono::duration_cast<std::chrono::microseconds>(time - origin_).count();
+        event.thread = threadId();
+        event.argName = argName;
+        event.argValue = argValue;
+        return event;
+    }
+
+    void push(Event&& event) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_.size() >= MAX_PENDING) {
+                ++dropped_;
+                return;
+            }
+            pending_.push_back(std::move(event));
+            wake = pending_.size() == BATCH;
+        }
+        if (wake) wake_.notify_one();
+    }
+
+    // Writer thread: formats a batch every BATCH events or 100 ms
+    void run() {
+        std::vector<Event> batch;
+        std::string text;
+        bool stop = false;
+        while (!stop) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, std::chrono::milliseconds(100), [this] { return stop_ || pending_.size() >= BATCH; });
+                batch.swap(pending_);
+                stop = stop_;
+            }
+            for (const Event& event : batch) append(text, event);
+            batch.clear();
+            file_ << text;
+            text.clear();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (dropped_ > 0) {
+            Event event = make('i', "trace", "events dropped", Clock::now(), "count", static_cast<double>(dropped_));
+            append(text, event);
+            file_ << text;
+        }
+    }
+
+    void append(std::string& text, const Event& event) {
+        if (!first_) text += ",\n";
+        first_ = false;
+        text += "{\"ph\":\"";
+        text += event.phase;
+        text += "\",\"pid\":1,\"tid\":" + std::to_string(event.thread);
+        if (event.phase == 'M') {
+            text += ",\"name\":\"thread_name\",\"args\":{\"name\":" + quote(event.name) + "}}";
+            return;
+        }
+        text += ",\"ts\":" + std::to_string(event.time);
+        if (event.phase == 'X') text += ",\"dur\":" + std::to_string(event.duration);
+        if (event.phase == 'i') text += ",\"s\":\"t\"";
+        text += ",\"cat\":" + quote(event.category) + ",\"name\":" + quote(event.name);
+        if (event.argName) {
+            text += ",\"args\":{" + quote(event.argName) + ":" + std::to_string(event.argValue) + "}";
+        }
+        text += "}";
+    }
+
+    static std::string quote(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static constexpr size_t BATCH = 4096;
+
+    std::atomic<bool> open_{ false };
+    std::ofstream file_;
+    Clock::time_point origin_;
+    bool first_ = true; // writer thread only, once open
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Event> pending_;
+    size_t dropped_ = 0;
+    bool stop_ = false;
+    std::thread writer_;
+};
+
+// Records the time from construction to destruction as a span; `trace` may be null
+class TraceSpan {
+public:
+    TraceSpan(TraceWriter* trace, const char* category, const char* name)
+        : trace_(trace && trace->isOpen() ? trace : nullptr), category_(category), name_(name) {
+        if (trace_) start_ = TraceWriter::Clock::now();
+    }
+
+    ~TraceSpan() {
+        if (trace_) trace_->complete(category_, name_, start_, TraceWriter::Clock::now());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceWriter* trace_;
+    const char* category_;
+    const char* name_;
+    TraceWriter::Clock::time_point start_;
+};
@@ -0,0 +1,148 @@
+// Fixed set of worker threads for independent jobs of uneven size, such as
+// scoring a directory of recordings. Every worker has its own task deque:
+// it runs its newest task from the back and, when that runs dry, steals the
+// oldest task from the front of another worker's deque. A worker stuck on
+// one long recording no longer holds up the short ones queued behind it,
+// and the workers only contend on a deque when one of them steals. Claiming
+// a task also takes one shared lock, so tasks should be coarse: a recording,
+// a parameter set, not a frame.
+//
+//   WorkStealingPool pool;                 // one worker per hardware thread
+//   for (const std::string& path : paths) pool.submit([&, path] { score(path); });
+//   pool.wait();
+//
+// Tasks submitted from a worker go to that worker's own deque. An exception
+// thrown by a task is rethrown by the next wait().
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    // `threads` = 0 starts one worker per hardware thread
+    explicit WorkStealingPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; ++i) queues_.emplace_back(new Queue());
+        for (unsigned i = 0; i < threads; ++i) workers_.emplace_back([this, i] { run(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs what is still queued, then stops the workers
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) worker.join();
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    void submit(std::function<void()> task) {
+        unsigned queue = worker_ && worker_->pool == this ? worker_->index : next_++ % size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+            queues_[queue]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++queued_;
+            ++unfinished_;
+        }
+        wake_.notify_one();
+    }
+
+    // Blocks until every task submitted so far has run; not from a worker
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return unfinished_ == 0; });
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    struct WorkerId {
+        const WorkStealingPool* pool;
+        unsigned index;
+    };
+
+    // Own newest task first, then the oldest task of the next worker that has one
+    bool take(unsigned self, std::function<void()>& task) {
+        for (unsigned i = 0; i < size(); ++i) {
+            Queue& queue = *queues_[(self + i) % size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(unsigned self) {
+        WorkerId id = { this, self };
+        worker_ = &id;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+                if (queued_ == 0) return; // stopping and drained
+                --queued_;
+            }
+            // A task is reserved for this worker, so one of the deques holds it
+            std::function<void()> task;
+            while (!take(self, task)) std::this_thread::yield();
+
+            std::exception_ptr error;
+            try {
+                task();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            task = nullptr;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error && !error_) error_ = error;
+            if (--unfinished_ == 0) done_.notify_all();
+        }
+    }
+
+    static inline thread_local WorkerId* worker_ = nullptr;
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<unsigned> next_{ 0 };
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    size_t queued_ = 0;     // tasks in the deques not yet claimed by a worker
+    size_t unfinished_ = 0; // tasks submitted and not yet finished
+    bool stop_ = false;
+    std::exception_ptr error_;
+};
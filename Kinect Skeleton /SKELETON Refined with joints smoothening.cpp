@@ -1,64 +1,14 @@
-#include <Kinect.h>
+#include "../Common/FrameSource.h"
+#include "../Common/JointFilterBank.h"
+#include "../Common/JointColorMap.h"
+#include "../Common/SkeletonTopology.h"
+#include "../Common/StageTimer.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
-#include <deque>
 
 using namespace std;
 
-// Define pairs of joints to draw skeleton
-const std::vector<std::pair<JointType, JointType>> bones = {
-    { JointType_Head, JointType_Neck },
-    { JointType_Neck, JointType_SpineShoulder },
-    { JointType_SpineShoulder, JointType_SpineMid },
-    { JointType_SpineMid, JointType_SpineBase },
-    { JointType_SpineShoulder, JointType_ShoulderLeft },
-    { JointType_SpineShoulder, JointType_ShoulderRight },
-    { JointType_SpineBase, JointType_HipLeft },
-    { JointType_SpineBase, JointType_HipRight },
-    { JointType_ShoulderLeft, JointType_ElbowLeft },
-    { JointType_ElbowLeft, JointType_WristLeft },
-    { JointType_WristLeft, JointType_HandLeft },
-    { JointType_ShoulderRight, JointType_ElbowRight },
-    { JointType_ElbowRight, JointType_WristRight },
-    { JointType_WristRight, JointType_HandRight },
-    { JointType_HipLeft, JointType_KneeLeft },
-    { JointType_KneeLeft, JointType_AnkleLeft },
-    { JointType_AnkleLeft, JointType_FootLeft },
-    { JointType_HipRight, JointType_KneeRight },
-    { JointType_KneeRight, JointType_AnkleRight },
-    { JointType_AnkleRight, JointType_FootRight }
-};
-
-// Structure for filtering joint positions
-struct JointFilter {
-    deque<float> x, y, z;
-    size_t window_size = 5;
-
-    void add(float newX, float newY, float newZ) {
-        if (x.size() >= window_size) {
-            x.pop_front();
-            y.pop_front();
-            z.pop_front();
-        }
-        x.push_back(newX);
-        y.push_back(newY);
-        z.push_back(newZ);
-    }
-
-    void getSmoothed(float& smoothedX, float& smoothedY, float& smoothedZ) {
-        smoothedX = smoothedY = smoothedZ = 0;
-        for (size_t i = 0; i < x.size(); ++i) {
-            smoothedX += x[i];
-            smoothedY += y[i];
-            smoothedZ += z[i];
-        }
-        smoothedX /= x.size();
-        smoothedY /= y.size();
-        smoothedZ /= z.size();
-    }
-};
-
 int main() {
     // Initialize Kinect Sensor, readers, and coordinate mapper
     IKinectSensor* sensor = nullptr;
@@ -84,10 +34,30 @@ int main() {
 
     cv::namedWindow("Kinect Skeleton", cv::WINDOW_AUTOSIZE);
 
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
+
+    // Joint smoothing state for every tracked body, kept across frames
+    JointFilterBank jointFilters;
+
+    // Color pixels of the smoothed joints, refreshed every body frame
+    JointColorMap jointMap;
+
+    // Where the frame time goes, printed on P and on exit
+    StageProfiler profiler;
+    const int acquireStage = profiler.stage("acquire");
+    const int convertStage = profiler.stage("convert");
+    const int bodyStage = profiler.stage("body");
+    const int mapStage = profiler.stage("map");
+    const int drawStage = profiler.stage("draw");
+    const int showStage = profiler.stage("show");
+
     // Frame loop
     while (true) {
         IColorFrame* colorFrame = nullptr;
+        StageTimer acquireTimer(profiler, acquireStage);
         HRESULT hrColor = colorFrameReader->AcquireLatestFrame(&colorFrame);
+        acquireTimer.stop();
 
         if (SUCCEEDED(hrColor)) {
             IFrameDescription* frameDescription = nullptr;
@@ -97,94 +67,106 @@ int main() {
             frameDescription->get_Width(&width);
             frameDescription->get_Height(&height);
 
-            UINT bufferSize = width * height * 4;
-            BYTE* colorBuffer = new BYTE[bufferSize];
+            // Lease a preallocated buffer instead of allocating one per frame
+            FrameLease<ColorFrameData> colorLease = colorPool.lease();
+            UINT bufferSize = static_cast<UINT>(colorLease->bgra.size());
+            BYTE* colorBuffer = colorLease->bgra.data();
+            StageTimer convertTimer(profiler, convertStage);
             hrColor = colorFrame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
+            convertTimer.stop();
 
             if (SUCCEEDED(hrColor)) {
+                // Draw the overlay straight onto the BGRA buffer, no BGR copy
                 cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
 
                 IBodyFrame* bodyFrame = nullptr;
+                StageTimer bodyTimer(profiler, bodyStage);
                 HRESULT hrBody = bodyFrameReader->AcquireLatestFrame(&bodyFrame);
 
                 if (SUCCEEDED(hrBody)) {
                     IBody* bodies[BODY_COUNT] = { 0 };
                     hrBody = bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
 
-                    JointFilter jointFilters[JointType_Count];  // One filter for each joint
-
+                    // Feed every tracked body to the filter bank, then smooth all joints at once
+                    Joint bodyJoints[BODY_COUNT][JointType_Count];
+                    int bodySlots[BODY_COUNT];
+                    jointFilters.beginFrame();
                     for (int i = 0; i < BODY_COUNT; ++i) {
+                        bodySlots[i] = -1;
                         IBody* body = bodies[i];
                         if (body) {
                             BOOLEAN isTracked = false;
                             body->get_IsTracked(&isTracked);
 
                             if (isTracked) {
-                                Joint joints[JointType_Count];
-                                body->GetJoints(_countof(joints), joints);
-
-                                // Draw bones (lines connecting joints)
-                                for (const auto& bone : bones) {
-                                    Joint joint1 = joints[bone.first];
-                                    Joint joint2 = joints[bone.second];
-
-                                    if (joint1.TrackingState == TrackingState_Tracked && joint2.TrackingState == TrackingState_Tracked) {
-                                        ColorSpacePoint colorPoint1, colorPoint2;
-                                        coordinateMapper->MapCameraPointToColorSpace(joint1.Position, &colorPoint1);
-                                        coordinateMapper->MapCameraPointToColorSpace(joint2.Position, &colorPoint2);
-
-                                        int x1 = static_cast<int>(colorPoint1.X);
-                                        int y1 = static_cast<int>(colorPoint1.Y);
-                                        int x2 = static_cast<int>(colorPoint2.X);
-                                        int y2 = static_cast<int>(colorPoint2.Y);
-
-                                        // Check if the coordinates are within bounds
-                                        if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height &&
-                                            x2 >= 0 && x2 < width && y2 >= 0 && y2 < height) {
-                                            cv::line(bgrMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 3);
-                                        }
-                                    }
-                                }
-
-                                // Draw circles at each of the 25 joints with filtering
-                                for (int j = 0; j < JointType_Count; j++) {
-                                    if (joints[j].TrackingState == TrackingState_Tracked) {
-                                        float smoothedX, smoothedY, smoothedZ;
-                                        jointFilters[j].add(joints[j].Position.X, joints[j].Position.Y, joints[j].Position.Z);
-                                        jointFilters[j].getSmoothed(smoothedX, smoothedY, smoothedZ);
-
-                                        ColorSpacePoint colorPoint;
-                                        coordinateMapper->MapCameraPointToColorSpace({ smoothedX, smoothedY, smoothedZ }, &colorPoint);
-
-                                        int x = static_cast<int>(colorPoint.X);
-                                        int y = static_cast<int>(colorPoint.Y);
-
-                                        // Check if the joint position is within bounds before drawing
-                                        if (x >= 0 && x < width && y >= 0 && y < height) {
-                                            cv::circle(bgrMat, cv::Point(x, y), 10, cv::Scalar(0, 0, 255), -1); // Draw a circle with radius 10
-                                        }
-                                    }
-                                }
+                                UINT64 trackingId = 0;
+                                body->get_TrackingId(&trackingId);
+                                body->GetJoints(_countof(bodyJoints[i]), bodyJoints[i]);
+                                bodySlots[i] = jointFilters.addBody(trackingId, bodyJoints[i]);
+                            }
+                        }
+                    }
+                    jointFilters.endFrame();
+                    bodyTimer.stop();
+
+                    // Map the smoothed joints of every body to color pixels in one call;
+                    // bones and joint markers are both drawn from them
+                    StageTimer mapTimer(profiler, mapStage);
+                    jointMap.clear();
+                    for (int i = 0; i < BODY_COUNT; ++i) {
+                        if (bodySlots[i] < 0) continue;
+                        for (int j = 0; j < JointType_Count; j++) {
+                            CameraSpacePoint smoothedPosition;
+                            if (bodyJoints[i][j].TrackingState == TrackingState_Tracked &&
+                                jointFilters.smoothed(bodySlots[i], static_cast<JointType>(j), smoothedPosition)) {
+                                jointMap.add(i, static_cast<JointType>(j), smoothedPosition);
+                            }
+                        }
+                    }
+                    jointMap.map(*coordinateMapper);
+                    mapTimer.stop();
+
+                    StageTimer drawTimer(profiler, drawStage);
+                    for (int i = 0; i < BODY_COUNT; ++i) {
+                        if (bodySlots[i] < 0) continue;
+
+                        // Draw bones (lines connecting joints)
+                        forEachBone<JointGroup_Body>([&](const Bone& bone) {
+                            int x1, y1, x2, y2;
+                            if (jointMap.pixel(i, bone.parent, width, height, x1, y1) &&
+                                jointMap.pixel(i, bone.child, width, height, x2, y2)) {
+                                cv::line(colorMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 3);
+                            }
+                        });
+
+                        // Draw circles at each of the 25 joints with filtering
+                        for (int j = 0; j < JointType_Count; j++) {
+                            int x, y;
+                            if (jointMap.pixel(i, static_cast<JointType>(j), width, height, x, y)) {
+                                cv::circle(colorMat, cv::Point(x, y), 10, cv::Scalar(0, 0, 255), -1); // Draw a circle with radius 10
                             }
                         }
                     }
+                    drawTimer.stop();
 
                     bodyFrame->Release();
                 }
+                bodyTimer.stop(); // no body frame this time
 
-                cv::imshow("Kinect Skeleton", bgrMat);
+                StageTimer showTimer(profiler, showStage);
+                cv::imshow("Kinect Skeleton", colorMat);
             }
 
-            delete[] colorBuffer;
             colorFrame->Release();
             frameDescription->Release();
         }
 
-        // Break on Enter key press
-        if (cv::waitKey(30) == 13) break;
+        // Break on Enter key press, print stage latencies on P
+        int key = cv::waitKey(30);
+        if (key == 13) break;
+        if (key == 'p' || key == 'P') profiler.report(std::cout);
     }
+    profiler.report(std::cout);
 
     // Release Kinect resources
     colorFrameReader->Release();
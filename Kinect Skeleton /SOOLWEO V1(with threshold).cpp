@@ -1,4 +1,4 @@
-#include <Kinect.h>
+#include "../Common/FrameSource.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
@@ -9,30 +9,6 @@
 using namespace std;
 using namespace std::chrono;
 
-// Define pairs of joints to draw skeleton
-const std::vector<std::pair<JointType, JointType>> bones = {
-    { JointType_Head, JointType_Neck },
-    { JointType_Neck, JointType_SpineShoulder },
-    { JointType_SpineShoulder, JointType_SpineMid },
-    { JointType_SpineMid, JointType_SpineBase },
-    { JointType_SpineShoulder, JointType_ShoulderLeft },
-    { JointType_SpineShoulder, JointType_ShoulderRight },
-    { JointType_SpineBase, JointType_HipLeft },
-    { JointType_SpineBase, JointType_HipRight },
-    { JointType_ShoulderLeft, JointType_ElbowLeft },
-    { JointType_ElbowLeft, JointType_WristLeft },
-    { JointType_WristLeft, JointType_HandLeft },
-    { JointType_ShoulderRight, JointType_ElbowRight },
-    { JointType_ElbowRight, JointType_WristRight },
-    { JointType_WristRight, JointType_HandRight },
-    { JointType_HipLeft, JointType_KneeLeft },
-    { JointType_KneeLeft, JointType_AnkleLeft },
-    { JointType_AnkleLeft, JointType_FootLeft },
-    { JointType_HipRight, JointType_KneeRight },
-    { JointType_KneeRight, JointType_AnkleRight },
-    { JointType_AnkleRight, JointType_FootRight }
-};
-
 // Joint tracking and foot position tracking logic
 struct JointTracker {
     float prevZ = 0.0f;
@@ -137,6 +113,9 @@ int main() {
     bool rightFootRaised = false;
     bool balanceChecked = false;
 
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
+
     while (true) {
         // Process color frame
         IColorFrame* colorFrame = nullptr;
@@ -150,14 +129,15 @@ int main() {
             frameDescription->get_Width(&width);
             frameDescription->get_Height(&height);
 
-            UINT bufferSize = width * height * 4;
-            BYTE* colorBuffer = new BYTE[bufferSize];
+            // Lease a preallocated buffer instead of allocating one per frame
+            FrameLease<ColorFrameData> colorLease = colorPool.lease();
+            UINT bufferSize = static_cast<UINT>(colorLease->bgra.size());
+            BYTE* colorBuffer = colorLease->bgra.data();
             hrColor = colorFrame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
 
             if (SUCCEEDED(hrColor)) {
+                // Draw the overlay straight onto the BGRA buffer, no BGR copy
                 cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
 
                 // Process body frame
                 IBodyFrame* bodyFrame = nullptr;
@@ -195,7 +175,7 @@ int main() {
 
                                 // Show message asking to raise right foot
                                 if (!rightFootRaised) {
-                                    cv::putText(bgrMat, "Raise your right foot!", cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
+                                    cv::putText(colorMat, "Raise your right foot!", cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
                                     if (rightAnkle.TrackingState == TrackingState_Tracked && fabs(rightAnkle.Position.Z - leftAnkle.Position.Z) > 0.2f) {
                                         rightFootRaised = true;
                                         cout << "Right foot raised!" << endl;
@@ -216,10 +196,9 @@ int main() {
                     bodyFrame->Release();
                 }
 
-                cv::imshow("Kinect Camera Feed", bgrMat);
+                cv::imshow("Kinect Camera Feed", colorMat);
             }
 
-            delete[] colorBuffer;
             frameDescription->Release();
             colorFrame->Release();
         }
@@ -1,34 +1,12 @@
-#include <Kinect.h>
+#include "../Common/FrameSource.h"
+#include "../Common/JointColorMap.h"
+#include "../Common/SkeletonTopology.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
 
 using namespace std;
 
-// Define pairs of joints to draw skeleton
-const std::vector<std::pair<JointType, JointType>> bones = {
-    { JointType_Head, JointType_Neck },
-    { JointType_Neck, JointType_SpineShoulder },
-    { JointType_SpineShoulder, JointType_SpineMid },
-    { JointType_SpineMid, JointType_SpineBase },
-    { JointType_SpineShoulder, JointType_ShoulderLeft },
-    { JointType_SpineShoulder, JointType_ShoulderRight },
-    { JointType_SpineBase, JointType_HipLeft },
-    { JointType_SpineBase, JointType_HipRight },
-    { JointType_ShoulderLeft, JointType_ElbowLeft },
-    { JointType_ElbowLeft, JointType_WristLeft },
-    { JointType_WristLeft, JointType_HandLeft },
-    { JointType_ShoulderRight, JointType_ElbowRight },
-    { JointType_ElbowRight, JointType_WristRight },
-    { JointType_WristRight, JointType_HandRight },
-    { JointType_HipLeft, JointType_KneeLeft },
-    { JointType_KneeLeft, JointType_AnkleLeft },
-    { JointType_AnkleLeft, JointType_FootLeft },
-    { JointType_HipRight, JointType_KneeRight },
-    { JointType_KneeRight, JointType_AnkleRight },
-    { JointType_AnkleRight, JointType_FootRight }
-};
-
 int main() {
     // Initialize Kinect Sensor, readers, and coordinate mapper
     IKinectSensor* sensor = nullptr;
@@ -54,6 +32,12 @@ int main() {
 
     cv::namedWindow("Kinect Skeleton", cv::WINDOW_AUTOSIZE);
 
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
+
+    // Color pixels of the tracked joints, refreshed every body frame
+    JointColorMap jointMap;
+
     // Frame loop
     while (true) {
         IColorFrame* colorFrame = nullptr;
@@ -67,14 +51,15 @@ int main() {
             frameDescription->get_Width(&width);
             frameDescription->get_Height(&height);
 
-            UINT bufferSize = width * height * 4;
-            BYTE* colorBuffer = new BYTE[bufferSize];
+            // Lease a preallocated buffer instead of allocating one per frame
+            FrameLease<ColorFrameData> colorLease = colorPool.lease();
+            UINT bufferSize = static_cast<UINT>(colorLease->bgra.size());
+            BYTE* colorBuffer = colorLease->bgra.data();
             hrColor = colorFrame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
 
             if (SUCCEEDED(hrColor)) {
+                // Draw the overlay straight onto the BGRA buffer, no BGR copy
                 cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
 
                 IBodyFrame* bodyFrame = nullptr;
                 HRESULT hrBody = bodyFrameReader->AcquireLatestFrame(&bodyFrame);
@@ -83,6 +68,18 @@ int main() {
                     IBody* bodies[BODY_COUNT] = { 0 };
                     hrBody = bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
 
+                    // Map the tracked joints of every body to color pixels in one call
+                    Joint bodyJoints[BODY_COUNT][JointType_Count];
+                    jointMap.clear();
+                    for (int i = 0; i < BODY_COUNT; ++i) {
+                        BOOLEAN isTracked = false;
+                        if (bodies[i] && SUCCEEDED(bodies[i]->get_IsTracked(&isTracked)) && isTracked) {
+                            bodies[i]->GetJoints(_countof(bodyJoints[i]), bodyJoints[i]);
+                            jointMap.addBody(i, bodyJoints[i]);
+                        }
+                    }
+                    jointMap.map(*coordinateMapper);
+
                     for (int i = 0; i < BODY_COUNT; ++i) {
                         IBody* body = bodies[i];
                         if (body) {
@@ -90,45 +87,27 @@ int main() {
                             body->get_IsTracked(&isTracked);
 
                             if (isTracked) {
-                                // Declare the joints array inside the loop
-                                Joint joints[JointType_Count];
-                                body->GetJoints(_countof(joints), joints);
+                                const Joint* joints = bodyJoints[i];
 
                                 // Draw bones (lines connecting joints)
-                                for (const auto& bone : bones) {
-                                    Joint joint1 = joints[bone.first];
-                                    Joint joint2 = joints[bone.second];
-
-                                    if (joint1.TrackingState == TrackingState_Tracked && joint2.TrackingState == TrackingState_Tracked) {
-                                        ColorSpacePoint colorPoint1, colorPoint2;
-                                        coordinateMapper->MapCameraPointToColorSpace(joint1.Position, &colorPoint1);
-                                        coordinateMapper->MapCameraPointToColorSpace(joint2.Position, &colorPoint2);
-
-                                        int x1 = static_cast<int>(colorPoint1.X);
-                                        int y1 = static_cast<int>(colorPoint1.Y);
-                                        int x2 = static_cast<int>(colorPoint2.X);
-                                        int y2 = static_cast<int>(colorPoint2.Y);
-
+                                forEachBone<JointGroup_Body>([&](const Bone& bone) {
+                                    if (joints[bone.parent].TrackingState == TrackingState_Tracked && joints[bone.child].TrackingState == TrackingState_Tracked) {
+                                        int x1, y1, x2, y2;
                                         // Check if the coordinates are within bounds
-                                        if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height &&
-                                            x2 >= 0 && x2 < width && y2 >= 0 && y2 < height) {
-                                            cv::line(bgrMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 3);
+                                        if (jointMap.pixel(i, bone.parent, width, height, x1, y1) &&
+                                            jointMap.pixel(i, bone.child, width, height, x2, y2)) {
+                                            cv::line(colorMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 3);
                                         }
                                     }
-                                }
+                                });
 
                                 // Draw circles at each of the 25 joints
                                 for (int j = 0; j < JointType_Count; j++) {
                                     if (joints[j].TrackingState == TrackingState_Tracked) {
-                                        ColorSpacePoint colorPoint;
-                                        coordinateMapper->MapCameraPointToColorSpace(joints[j].Position, &colorPoint);
-
-                                        int x = static_cast<int>(colorPoint.X);
-                                        int y = static_cast<int>(colorPoint.Y);
-
+                                        int x, y;
                                         // Check if the joint position is within bounds before drawing
-                                        if (x >= 0 && x < width && y >= 0 && y < height) {
-                                            cv::circle(bgrMat, cv::Point(x, y), 10, cv::Scalar(0, 0, 255), -1); // Draw a circle with radius 10
+                                        if (jointMap.pixel(i, static_cast<JointType>(j), width, height, x, y)) {
+                                            cv::circle(colorMat, cv::Point(x, y), 10, cv::Scalar(0, 0, 255), -1); // Draw a circle with radius 10
                                         }
                                     }
                                 }
@@ -139,10 +118,9 @@ int main() {
                     bodyFrame->Release();
                 }
 
-                cv::imshow("Kinect Skeleton", bgrMat);
+                cv::imshow("Kinect Skeleton", colorMat);
             }
 
-            delete[] colorBuffer;
             colorFrame->Release();
             frameDescription->Release();
         }
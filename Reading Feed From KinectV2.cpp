@@ -1,4 +1,5 @@
-#include <Kinect.h>
+#include "Common/FrameSource.h"
+#include "Common/AllocationCounter.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 
@@ -21,6 +22,14 @@ int main() {
     // Create an OpenCV window
     cv::namedWindow("Kinect Feed", cv::WINDOW_AUTOSIZE);
 
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
+
+    // Heap allocations made while acquiring and copying frames, after warm-up
+    const int warmupFrames = 30;
+    int framesCaptured = 0;
+    uint64_t steadyStateAllocations = 0;
+
     // Frame loop
     while (true) {
         IColorFrame* frame = nullptr;
@@ -35,26 +44,25 @@ int main() {
             frameDescription->get_Width(&width);
             frameDescription->get_Height(&height);
 
-            // Allocate buffer for the color data
-            UINT bufferSize = width * height * 4; // 4 bytes per pixel (BGRA)
-            BYTE* colorBuffer = new BYTE[bufferSize];
+            // Lease a preallocated buffer for the color data
+            uint64_t allocationsBefore = heapAllocations();
+            FrameLease<ColorFrameData> colorLease = colorPool.lease();
+            UINT bufferSize = static_cast<UINT>(colorLease->bgra.size()); // 4 bytes per pixel (BGRA)
+            BYTE* colorBuffer = colorLease->bgra.data();
 
             // Copy the color data to the buffer
             hr = frame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
+            if (++framesCaptured > warmupFrames) {
+                steadyStateAllocations += heapAllocations() - allocationsBefore;
+            }
+
             if (SUCCEEDED(hr)) {
-                // Create an OpenCV Mat from the buffer
+                // Display the BGRA buffer directly, imshow ignores the alpha channel
                 cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-
-                // Convert BGRA to BGR for OpenCV
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
-
-                // Display the image in the OpenCV window
-                cv::imshow("Kinect Feed", bgrMat);
+                cv::imshow("Kinect Feed", colorMat);
             }
 
             // Clean up
-            delete[] colorBuffer;
             frame->Release();
             frameDescription->Release(); // Release the frame description
         }
@@ -72,5 +80,9 @@ int main() {
     sensor->Close();
     sensor->Release();
 
+    if (framesCaptured > warmupFrames) {
+        std::cout << "Heap allocations in " << (framesCaptured - warmupFrames)
+                  << " steady-state frames: " << steadyStateAllocations << std::endl;
+    }
     return 0;
 }
@@ -1,5 +1,5 @@
 //sensitive for right foot, best for left foot, cant differentiate between feet always prints right foot, and ultimately cant differentiate between multiple people who is the real patient and so on and so forth
-#include <Kinect.h>
+#include "../Common/FrameSource.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
@@ -115,6 +115,9 @@ int main() {
     bool rightFootRaised = false;
     bool balanceChecked = false;
 
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
+
     while (true) {
         // Process color frame
         IColorFrame* colorFrame = nullptr;
@@ -128,14 +131,15 @@ int main() {
             frameDescription->get_Width(&width);
             frameDescription->get_Height(&height);
 
-            UINT bufferSize = width * height * 4;
-            BYTE* colorBuffer = new BYTE[bufferSize];
+            // Lease a preallocated buffer instead of allocating one per frame
+            FrameLease<ColorFrameData> colorLease = colorPool.lease();
+            UINT bufferSize = static_cast<UINT>(colorLease->bgra.size());
+            BYTE* colorBuffer = colorLease->bgra.data();
             hrColor = colorFrame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
 
             if (SUCCEEDED(hrColor)) {
+                // Draw the overlay straight onto the BGRA buffer, no BGR copy
                 cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
 
                 // Process body frame
                 IBodyFrame* bodyFrame = nullptr;
@@ -173,7 +177,7 @@ int main() {
 
                                 // Show message asking to raise right foot
                                 if (!rightFootRaised) {
-                                    cv::putText(bgrMat, "Raise your right foot!", cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
+                                    cv::putText(colorMat, "Raise your right foot!", cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 255, 0), 2);
                                     if (rightAnkle.TrackingState == TrackingState_Tracked && fabs(rightAnkle.Position.Z - leftAnkle.Position.Z) > 0.1f) {
                                         rightFootRaised = true;
                                         cout << "Right foot raised!" << endl;
@@ -194,10 +198,9 @@ int main() {
                     bodyFrame->Release();
                 }
 
-                cv::imshow("Kinect Camera Feed", bgrMat);
+                cv::imshow("Kinect Camera Feed", colorMat);
             }
 
-            delete[] colorBuffer;
             frameDescription->Release();
             colorFrame->Release();
         }
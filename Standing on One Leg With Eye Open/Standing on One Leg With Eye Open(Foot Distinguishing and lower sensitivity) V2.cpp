@@ -1,4 +1,4 @@
-#include <Kinect.h>
+#include "../Common/FrameClock.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <chrono>
@@ -11,10 +11,12 @@ using namespace std::chrono;
 const float FOOT_RAISE_THRESHOLD_Z = 0.1f; // Depth difference
 const float FOOT_RAISE_THRESHOLD_Y = 0.05f; // Height difference
 
-// Timer variables
-steady_clock::time_point footRaiseStart;
-bool timerActive = false;
-float elapsedTime = 0.0f;
+// Timer variables, on the sensor clock
+FrameTimer footRaiseTimer;
+
+// Previous foot sample, for sub-frame event times
+TIMESPAN previousFrameTime = 0;
+float previousFootDz = 0.0f, previousFootDy = 0.0f;
 
 void drawText(cv::Mat& frame, const string& text, cv::Point position, cv::Scalar color, double scale = 1.0) {
     cv::putText(frame, text, position, cv::FONT_HERSHEY_SIMPLEX, scale, color, 2);
@@ -77,6 +79,10 @@ int main() {
             IBody* bodies[BODY_COUNT] = { 0 };
             bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
 
+            // Capture time of this body frame on the sensor clock
+            TIMESPAN frameTime = 0;
+            bodyFrame->get_RelativeTime(&frameTime);
+
             cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(0, 0, 0)); // Black background for feed
 
             for (int i = 0; i < BODY_COUNT; ++i) {
@@ -101,30 +107,42 @@ int main() {
                             float leftY = leftFoot.Position.Y;
                             float rightY = rightFoot.Position.Y;
 
+                            // Previous sample (this one if there is none yet)
+                            float dz = fabs(leftZ - rightZ);
+                            float dy = fabs(leftY - rightY);
+                            if (previousFrameTime == 0) {
+                                previousFrameTime = frameTime;
+                                previousFootDz = dz, previousFootDy = dy;
+                            }
+                            TIMESPAN lastTime = previousFrameTime;
+                            float lastDz = previousFootDz, lastDy = previousFootDy;
+                            previousFrameTime = frameTime;
+                            previousFootDz = dz, previousFootDy = dy;
+
                             // Determine which foot is raised
                             string status = "Standing";
-                            if (fabs(leftZ - rightZ) > FOOT_RAISE_THRESHOLD_Z ||
-                                fabs(leftY - rightY) > FOOT_RAISE_THRESHOLD_Y) {
+                            if (dz > FOOT_RAISE_THRESHOLD_Z || dy > FOOT_RAISE_THRESHOLD_Y) {
+                                // Raised once the feet moved apart past either threshold
+                                TIMESPAN raiseTime = eitherAboveOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy,
+                                    FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y);
 
                                 if (leftY > rightY) {
                                     status = "Left Foot Raised";
-                                    if (!timerActive) {
-                                        footRaiseStart = steady_clock::now();
-                                        timerActive = true;
+                                    if (!footRaiseTimer.isRunning()) {
+                                        footRaiseTimer.start(raiseTime);
                                     }
                                 } else if (rightY > leftY) {
                                     status = "Right Foot Raised";
-                                    if (!timerActive) {
-                                        footRaiseStart = steady_clock::now();
-                                        timerActive = true;
+                                    if (!footRaiseTimer.isRunning()) {
+                                        footRaiseTimer.start(raiseTime);
                                     }
                                 }
                             } else {
-                                if (timerActive) {
-                                    auto footRaiseEnd = steady_clock::now();
-                                    elapsedTime = duration_cast<seconds>(footRaiseEnd - footRaiseStart).count();
+                                if (footRaiseTimer.isRunning()) {
+                                    // Lowered once the feet were back within both thresholds
+                                    double elapsedTime = footRaiseTimer.stop(bothBelowOnsetTime(lastTime, lastDz, lastDy,
+                                        frameTime, dz, dy, FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y));
                                     cout << "Foot raised for " << elapsedTime << " seconds." << endl;
-                                    timerActive = false;
                                 }
                             }
 
@@ -132,9 +150,8 @@ int main() {
                             drawText(frame, "Status: " + status, cv::Point(50, 50), cv::Scalar(0, 255, 0));
 
                             // Display live timer
-                            if (timerActive) {
-                                auto currentTime = steady_clock::now();
-                                float liveElapsedTime = duration_cast<seconds>(currentTime - footRaiseStart).count();
+                            if (footRaiseTimer.isRunning()) {
+                                float liveElapsedTime = static_cast<float>(footRaiseTimer.elapsedSeconds(frameTime));
                                 drawText(frame, "Timer: " + to_string(liveElapsedTime) + "s", cv::Point(50, 100), cv::Scalar(0, 255, 255));
                             }
                         }
@@ -1,32 +1,48 @@
 //doesnt account for raised foot touching non raised foot. 
-#include <Kinect.h>
+#include "../Common/KinectFrameSource.h"
+#include "../Common/FrameCapture.h"
+#include "../Common/FrameClock.h"
+#include "../Common/BodySessions.h"
+#include "../Common/AsyncLogger.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <chrono>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 using namespace std::chrono;
 
-// Declare global variables
-IKinectSensor* sensor = nullptr;
-IBodyFrameReader* bodyFrameReader = nullptr;
-IColorFrameReader* colorFrameReader = nullptr;
-ICoordinateMapper* coordinateMapper = nullptr;
-
-HRESULT hr; // Declare hr to handle HRESULT values
-
 // Threshold for foot raise detection
 const float FOOT_RAISE_THRESHOLD_Z = 0.1f; // Depth difference
 const float FOOT_RAISE_THRESHOLD_Y = 0.01f; // Height difference
 const float FOOT_TOUCH_THRESHOLD = 0.05f; // Adjust this value as needed
 
-// Timer variables
-steady_clock::time_point footRaiseStart;
-bool rightFootTimerActive = false;
-bool leftFootTimerActive = false;
-float elapsedTimeRight = 0.0f;
-float elapsedTimeLeft = 0.0f;
+// Test state of the subject, kept per TrackingId
+struct FootSession {
+    bool feetTracked = false; // both feet tracked in the latest body frame
+    FrameTimer rightFootTimer; // on the sensor clock
+    FrameTimer leftFootTimer;
+
+    // Previous foot sample, for sub-frame event times
+    TIMESPAN previousFrameTime = 0;
+    float previousLeftY = 0.0f, previousRightY = 0.0f;
+    float previousLeftZ = 0.0f, previousRightZ = 0.0f;
+};
+
+// Only the first person tracked is tested, so someone walking past cannot
+// start or stop the timers. Shared by the analytics thread and the UI loop
+// under footStateMutex.
+mutex footStateMutex;
+BodySessions<FootSession> sessions(SessionMode_SubjectLock);
+
+// Timer events are written to the console by a background thread, so
+// analytics never waits on it while holding footStateMutex
+AsyncLogger logger;
+LogChannel testLog(logger, "test");
 
 // Function to draw text on the image
 void drawText(cv::Mat& frame, const string& text, cv::Point position, cv::Scalar color, double scale = 1.0) {
@@ -35,228 +51,201 @@ void drawText(cv::Mat& frame, const string& text, cv::Point position, cv::Scalar
 
 
 //function
-void stopTimerIfFootTouchesGroundOrOtherLeg(float raisedFootY, float raisedFootZ, float unraisedFootY, float unraisedFootZ, bool& timerActive, steady_clock::time_point& startTime, float& elapsedTime) {
+void stopTimerIfFootTouchesGroundOrOtherLeg(float raisedFootY, float raisedFootZ, float unraisedFootY, float unraisedFootZ, FrameTimer& timer, TIMESPAN frameTime) {
     // Check if the foot touches the ground (based on Y value) or touches the unraised foot (based on Z or Y difference)
     if (raisedFootY < 0.1f || // Raised foot touches the ground
         (fabs(raisedFootY - unraisedFootY) < 0.05f && fabs(raisedFootZ - unraisedFootZ) < 0.1f)) { // Raised foot touches the unraised foot
-        if (timerActive) {
-            auto footRaiseEnd = steady_clock::now();
-            elapsedTime = duration_cast<seconds>(footRaiseEnd - startTime).count();
-            timerActive = false;
+        if (timer.isRunning()) {
+            timer.stop(frameTime);
         }
     }
 }
 
-int main() {
-    // Initialize Kinect
-    hr = GetDefaultKinectSensor(&sensor);
-    if (FAILED(hr) || !sensor) {
-        cerr << "Error: Kinect sensor not found. HRESULT: " << hr << endl;
-        return -1;
-    }
+// Foot-raise detection for one body frame; call with footStateMutex held
+void processFootRaise(const BodyFrameData& bodyFrame) {
+    sessions.update(bodyFrame, [&](int, const BodyData& body, FootSession& session) {
+        FrameTimer& rightFootTimer = session.rightFootTimer;
+        FrameTimer& leftFootTimer = session.leftFootTimer;
+        session.feetTracked = false;
+
+        Joint leftFoot = body.joints[JointType_FootLeft];
+        Joint rightFoot = body.joints[JointType_FootRight];
+
+        // Ensure joints are tracked
+        if (leftFoot.TrackingState != TrackingState_Tracked ||
+            rightFoot.TrackingState != TrackingState_Tracked) return;
+        session.feetTracked = true;
+
+        float leftZ = leftFoot.Position.Z;
+        float rightZ = rightFoot.Position.Z;
+        float leftY = leftFoot.Position.Y;
+        float rightY = rightFoot.Position.Y;
+
+        // Previous sample (this one if there is none yet)
+        TIMESPAN frameTime = bodyFrame.relativeTime;
+        if (session.previousFrameTime == 0) {
+            session.previousFrameTime = frameTime;
+            session.previousLeftY = leftY, session.previousRightY = rightY;
+            session.previousLeftZ = leftZ, session.previousRightZ = rightZ;
+        }
+        float dz = fabs(leftZ - rightZ), lastDz = fabs(session.previousLeftZ - session.previousRightZ);
+        float dy = fabs(leftY - rightY), lastDy = fabs(session.previousLeftY - session.previousRightY);
+        float rightAbove = rightY - leftY, lastRightAbove = session.previousRightY - session.previousLeftY;
+        TIMESPAN lastTime = session.previousFrameTime;
+
+        // Check if the right foot is raised
+        if (dz > FOOT_RAISE_THRESHOLD_Z || dy > FOOT_RAISE_THRESHOLD_Y) {
+
+            if (rightY > leftY) {
+                //cout << "Right foot raised" << endl;
+                if (!rightFootTimer.isRunning()) {
+                    // Raised once the feet were apart with the right one higher
+                    rightFootTimer.start(max(
+                        eitherAboveOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y),
+                        aboveOnsetTime(lastTime, lastRightAbove, frameTime, rightAbove, 0.0f)));
+                }
+            }
 
-    hr = sensor->Open();
-    if (FAILED(hr)) {
-        cerr << "Error: Could not open Kinect sensor. HRESULT: " << hr << endl;
-        return -1;
-    }
+        }
+        else if (rightFootTimer.isRunning()) {
+            // Lowered once the feet were back within both thresholds
+            rightFootTimer.stop(bothBelowOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y));
 
-    // Initialize coordinate mapper
-    hr = sensor->get_CoordinateMapper(&coordinateMapper);
-    if (FAILED(hr)) {
-        cerr << "Error: Could not get coordinate mapper. HRESULT: " << hr << endl;
-        sensor->Close();
-        sensor->Release();
-        return -1;
-    }
+            // Print final time for right foot
+            testLog.info() << "Final Right Foot Time: " << rightFootTimer.finalSeconds() << " seconds";
+        }
 
-    // Initialize body frame reader
-    IBodyFrameSource* bodySource = nullptr;
-    hr = sensor->get_BodyFrameSource(&bodySource);
-    if (FAILED(hr) || !bodySource) {
-        cerr << "Error: Body frame source not found. HRESULT: " << hr << endl;
-        sensor->Close();
-        sensor->Release();
-        return -1;
-    }
+        // Check if the left foot is raised
+        if (dz > FOOT_RAISE_THRESHOLD_Z || dy > FOOT_RAISE_THRESHOLD_Y) {
 
-    hr = bodySource->OpenReader(&bodyFrameReader);
-    if (FAILED(hr)) {
-        cerr << "Error: Could not open body frame reader. HRESULT: " << hr << endl;
-        bodySource->Release();
-        sensor->Close();
-        sensor->Release();
-        return -1;
-    }
+            if (leftY > rightY) {
+                if (!leftFootTimer.isRunning()) {
+                    leftFootTimer.start(max(
+                        eitherAboveOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y),
+                        aboveOnsetTime(lastTime, -lastRightAbove, frameTime, -rightAbove, 0.0f)));
+                }
+            }
 
-    bodySource->Release();
+        }
+        else if (leftFootTimer.isRunning()) {
+            // Lowered once the feet were back within both thresholds
+            leftFootTimer.stop(bothBelowOnsetTime(lastTime, lastDz, lastDy, frameTime, dz, dy, FOOT_RAISE_THRESHOLD_Z, FOOT_RAISE_THRESHOLD_Y));
 
-    // Initialize color frame reader
-    IColorFrameSource* colorFrameSource = nullptr;
-    hr = sensor->get_ColorFrameSource(&colorFrameSource);
-    if (FAILED(hr)) {
-        cerr << "Error: Unable to get color frame source." << endl;
-        bodyFrameReader->Release();
-        sensor->Close();
-        sensor->Release();
-        return -1;
-    }
+            // Print final time for left foot
+            testLog.info() << "Final Left Foot Time: " << leftFootTimer.finalSeconds() << " seconds";
+        }
 
-    hr = colorFrameSource->OpenReader(&colorFrameReader);
-    if (FAILED(hr)) {
-        cerr << "Error: Unable to open color frame reader." << endl;
-        colorFrameSource->Release();
-        bodyFrameReader->Release();
-        sensor->Close();
-        sensor->Release();
+        session.previousFrameTime = frameTime;
+        session.previousLeftY = leftY, session.previousRightY = rightY;
+        session.previousLeftZ = leftZ, session.previousRightZ = rightZ;
+    }, [](int, FootSession& session) {
+        if (session.rightFootTimer.isRunning() || session.leftFootTimer.isRunning()) {
+            testLog.warning() << "Subject lost during the test, timer discarded";
+        }
+    });
+}
+
+// Usage: V3 [recording.ksession]
+// Without an argument the live Kinect is used.
+int main(int argc, char** argv) {
+    // Open the live sensor or a recorded session
+    string replayPath = argc > 1 ? argv[1] : "";
+    unique_ptr<FrameSource> source = openFrameSource(replayPath, FrameStream_Body | FrameStream_Color, 1.0);
+    if (!source) {
         return -1;
     }
 
-    colorFrameSource->Release();
+    // Acquire on a dedicated thread so rendering never holds up the sensor
+    FrameCapture capture(*source);
+    capture.start(FrameStream_Body | FrameStream_Color);
+
+    // Analytics thread: every body frame, in order, at sensor rate
+    atomic<bool> stopAnalytics(false);
+    uint64_t bodyFramesProcessed = 0;
+    thread analytics([&]() {
+        FrameLease<BodyFrameData> bodyFrame;
+        while (!stopAnalytics) {
+            if (!capture.body().waitPop(bodyFrame, milliseconds(100))) {
+                if (capture.sourceFinished() && capture.body().empty()) break;
+                continue;
+            }
+            lock_guard<mutex> lock(footStateMutex);
+            processFootRaise(*bodyFrame);
+            ++bodyFramesProcessed;
+        }
+    });
 
     // OpenCV window
     cv::namedWindow("Kinect Feed", cv::WINDOW_AUTOSIZE);
 
-    while (true) {
-        // Get the body frame
-        IBodyFrame* bodyFrame = nullptr;
-        hr = bodyFrameReader->AcquireLatestFrame(&bodyFrame);
-
-        if (SUCCEEDED(hr) && bodyFrame) {
-            IBody* bodies[BODY_COUNT] = { 0 };
-            bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
-
-            // Get color frame
-            IColorFrame* colorFrame = nullptr;
-            hr = colorFrameReader->AcquireLatestFrame(&colorFrame);
-            if (SUCCEEDED(hr) && colorFrame) {
-                int width = 1920; // Kinect color frame width
-                int height = 1080; // Kinect color frame height
-                cv::Mat colorImage(height, width, CV_8UC4); // 4 channels (BGRA)
-
-                hr = colorFrame->CopyConvertedFrameDataToArray(width * height * 4, (BYTE*)colorImage.data, ColorImageFormat_Bgra);
-                if (SUCCEEDED(hr)) {
-                    // Display "Test Ready" initially
-                    string status = "Test Ready";
-                    string instruction = "Please Raise your Right foot";
-
-                    // Display text instructions
-                    drawText(colorImage, status, cv::Point(50, 50), cv::Scalar(0, 255, 0));
-                    drawText(colorImage, instruction, cv::Point(50, 100), cv::Scalar(0, 255, 0));
-
-                    for (int i = 0; i < BODY_COUNT; ++i) {
-                        IBody* body = bodies[i];
-                        if (body) {
-                            BOOLEAN isTracked = false;
-                            body->get_IsTracked(&isTracked);
-
-                            if (isTracked) {
-                                Joint joints[JointType_Count];
-                                body->GetJoints(_countof(joints), joints);
-
-                                Joint leftFoot = joints[JointType_FootLeft];
-                                Joint rightFoot = joints[JointType_FootRight];
-
-                                // Ensure joints are tracked
-                                if (leftFoot.TrackingState == TrackingState_Tracked &&
-                                    rightFoot.TrackingState == TrackingState_Tracked) {
-
-                                    float leftZ = leftFoot.Position.Z;
-                                    float rightZ = rightFoot.Position.Z;
-                                    float leftY = leftFoot.Position.Y;
-                                    float rightY = rightFoot.Position.Y;
-
-
-                                    // Check if the right foot is raised
-                                    if (fabs(leftZ - rightZ) > FOOT_RAISE_THRESHOLD_Z ||
-                                        fabs(leftY - rightY) > FOOT_RAISE_THRESHOLD_Y) {
-
-                                        if (rightY > leftY) {
-                                            //cout << "Right foot raised" << endl;
-                                            instruction = "Right foot raised";
-                                            if (!rightFootTimerActive) {
-                                                footRaiseStart = steady_clock::now();
-                                                rightFootTimerActive = true;
-                                            }
-                                        }
-                                        
-                                    }
-                                    else if (rightFootTimerActive) {
-                                        auto footRaiseEnd = steady_clock::now();
-                                        elapsedTimeRight = duration_cast<seconds>(footRaiseEnd - footRaiseStart).count();
-                                        rightFootTimerActive = false;
-
-                                        // Print final time for right foot
-                                        cout << "Final Right Foot Time: " << elapsedTimeRight << " seconds" << endl;
-                                    }
-
-                                    // If right foot timer is active, display the elapsed time
-                                    if (rightFootTimerActive) {
-                                        auto currentTime = steady_clock::now();
-                                        float liveElapsedTimeRight = duration_cast<seconds>(currentTime - footRaiseStart).count();
-                                        drawText(colorImage, "Timer: " + to_string(liveElapsedTimeRight) + "s", cv::Point(50, 150), cv::Scalar(0, 255, 255));
-                                    }
-                                    else if (elapsedTimeRight > 0) {
-                                        drawText(colorImage, "Timer: " + to_string(elapsedTimeRight) + "s", cv::Point(50, 150), cv::Scalar(0, 255, 255));
-                                    }
-
-                                    // Now ask for the left foot
-                                    instruction = "Please Raise your Left foot";
-                                    drawText(colorImage, instruction, cv::Point(50, 200), cv::Scalar(0, 255, 0));
-
-                                    // Check if the left foot is raised
-                                    if (fabs(leftZ - rightZ) > FOOT_RAISE_THRESHOLD_Z ||
-                                        fabs(leftY - rightY) > FOOT_RAISE_THRESHOLD_Y) {
-
-                                        if (leftY > rightY) {
-                                            instruction = "Left foot raised";
-                                            if (!leftFootTimerActive) {
-                                                footRaiseStart = steady_clock::now();
-                                                leftFootTimerActive = true;
-                                            }
-                                        }
-                                        
-                                    }
-                                    else if (leftFootTimerActive) {
-                                        auto footRaiseEnd = steady_clock::now();
-                                        elapsedTimeLeft = duration_cast<seconds>(footRaiseEnd - footRaiseStart).count();
-                                        leftFootTimerActive = false;
-
-                                        // Print final time for left foot
-                                        cout << "Final Left Foot Time: " << elapsedTimeLeft << " seconds" << endl;
-                                    }
-
-                                    // If left foot timer is active, display the elapsed time
-                                    if (leftFootTimerActive) {
-                                        auto currentTime = steady_clock::now();
-                                        float liveElapsedTimeLeft = duration_cast<seconds>(currentTime - footRaiseStart).count();
-                                        drawText(colorImage, "Timer: " + to_string(liveElapsedTimeLeft) + "s", cv::Point(50, 250), cv::Scalar(0, 255, 255));
-                                    }
-                                    else if (elapsedTimeLeft > 0) {
-                                        drawText(colorImage, "Timer: " + to_string(elapsedTimeLeft) + "s", cv::Point(50, 250), cv::Scalar(0, 255, 255));
-                                    }
-                                }
-                            }
-                        }
-                    }
-
-                    // Display the live color feed with the overlayed text
-                    imshow("Kinect Feed", colorImage);
+    // UI loop: newest color frame, at whatever rate rendering allows
+    FrameLease<ColorFrameData> colorFrame;
+    bool userQuit = false;
+    while (!capture.sourceFinished() || !capture.color().empty()) {
+        if (capture.color().popLatest(colorFrame)) {
+            cv::Mat colorImage(COLOR_HEIGHT, COLOR_WIDTH, CV_8UC4, colorFrame->bgra.data()); // 4 channels (BGRA)
+
+            // Display "Test Ready" initially
+            string status = "Test Ready";
+            string instruction = "Please Raise your Right foot";
+
+            // Display text instructions
+            drawText(colorImage, status, cv::Point(50, 50), cv::Scalar(0, 255, 0));
+            drawText(colorImage, instruction, cv::Point(50, 100), cv::Scalar(0, 255, 0));
+
+            // Copy the timers under the lock; draw without it so a slow
+            // frame never holds up the analytics thread
+            bool feetTracked = false, showRight = false, showLeft = false;
+            float elapsedTimeRight = 0.0f, elapsedTimeLeft = 0.0f;
+            unique_lock<mutex> lock(footStateMutex);
+            int slot = sessions.slotOf(sessions.subject());
+            if (slot >= 0 && sessions.state(slot).feetTracked) {
+                const FrameTimer& rightFootTimer = sessions.state(slot).rightFootTimer;
+                const FrameTimer& leftFootTimer = sessions.state(slot).leftFootTimer;
+                feetTracked = true;
+                // Live time runs up to the frame on screen
+                showRight = rightFootTimer.isRunning() || rightFootTimer.finalSeconds() > 0;
+                if (showRight) elapsedTimeRight = static_cast<float>(rightFootTimer.elapsedSeconds(colorFrame->relativeTime));
+                showLeft = leftFootTimer.isRunning() || leftFootTimer.finalSeconds() > 0;
+                if (showLeft) elapsedTimeLeft = static_cast<float>(leftFootTimer.elapsedSeconds(colorFrame->relativeTime));
+            }
+            lock.unlock();
+
+            if (feetTracked) {
+                // If right foot timer is active, display the elapsed time
+                if (showRight) {
+                    drawText(colorImage, "Timer: " + to_string(elapsedTimeRight) + "s", cv::Point(50, 150), cv::Scalar(0, 255, 255));
+                }
+
+                // Now ask for the left foot
+                instruction = "Please Raise your Left foot";
+                drawText(colorImage, instruction, cv::Point(50, 200), cv::Scalar(0, 255, 0));
+
+                // If left foot timer is active, display the elapsed time
+                if (showLeft) {
+                    drawText(colorImage, "Timer: " + to_string(elapsedTimeLeft) + "s", cv::Point(50, 250), cv::Scalar(0, 255, 255));
                 }
-                colorFrame->Release();
             }
-            bodyFrame->Release();
+
+            // Display the live color feed with the overlayed text
+            imshow("Kinect Feed", colorImage);
         }
 
-        if (cv::waitKey(30) == 13) break; // Press Enter to exit
+        if (cv::waitKey(30) == 13) { // Press Enter to exit
+            userQuit = true;
+            break;
+        }
     }
 
-    // Cleanup
-    colorFrameReader->Release();
-    bodyFrameReader->Release();
-    coordinateMapper->Release();
-    sensor->Close();
-    sensor->Release();
+    // At the end of a recording let analytics finish the queued frames
+    if (userQuit) stopAnalytics = true;
+    analytics.join();
+    capture.stop();
 
+    logger.flush();
+    cout << "Analytics: " << bodyFramesProcessed << " body frames processed, "
+         << capture.body().dropped() << " dropped" << endl;
+    cout << "Render: " << capture.color().captured() << " color frames captured, "
+         << capture.color().skipped() << " skipped, " << capture.color().dropped() << " dropped" << endl;
     return 0;
 }
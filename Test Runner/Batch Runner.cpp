@@ -0,0 +1,293 @@
+// Headless counterpart of the Test Runner for unattended runs: no window,
+// no OpenCV, results as JSON lines (Common/JsonResults.h). Recordings are
+// scored in parallel on a work-stealing pool (Common/WorkStealingPool.h),
+// one recording per task, each as fast as its engine consumes the frames.
+// A directory argument adds every .ksession below it. Without recordings
+// the live Kinect is read until Ctrl+C.
+//
+// Usage: "Batch Runner" [walk|tug|one-leg|all] [--jobs N] [--out results.jsonl] [--table results.csv]
+//                       [--trace timeline.json] [recording.ksession | directory ...]
+// Records go to standard output unless --out is given, grouped by recording
+// in argument order; progress and errors go to standard error. --table
+// writes one CSV row per recording and test. --jobs defaults to one worker
+// per hardware thread. --trace writes a Chrome trace (Common/TraceWriter.h)
+// of every engine.
+#include "../Common/KinectFrameSource.h"
+#include "../Common/JsonResults.h"
+#include "../Common/TestProtocols.h"
+#include "../Common/WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const char* TEST_NAMES[] = { "walk", "tug", "one-leg", "all" };
+const int TEST_ALL = 3;
+
+// Every stream a protocol reads; color is only needed for drawing
+const UINT STREAMS = FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body;
+
+atomic<bool> stopRequested{ false };
+mutex progressMutex;
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+// One test's result on one recording, a row of the --table output
+struct TestScore {
+    string test;
+    ProtocolResult result;
+    int passes = 0; // timed phases completed
+};
+
+struct SourceScore {
+    string source;
+    bool opened = false;
+    uint64_t frames = 0;
+    double streamSeconds = 0.0;
+    double wallSeconds = 0.0;
+    vector<TestScore> tests;
+};
+
+// Runs the selected tests over one source, writing its records to `out`.
+// Returns false if the source could not be opened.
+bool runSource(const string& replayPath, int test, ostream& out, TraceWriter& trace, SourceScore& score) {
+    score.source = replayPath.empty() ? "live" : replayPath;
+    // Replays free-run: every recorded frame, as fast as it is processed
+    unique_ptr<FrameSource> source = openFrameSource(replayPath, STREAMS, 0.0);
+    if (!source) {
+        return false;
+    }
+    score.opened = true;
+
+    WalkingSpeedProtocol walk(WALK_START_DISTANCE, WALK_STOP_DISTANCE);
+    TugProtocol tug;
+    OneLegStandProtocol oneLeg;
+    TestProtocol* const protocols[] = { &walk, &tug, &oneLeg };
+
+    ProtocolEngine engine(*source, STREAMS);
+    engine.setTrace(&trace);
+    // A recording scores the same however busy the machine is
+    if (!replayPath.empty()) engine.setDepthBudget(0.0);
+    trace.instant("source", score.source);
+    for (int i = 0; i < TEST_ALL; ++i) {
+        if (test != TEST_ALL && test != i) continue;
+        if (!engine.add(*protocols[i])) {
+            lock_guard<mutex> lock(progressMutex);
+            cerr << score.source << ": " << protocols[i]->name() << " needs a stream this session does not have" << endl;
+        }
+    }
+
+    JsonResultWriter writer(out);
+    writer.beginSource(score.source);
+    // Timed phases completed per protocol, counted as the events go by
+    vector<int> passes(engine.protocols().size(), 0);
+    auto wallStart = chrono::steady_clock::now();
+    while (!stopRequested) {
+        uint64_t frames = engine.frames();
+        if (!engine.step()) break;
+        for (const ProtocolEvent& event : engine.events()) {
+            writer.event(event);
+            if (event.type != ProtocolEvent_Stopped) continue;
+            for (size_t p = 0; p < passes.size(); ++p) {
+                if (strcmp(event.protocol, engine.protocols()[p]->name()) == 0) ++passes[p];
+            }
+        }
+        // The live sensor delivers at 30 Hz; wait instead of spinning between frames
+        if (replayPath.empty() && engine.frames() == frames) this_thread::sleep_for(chrono::milliseconds(2));
+    }
+    score.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    score.frames = engine.frames();
+    score.streamSeconds = ticksToSeconds(engine.time() - engine.firstTime());
+
+    for (size_t p = 0; p < engine.protocols().size(); ++p) {
+        const TestProtocol* protocol = engine.protocols()[p];
+        writer.summary(*protocol);
+        TestScore testScore;
+        testScore.test = protocol->name();
+        testScore.result = protocol->result();
+        testScore.passes = passes[p];
+        score.tests.push_back(testScore);
+    }
+    writer.session(score.frames, score.streamSeconds, score.wallSeconds);
+
+    lock_guard<mutex> lock(progressMutex);
+    cerr << score.source << ": " << score.frames << " frames in " << score.wallSeconds << " s" << endl;
+    return true;
+}
+
+// Recordings named on the command line; directories add every .ksession below them, sorted
+vector<string> expandRecordings(const vector<string>& arguments) {
+    vector<string> recordings;
+    for (const string& argument : arguments) {
+        error_code error;
+        if (!filesystem::is_directory(argument, error)) {
+            recordings.push_back(argument);
+            continue;
+        }
+        vector<string> found;
+        for (const auto& entry : filesystem::recursive_directory_iterator(argument, error)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".ksession") found.push_back(entry.path().string());
+        }
+        sort(found.begin(), found.end());
+        recordings.insert(recordings.end(), found.begin(), found.end());
+    }
+    return recordings;
+}
+
+string csvField(const string& text) {
+    if (text.find_first_of(",\"\n") == string::npos) return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+bool writeTable(const string& path, const vector<SourceScore>& scores) {
+    ofstream table(path);
+    if (!table) return false;
+    table << "source,test,complete,passes,seconds,summary,frames,stream_seconds,wall_seconds\n";
+    table << fixed << setprecision(3);
+    for (const SourceScore& score : scores) {
+        for (const TestScore& test : score.tests) {
+            table << csvField(score.source) << "," << test.test << "," << (test.result.complete ? 1 : 0) << ","
+                  << test.passes << "," << test.result.seconds << "," << csvField(test.result.summary) << ","
+                  << score.frames << "," << score.streamSeconds << "," << score.wallSeconds << "\n";
+        }
+    }
+    return static_cast<bool>(table);
+}
+
+int main(int argc, char** argv) {
+    vector<string> arguments;
+    string outPath;
+    string tablePath;
+    string tracePath;
+    unsigned jobs = 0;
+    int test = TEST_ALL;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+            continue;
+        }
+        if (arg == "--table" && i + 1 < argc) {
+            tablePath = argv[++i];
+            continue;
+        }
+        if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            continue;
+        }
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(max(1, atoi(argv[++i])));
+            continue;
+        }
+        int named = -1;
+        for (int t = 0; t <= TEST_ALL; ++t) {
+            if (arg == TEST_NAMES[t]) named = t;
+        }
+        if (named >= 0) test = named;
+        else arguments.push_back(arg);
+    }
+
+    ofstream outFile;
+    if (!outPath.empty()) {
+        outFile.open(outPath);
+        if (!outFile) {
+            cerr << "Failed to open " << outPath << " for writing" << endl;
+            return -1;
+        }
+    }
+    ostream& out = outPath.empty() ? cout : outFile;
+
+    TraceWriter trace;
+    if (!tracePath.empty() && !trace.open(tracePath)) {
+        cerr << "Failed to open " << tracePath << " for writing" << endl;
+        return -1;
+    }
+
+    // Ctrl+C ends a live run (or the recordings being scored) with their summaries written
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    vector<SourceScore> scores;
+    if (arguments.empty()) {
+        scores.resize(1);
+        if (!runSource("", test, out, trace, scores[0])) return -1;
+        if (!tablePath.empty() && !writeTable(tablePath, scores)) {
+            cerr << "Failed to write " << tablePath << endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    vector<string> recordings = expandRecordings(arguments);
+    scores.resize(recordings.size());
+    vector<string> records(recordings.size());
+
+    // Smallest first: each worker runs its newest (largest) task first, and
+    // thieves take the small ones from the front, so no long recording is
+    // left to run alone at the end
+    vector<size_t> order(recordings.size());
+    iota(order.begin(), order.end(), 0);
+    vector<uintmax_t> sizes(recordings.size());
+    for (size_t i = 0; i < recordings.size(); ++i) {
+        error_code error;
+        sizes[i] = filesystem::file_size(recordings[i], error);
+        if (error) sizes[i] = 0;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] < sizes[b]; });
+
+    auto wallStart = chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(jobs);
+        for (size_t i : order) {
+            pool.submit([&, i] {
+                if (stopRequested) return;
+                ostringstream text;
+                runSource(recordings[i], test, text, trace, scores[i]);
+                records[i] = text.str();
+            });
+        }
+        jobs = pool.size();
+        pool.wait();
+    }
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+
+    int failed = 0;
+    uint64_t frames = 0;
+    double streamSeconds = 0.0;
+    for (size_t i = 0; i < recordings.size(); ++i) {
+        out << records[i];
+        if (!scores[i].opened) ++failed;
+        frames += scores[i].frames;
+        streamSeconds += scores[i].streamSeconds;
+    }
+    out.flush();
+    cerr << recordings.size() << " recordings, " << frames << " frames, " << streamSeconds << " s of sensor time in "
+         << wallSeconds << " s on " << jobs << (jobs == 1 ? " worker" : " workers") << endl;
+
+    if (!tablePath.empty() && !writeTable(tablePath, scores)) {
+        cerr << "Failed to write " << tablePath << endl;
+        return -1;
+    }
+    return failed ? -1 : 0;
+}
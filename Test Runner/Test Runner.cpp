@@ -0,0 +1,167 @@
+// Runs the walking speed, Timed Up and Go and one-leg stand tests through the
+// ProtocolEngine (Common/ProtocolEngine.h) on one sensor session. The sensor
+// is opened once; switching tests only changes which protocols the engine
+// runs, and "all" runs the three over the same frames.
+//
+// Keys: 1 walking speed, 2 Timed Up and Go, 3 one-leg stand, 4 all,
+// P print stage latencies, ESC quit.
+//
+// Usage: "Test Runner" [walk|tug|one-leg|all] [--trace timeline.json] [recording.ksession]
+// Without a recording the live Kinect is used. --trace writes a Chrome trace
+// (Common/TraceWriter.h) of the run.
+#include "../Common/KinectFrameSource.h"
+#include "../Common/JointColorMap.h"
+#include "../Common/StageTimer.h"
+#include "../Common/TestProtocols.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+const char* TEST_NAMES[] = { "walk", "tug", "one-leg", "all" };
+const int TEST_ALL = 3;
+
+// Runs test `test` (an index into TEST_NAMES) from the next frame on
+void selectTest(ProtocolEngine& engine, TestProtocol* const* protocols, int test) {
+    engine.clear();
+    for (int i = 0; i < TEST_ALL; ++i) {
+        if (test != TEST_ALL && test != i) continue;
+        protocols[i]->reset();
+        if (!engine.add(*protocols[i])) {
+            cerr << protocols[i]->name() << " needs a stream this session does not have" << endl;
+        }
+    }
+    cout << "Running: " << TEST_NAMES[test] << endl;
+}
+
+void printEvent(const ProtocolEvent& event) {
+    cout << "[" << fixed << setprecision(3) << ticksToSeconds(event.time) << " s] " << event.protocol;
+    if (event.body >= 0) cout << " body " << event.body;
+    cout << ": " << event.message;
+    if (event.type == ProtocolEvent_Stopped) cout << ", " << formatSeconds(event.seconds);
+    cout << endl;
+}
+
+int main(int argc, char** argv) {
+    string replayPath;
+    string tracePath;
+    int test = TEST_ALL;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            continue;
+        }
+        int named = -1;
+        for (int t = 0; t <= TEST_ALL; ++t) {
+            if (arg == TEST_NAMES[t]) named = t;
+        }
+        if (named >= 0) test = named;
+        else replayPath = arg;
+    }
+
+    // Every stream any protocol reads, opened once for the whole session
+    const UINT streams = FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body | FrameStream_Color;
+    unique_ptr<FrameSource> source = openFrameSource(replayPath, streams, 1.0);
+    if (!source) {
+        return -1;
+    }
+
+    TraceWriter trace;
+    if (!tracePath.empty() && !trace.open(tracePath)) {
+        cerr << "Failed to open " << tracePath << " for writing" << endl;
+        return -1;
+    }
+    trace.nameThread("main");
+
+    ProtocolEngine engine(*source, streams);
+    engine.setTrace(&trace);
+    WalkingSpeedProtocol walk(WALK_START_DISTANCE, WALK_STOP_DISTANCE);
+    TugProtocol tug;
+    OneLegStandProtocol oneLeg;
+    TestProtocol* const protocols[] = { &walk, &tug, &oneLeg };
+    selectTest(engine, protocols, test);
+
+    JointColorMap jointMap;
+
+    // Where the frame time goes, printed on P and on exit
+    StageProfiler profiler;
+    const int stepStage = profiler.stage("engine");
+    const int mapStage = profiler.stage("map");
+    const int drawStage = profiler.stage("draw");
+    const int textStage = profiler.stage("text");
+    const int showStage = profiler.stage("show");
+    profiler.setTrace(&trace);
+
+    TIMESPAN shownTime = -1;
+    vector<string> lines;
+
+    cv::namedWindow("Test Runner", cv::WINDOW_AUTOSIZE);
+
+    while (true) {
+        {
+            StageTimer timer(profiler, stepStage);
+            if (!engine.step()) break;
+        }
+        for (const ProtocolEvent& event : engine.events()) printEvent(event);
+
+        // Draw each new color frame once
+        if (engine.hasDisplay() && engine.display().relativeTime != shownTime) {
+            const FrameBundle& frame = engine.display();
+            shownTime = frame.relativeTime;
+            cv::Mat colorMat(COLOR_HEIGHT, COLOR_WIDTH, CV_8UC4, frame.color->bgra.data());
+
+            // Tracked joints
+            if (frame.has(FrameStream_Body)) {
+                StageTimer mapTimer(profiler, mapStage);
+                jointMap.clear();
+                jointMap.addBodies(*frame.body);
+                jointMap.map(*source);
+                mapTimer.stop();
+
+                StageTimer drawTimer(profiler, drawStage);
+                for (int body = 0; body < BODY_COUNT; ++body) {
+                    for (int j = 0; j < JointType_Count; ++j) {
+                        int x, y;
+                        if (jointMap.pixel(body, static_cast<JointType>(j), COLOR_WIDTH, COLOR_HEIGHT, x, y)) {
+                            cv::circle(colorMat, cv::Point(x, y), 6, cv::Scalar(0, 255, 0), -1);
+                        }
+                    }
+                }
+            }
+
+            // Status of every running test
+            StageTimer textTimer(profiler, textStage);
+            lines.clear();
+            lines.push_back(string("Test: ") + TEST_NAMES[test] + "  (1 walk, 2 TUG, 3 one leg, 4 all)");
+            for (const TestProtocol* protocol : engine.protocols()) protocol->status(frame.relativeTime, lines);
+            for (size_t i = 0; i < lines.size(); ++i) {
+                cv::putText(colorMat, lines[i], cv::Point(50, 50 + 40 * static_cast<int>(i)),
+                    cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
+            }
+            textTimer.stop();
+
+            StageTimer showTimer(profiler, showStage);
+            cv::imshow("Test Runner", colorMat);
+        }
+
+        int key = cv::waitKey(10);
+        if (key == 27) break;
+        if (key == 'p' || key == 'P') profiler.report(cout);
+        if (key >= '1' && key <= '4' && key - '1' != test) {
+            test = key - '1';
+            selectTest(engine, protocols, test);
+        }
+    }
+
+    cout << "Frames processed: " << engine.frames() << endl;
+    profiler.report(cout);
+    for (const TestProtocol* protocol : protocols) {
+        ProtocolResult result = protocol->result();
+        cout << protocol->name() << ": " << (result.complete ? result.summary : string("no result")) << endl;
+    }
+
+    cv::destroyAllWindows();
+    return 0;
+}
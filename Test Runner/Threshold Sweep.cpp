@@ -0,0 +1,241 @@
+// Tunes the test thresholds against labelled recordings
+// (Common/ParameterSweep.h). Every recording a label names is decoded once;
+// the parameter sets are then scored in parallel on a work-stealing pool,
+// all of them replaying the same decoded frames.
+//
+// Usage: "Threshold Sweep" <labels.csv> [--param name=min:max[:steps] ...] [--random N] [--seed S]
+//                          [--jobs N] [--out sweep.csv]
+//
+// With --param ranges alone the sweep tries the full grid (5 steps per
+// parameter unless given); with --random it tries N points drawn uniformly
+// from the ranges instead. Parameters not named keep their defaults, and the
+// default set is always scored first as the baseline. The Pareto front of
+// error against latency is printed; --out writes every set scored. Label
+// paths are taken relative to the labels file when they do not exist as
+// given. Run with --list to see the parameter names and defaults.
+#include "../Common/ParameterSweep.h"
+#include "../Common/WorkStealingPool.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const size_t MAX_SETS = 1000000;
+
+struct Range {
+    const SweepParameter* parameter;
+    float min, max;
+    int steps;
+};
+
+bool parseRange(const string& spec, Range& range) {
+    size_t equals = spec.find('=');
+    if (equals == string::npos) return false;
+    range.parameter = findSweepParameter(spec.substr(0, equals));
+    if (!range.parameter) return false;
+    range.steps = 5;
+    char* end = nullptr;
+    const char* text = spec.c_str() + equals + 1;
+    range.min = strtof(text, &end);
+    if (end == text || *end != ':') return false;
+    text = end + 1;
+    range.max = strtof(text, &end);
+    if (end == text || (*end != ':' && *end != '\0')) return false;
+    if (*end == ':') range.steps = atoi(end + 1);
+    return range.steps >= 1 && range.max >= range.min;
+}
+
+string resolveRecording(const string& recording, const string& labelsPath) {
+    error_code error;
+    if (filesystem::exists(recording, error)) return recording;
+    filesystem::path relative = filesystem::path(labelsPath).parent_path() / recording;
+    return filesystem::exists(relative, error) ? relative.string() : recording;
+}
+
+int main(int argc, char** argv) {
+    string labelsPath, outPath;
+    vector<Range> ranges;
+    size_t randomSets = 0;
+    unsigned seed = 1, jobs = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--list") {
+            SweepParams defaults;
+            for (const SweepParameter& parameter : SWEEP_PARAMETERS) {
+                cout << left << setw(22) << parameter.name << parameter.field(defaults) << "\n";
+            }
+            return 0;
+        }
+        if (arg == "--param" && hasValue) {
+            Range range;
+            if (!parseRange(argv[++i], range)) {
+                cerr << "Bad --param " << argv[i] << ", expected name=min:max[:steps] (see --list)" << endl;
+                return -1;
+            }
+            ranges.push_back(range);
+        }
+        else if (arg == "--random" && hasValue) randomSets = static_cast<size_t>(atol(argv[++i]));
+        else if (arg == "--seed" && hasValue) seed = static_cast<unsigned>(atoi(argv[++i]));
+        else if (arg == "--jobs" && hasValue) jobs = static_cast<unsigned>(max(1, atoi(argv[++i])));
+        else if (arg == "--out" && hasValue) outPath = argv[++i];
+        else if (labelsPath.empty()) labelsPath = arg;
+        else {
+            cerr << "Unknown argument: " << arg << endl;
+            return -1;
+        }
+    }
+    if (labelsPath.empty()) {
+        cerr << "Usage: " << argv[0] << " <labels.csv> [--param name=min:max[:steps] ...] [--random N] [--seed S] [--jobs N] [--out sweep.csv] [--list]" << endl;
+        return -1;
+    }
+
+    vector<SweepLabel> labels;
+    string error;
+    if (!readSweepLabels(labelsPath, labels, error)) {
+        cerr << error << endl;
+        return -1;
+    }
+    if (labels.empty()) {
+        cerr << "No labels in " << labelsPath << endl;
+        return -1;
+    }
+
+    // The parameter sets: the defaults, then the grid or the random draws
+    vector<SweepParams> sets(1);
+    if (randomSets > 0) {
+        mt19937 random(seed);
+        for (size_t n = 0; n < randomSets && n < MAX_SETS; ++n) {
+            SweepParams params;
+            for (const Range& range : ranges) {
+                range.parameter->field(params) = uniform_real_distribution<float>(range.min, range.max)(random);
+            }
+            sets.push_back(params);
+        }
+    } else if (!ranges.empty()) {
+        size_t count = 1;
+        for (const Range& range : ranges) {
+            count *= range.steps;
+            if (count > MAX_SETS) {
+                cerr << "The grid has more than " << MAX_SETS << " points; use fewer steps or --random" << endl;
+                return -1;
+            }
+        }
+        for (size_t n = 0; n < count; ++n) {
+            SweepParams params;
+            size_t index = n;
+            for (const Range& range : ranges) {
+                int step = static_cast<int>(index % range.steps);
+                index /= range.steps;
+                range.parameter->field(params) = range.steps == 1 ? range.min : range.min + (range.max - range.min) * step / (range.steps - 1);
+            }
+            sets.push_back(params);
+        }
+    }
+
+    // Labels grouped by recording, and the tests each recording needs
+    vector<string> recordings;
+    vector<vector<const SweepLabel*>> recordingLabels;
+    vector<unsigned> recordingTests;
+    for (const SweepLabel& label : labels) {
+        string path = resolveRecording(label.recording, labelsPath);
+        size_t r = find(recordings.begin(), recordings.end(), path) - recordings.begin();
+        if (r == recordings.size()) {
+            recordings.push_back(path);
+            recordingLabels.emplace_back();
+            recordingTests.push_back(0);
+        }
+        recordingLabels[r].push_back(&label);
+        recordingTests[r] |= sweepTestOf(label.test);
+    }
+
+    auto wallStart = chrono::steady_clock::now();
+    WorkStealingPool pool(jobs);
+    mutex progressMutex;
+
+    // Decode each recording once
+    vector<DecodedSession> sessions(recordings.size());
+    vector<char> decoded(recordings.size(), 0);
+    for (size_t r = 0; r < recordings.size(); ++r) {
+        pool.submit([&, r] {
+            decoded[r] = sessions[r].decode(recordings[r]);
+            lock_guard<mutex> lock(progressMutex);
+            if (decoded[r]) cerr << recordings[r] << ": " << sessions[r].frames().size() << " frames" << endl;
+            else cerr << "Failed to open recorded session: " << recordings[r] << endl;
+        });
+    }
+    pool.wait();
+    for (char ok : decoded) {
+        if (!ok) return -1;
+    }
+    double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+
+    // Score every set over every recording
+    vector<SweepScore> scores(sets.size());
+    for (size_t s = 0; s < sets.size(); ++s) {
+        pool.submit([&, s] {
+            double errorSum = 0.0, latencySum = 0.0;
+            for (size_t r = 0; r < sessions.size(); ++r) {
+                scoreSweepSession(playSession(sessions[r], sets[s], recordingTests[r]), recordingLabels[r], scores[s], errorSum, latencySum);
+            }
+            finishSweepScore(scores[s], labels.size(), errorSum, latencySum);
+        });
+    }
+    pool.wait();
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+
+    // Columns: the parameters that were swept, all of them when none were
+    vector<const SweepParameter*> columns;
+    for (const Range& range : ranges) {
+        if (find(columns.begin(), columns.end(), range.parameter) == columns.end()) columns.push_back(range.parameter);
+    }
+    if (columns.empty()) {
+        for (const SweepParameter& parameter : SWEEP_PARAMETERS) columns.push_back(&parameter);
+    }
+
+    vector<size_t> front = paretoFront(scores);
+    set<size_t> onFront(front.begin(), front.end());
+
+    if (!outPath.empty()) {
+        ofstream out(outPath);
+        if (!out) {
+            cerr << "Failed to open " << outPath << " for writing" << endl;
+            return -1;
+        }
+        out << "set";
+        for (const SweepParameter* column : columns) out << "," << column->name;
+        out << ",error_s,latency_s,matched,missed,false_passes,pareto\n";
+        for (size_t s = 0; s < sets.size(); ++s) {
+            out << s;
+            for (const SweepParameter* column : columns) out << "," << column->field(sets[s]);
+            out << "," << scores[s].error << "," << scores[s].latency << "," << scores[s].matched << ","
+                << scores[s].missed << "," << scores[s].falsePasses << "," << (onFront.count(s) ? 1 : 0) << "\n";
+        }
+    }
+
+    auto printRow = [&](size_t s) {
+        cout << setw(6) << s;
+        for (const SweepParameter* column : columns) cout << setw(20) << column->field(sets[s]);
+        cout << setw(10) << scores[s].error << setw(10) << scores[s].latency << setw(8) << scores[s].matched
+             << setw(8) << scores[s].missed << setw(8) << scores[s].falsePasses << "\n";
+    };
+    cout << fixed << setprecision(3) << setw(6) << "set";
+    for (const SweepParameter* column : columns) cout << setw(20) << column->name;
+    cout << setw(10) << "error s" << setw(10) << "latency s" << setw(8) << "matched" << setw(8) << "missed" << setw(8) << "false" << "\n";
+    cout << "baseline\n";
+    printRow(0);
+    cout << "Pareto front\n";
+    for (size_t s : front) printRow(s);
+
+    cerr << sets.size() << " parameter sets x " << recordings.size() << " recordings in " << wallSeconds
+         << " s (decoding " << decodeSeconds << " s) on " << pool.size() << (pool.size() == 1 ? " worker" : " workers") << endl;
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Checks that FrameSynchronizer::poll(FrameCapture&) hands out a capture
+// backlog in full: more depth and body index frames are queued in the
+// capture rings than the synchronizer's pending queues hold, and every one
+// must come out as a complete bundle, in order, with nothing evicted.
+// It also destroys a synchronizer with bundles still pending in the frames
+// it pooled itself, as when TUG V1 or the Test Runner quit mid-run; build
+// with -fsanitize=address to catch a use after free.
+//
+// Usage: "Frame Synchronizer Test"
+// Returns 0 when every check passes.
+#include "../Common/FrameCapture.h"
+#include "../Common/FrameSynchronizer.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+const int BACKLOG = 20; // frames per stream, well over PendingFrames::CAPACITY
+const TIMESPAN FRAME_TICKS = TICKS_PER_SECOND / 30;
+
+// Hands out BACKLOG depth and body index frames as fast as they are read
+class BacklogSource : public FrameSource {
+public:
+    HRESULT AcquireLatestDepthFrame(DepthFrameData& frame) override {
+        if (depth_ == BACKLOG) return E_PENDING;
+        frame.relativeTime = FRAME_TICKS * ++depth_;
+        return S_OK;
+    }
+    HRESULT AcquireLatestBodyIndexFrame(BodyIndexFrameData& frame) override {
+        if (bodyIndex_ == BACKLOG) return E_PENDING;
+        frame.relativeTime = FRAME_TICKS * ++bodyIndex_;
+        return S_OK;
+    }
+    HRESULT AcquireLatestBodyFrame(BodyFrameData&) override { return E_PENDING; }
+    HRESULT AcquireLatestColorFrame(ColorFrameData&) override { return E_PENDING; }
+    HRESULT MapCameraPointsToColorSpace(UINT, const CameraSpacePoint*, UINT, ColorSpacePoint*) override { return E_INVALIDARG; }
+    bool IsFinished() const override { return depth_ == BACKLOG && bodyIndex_ == BACKLOG; }
+
+private:
+    int depth_ = 0;
+    int bodyIndex_ = 0;
+};
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        cerr << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+int main() {
+    const UINT streams = FrameStream_Depth | FrameStream_BodyIndex;
+    BacklogSource source;
+    FrameCapture capture(source);
+    capture.start(streams);
+    while (!capture.sourceFinished()) this_thread::sleep_for(chrono::milliseconds(1));
+    capture.stop();
+    check(capture.depth().dropped() == 0 && capture.bodyIndex().dropped() == 0, "the capture rings hold the whole backlog");
+
+    // The analytics loop of Walking Speed Test V3
+    FrameSynchronizer sync(streams, FrameStream_Depth, MissingStream_Partial);
+    FrameBundle bundle;
+    int bundles = 0;
+    bool inOrder = true, complete = true;
+    for (;;) {
+        bool finished = capture.depth().empty() && capture.bodyIndex().empty();
+        if (finished) sync.flush();
+        sync.poll(capture);
+        bool popped = false;
+        while (sync.pop(bundle)) {
+            popped = true;
+            ++bundles;
+            if (bundle.relativeTime != FRAME_TICKS * bundles) inOrder = false;
+            if (!bundle.has(FrameStream_Depth) || !bundle.has(FrameStream_BodyIndex)) complete = false;
+        }
+        if (!popped && finished) break;
+    }
+
+    check(bundles == BACKLOG, "every queued depth frame comes out as a bundle");
+    check(inOrder, "bundles come out in capture order");
+    check(complete, "every bundle pairs its depth and body index frames");
+    check(sync.stats(FrameStream_Depth).unmatched == 0, "no depth frame is evicted");
+    check(sync.stats(FrameStream_BodyIndex).unmatched == 0, "no body index frame is evicted");
+
+    cout << bundles << " of " << BACKLOG << " frames bundled, "
+         << sync.stats(FrameStream_Depth).unmatched << " depth and "
+         << sync.stats(FrameStream_BodyIndex).unmatched << " body index frames unmatched" << endl;
+
+    // Destroyed with frames polled straight from a source still pending
+    {
+        BacklogSource direct;
+        FrameSynchronizer pending(streams, FrameStream_Depth, MissingStream_Partial);
+        for (int i = 0; i < 3; ++i) pending.poll(direct);
+        FrameBundle first;
+        check(pending.pop(first), "a bundle is ready before the synchronizer is destroyed");
+    }
+
+    if (failures) return -1;
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -1,4 +1,11 @@
-#include <Kinect.h>
+#include "../Common/KinectFrameSource.h"
+#include "../Common/FrameClock.h"
+#include "../Common/FrameSynchronizer.h"
+#include "../Common/JointSmoothing.h"
+#include "../Common/JointColorMap.h"
+#include "../Common/BodySessions.h"
+#include "../Common/SkeletonTopology.h"
+#include "../Common/AsyncLogger.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <chrono>
@@ -6,33 +13,10 @@
 #include <numeric>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
 
 using namespace std;
 
-// Skeleton bones definition
-const std::vector<std::pair<JointType, JointType>> bones = {
-    { JointType_Head, JointType_Neck },
-    { JointType_Neck, JointType_SpineShoulder },
-    { JointType_SpineShoulder, JointType_SpineMid },
-    { JointType_SpineMid, JointType_SpineBase },
-    { JointType_SpineShoulder, JointType_ShoulderLeft },
-    { JointType_SpineShoulder, JointType_ShoulderRight },
-    { JointType_SpineBase, JointType_HipLeft },
-    { JointType_SpineBase, JointType_HipRight },
-    { JointType_ShoulderLeft, JointType_ElbowLeft },
-    { JointType_ElbowLeft, JointType_WristLeft },
-    { JointType_WristLeft, JointType_HandLeft },
-    { JointType_ShoulderRight, JointType_ElbowRight },
-    { JointType_ElbowRight, JointType_WristRight },
-    { JointType_WristRight, JointType_HandRight },
-    { JointType_HipLeft, JointType_KneeLeft },
-    { JointType_KneeLeft, JointType_AnkleLeft },
-    { JointType_AnkleLeft, JointType_FootLeft },
-    { JointType_HipRight, JointType_KneeRight },
-    { JointType_KneeRight, JointType_AnkleRight },
-    { JointType_AnkleRight, JointType_FootRight }
-};
-
 // Constants
 const float CHAIR_DEPTH = 4.0f;        // Depth when sitting on the chair
 const float TARGET_DEPTH = 1.0f;      // Target depth during walking
@@ -40,197 +24,221 @@ const float Y_CHANGE_THRESHOLD = 0.1f; // Threshold for Y-coordinate change
 const float DEPTH_TOLERANCE = 0.1f;   // Allowable error in depth comparison
 const float Y_COORD_TOLERANCE = 0.05f; // Allowable error in Y-coordinate comparison
 
-// Timer variables
-bool isTiming = false;
-bool reachedTargetDepth = false;
-std::chrono::steady_clock::time_point startTime;
-std::chrono::steady_clock::time_point endTime;
+// Concurrent: everyone in view runs their own test. SessionMode_SubjectLock
+// tests only the first person tracked.
+const SessionMode SESSION_MODE = SessionMode_Concurrent;
+
+// Test events are written to the console by a background thread, so the
+// frame loop never waits on it
+AsyncLogger logger;
+LogChannel testLog(logger, "test");
+
+// Test state of one person, kept per TrackingId
+struct TugSession {
+    FrameTimer timer; // on the sensor clock
+    bool reachedTargetDepth = false;
 
-// Initial Y-coordinate for validation
-float initialYCoordinate = -1.0f;
+    // Previous SpineMid sample, for sub-frame event times
+    TIMESPAN previousFrameTime = 0;
+    float previousDepth = 0.0f;
+    float previousYCoordinate = 0.0f;
+
+    // Initial Y-coordinate for validation
+    float initialYCoordinate = -1.0f;
+};
 
 // Timer functions
-void startTimer(float depth, float yCoordinate) {
-    isTiming = true;
-    reachedTargetDepth = false; // Reset target depth tracking
-    startTime = std::chrono::steady_clock::now();
-    cout << "Timer started! Depth: " << depth << "m, Y-coordinate: " << yCoordinate << endl;
+void startTimer(TugSession& session, int slot, float depth, float yCoordinate, TIMESPAN time) {
+    session.timer.start(time);
+    session.reachedTargetDepth = false; // Reset target depth tracking
+    testLog.info() << "Body " << slot << ": Timer started! Depth: " << depth << "m, Y-coordinate: " << yCoordinate;
 }
 
-void stopTimer(float depth, float yCoordinate) {
-    endTime = std::chrono::steady_clock::now();
-    isTiming = false;
-
-    auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-    float elapsedSeconds = elapsedTime / 1000.0f;
+void stopTimer(TugSession& session, int slot, float depth, float yCoordinate, TIMESPAN time) {
+    double elapsedSeconds = session.timer.stop(time);
 
-    cout << "Timer stopped! Depth: " << depth << "m, Y-coordinate: " << yCoordinate << endl;
-    cout << "Total time taken: " << fixed << setprecision(2) << elapsedSeconds << " seconds" << endl;
+    testLog.info() << "Body " << slot << ": Timer stopped! Depth: " << depth << "m, Y-coordinate: " << yCoordinate;
+    testLog.info() << "Body " << slot << ": Total time taken: " << logFixed(elapsedSeconds, 2) << " seconds";
 
     // Reset for the next test
-    initialYCoordinate = -1.0f;
+    session.initialYCoordinate = -1.0f;
 }
 
-// Process walking test logic
-void processWalkingTest(float depth, float yCoordinate) {
-    if (initialYCoordinate == -1.0f && fabs(depth - CHAIR_DEPTH) < DEPTH_TOLERANCE) {
-        initialYCoordinate = yCoordinate; // Save initial Y-coordinate
-        cout << "Person detected sitting on the chair. Depth: " << depth << "m" << endl;
+// Process walking test logic for one SpineMid sample captured at `frameTime`
+void processWalkingTest(TugSession& session, int slot, float depth, float yCoordinate, TIMESPAN frameTime) {
+    // Previous sample (this one if there is none yet)
+    TIMESPAN lastTime = session.previousFrameTime ? session.previousFrameTime : frameTime;
+    float lastDepth = session.previousFrameTime ? session.previousDepth : depth;
+    float lastYCoordinate = session.previousFrameTime ? session.previousYCoordinate : yCoordinate;
+    session.previousFrameTime = frameTime;
+    session.previousDepth = depth;
+    session.previousYCoordinate = yCoordinate;
+
+    if (session.initialYCoordinate == -1.0f && fabs(depth - CHAIR_DEPTH) < DEPTH_TOLERANCE) {
+        session.initialYCoordinate = yCoordinate; // Save initial Y-coordinate
+        testLog.info() << "Body " << slot << ": Person detected sitting on the chair. Depth: " << depth << "m";
         return;
     }
 
     // Start timer when Y-coordinate changes (person is getting up)
-    if (!isTiming && fabs(yCoordinate - initialYCoordinate) > Y_CHANGE_THRESHOLD) {
-        startTimer(depth, yCoordinate);
+    float yChange = fabs(yCoordinate - session.initialYCoordinate);
+    float lastYChange = fabs(lastYCoordinate - session.initialYCoordinate);
+    if (!session.timer.isRunning() && yChange > Y_CHANGE_THRESHOLD) {
+        startTimer(session, slot, depth, yCoordinate, crossingTime(lastTime, lastYChange, frameTime, yChange, Y_CHANGE_THRESHOLD));
     }
 
     // During timing, check for target depth (1 meter)
-    if (isTiming && fabs(depth - TARGET_DEPTH) < DEPTH_TOLERANCE) {
-        reachedTargetDepth = true;
-        cout << "Target depth reached: " << depth << "m" << endl;
+    if (session.timer.isRunning() && fabs(depth - TARGET_DEPTH) < DEPTH_TOLERANCE) {
+        session.reachedTargetDepth = true;
+        testLog.info() << "Body " << slot << ": Target depth reached: " << depth << "m";
     }
 
     // Stop timer when person returns to chair depth and initial Y-coordinate
-    if (isTiming && reachedTargetDepth &&
+    if (session.timer.isRunning() && session.reachedTargetDepth &&
         fabs(depth - CHAIR_DEPTH) < DEPTH_TOLERANCE &&
-        fabs(yCoordinate - initialYCoordinate) < Y_COORD_TOLERANCE) {
-        stopTimer(depth, yCoordinate);
+        yChange < Y_COORD_TOLERANCE) {
+        // Seated once the later of the two conditions held
+        TIMESPAN seatedTime = std::max(
+            belowOnsetTime(lastTime, fabs(lastDepth - CHAIR_DEPTH), frameTime, fabs(depth - CHAIR_DEPTH), DEPTH_TOLERANCE),
+            belowOnsetTime(lastTime, lastYChange, frameTime, yChange, Y_COORD_TOLERANCE));
+        stopTimer(session, slot, depth, yCoordinate, seatedTime);
     }
 }
 
 // Main program
-int main() {
-    IKinectSensor* sensor = nullptr;
-    IColorFrameReader* colorFrameReader = nullptr;
-    IBodyFrameReader* bodyFrameReader = nullptr;
-    ICoordinateMapper* coordinateMapper = nullptr;
-
-    if (FAILED(GetDefaultKinectSensor(&sensor)) || !sensor) {
-        cerr << "Kinect sensor not found!" << endl;
+// Usage: "Time Up and Go Test V1" [recording.ksession]
+// Without an argument the live Kinect is used.
+int main(int argc, char** argv) {
+    std::string replayPath = argc > 1 ? argv[1] : "";
+    std::unique_ptr<FrameSource> source = openFrameSource(replayPath, FrameStream_Body | FrameStream_Color, 1.0);
+    if (!source) {
         return -1;
     }
 
-    sensor->Open();
-    sensor->get_CoordinateMapper(&coordinateMapper);
+    // Every body frame drives the test; a color frame captured within one
+    // color frame interval is paired with it for drawing
+    FrameSynchronizer sync(FrameStream_Body | FrameStream_Color, FrameStream_Body, MissingStream_Partial);
+    FrameBundle bundle;
 
-    IColorFrameSource* colorSource = nullptr;
-    sensor->get_ColorFrameSource(&colorSource);
-    colorSource->OpenReader(&colorFrameReader);
+    // One Euro smoothing of SpineMid: damps jitter at rest without the two
+    // frames of lag a moving average adds to the stand-up crossing
+    JointSmoother smoother(SmoothingFilter_None);
+    smoother.setFilter(JointType_SpineMid, SmoothingFilter_OneEuro);
 
-    IBodyFrameSource* bodySource = nullptr;
-    sensor->get_BodyFrameSource(&bodySource);
-    bodySource->OpenReader(&bodyFrameReader);
+    // One test per person in view
+    BodySessions<TugSession> sessions(SESSION_MODE);
+
+    // Color pixels of the tracked joints, mapped once per bundle
+    JointColorMap jointMap;
+    int width = COLOR_WIDTH, height = COLOR_HEIGHT;
 
     cv::namedWindow("Kinect Walking Test", cv::WINDOW_AUTOSIZE);
 
-    while (true) {
-        IColorFrame* colorFrame = nullptr;
-        HRESULT hrColor = colorFrameReader->AcquireLatestFrame(&colorFrame);
-
-        if (SUCCEEDED(hrColor)) {
-            IFrameDescription* frameDescription = nullptr;
-            colorFrame->get_FrameDescription(&frameDescription);
-
-            int width, height;
-            frameDescription->get_Width(&width);
-            frameDescription->get_Height(&height);
-
-            UINT bufferSize = width * height * 4;
-            BYTE* colorBuffer = new BYTE[bufferSize];
-            hrColor = colorFrame->CopyConvertedFrameDataToArray(bufferSize, colorBuffer, ColorImageFormat_Bgra);
-
-            if (SUCCEEDED(hrColor)) {
-                cv::Mat colorMat(height, width, CV_8UC4, colorBuffer);
-                cv::Mat bgrMat;
-                cv::cvtColor(colorMat, bgrMat, cv::COLOR_BGRA2BGR);
-
-                IBodyFrame* bodyFrame = nullptr;
-                HRESULT hrBody = bodyFrameReader->AcquireLatestFrame(&bodyFrame);
-
-                if (SUCCEEDED(hrBody)) {
-                    IBody* bodies[BODY_COUNT] = { 0 };
-                    hrBody = bodyFrame->GetAndRefreshBodyData(_countof(bodies), bodies);
-
-                    for (int i = 0; i < BODY_COUNT; ++i) {
-                        IBody* body = bodies[i];
-                        if (body) {
-                            BOOLEAN isTracked = false;
-                            body->get_IsTracked(&isTracked);
-
-                            if (isTracked) {
-                                Joint joints[JointType_Count];
-                                body->GetJoints(_countof(joints), joints);
-
-                                // Draw skeleton
-                                for (const auto& bone : bones) {
-                                    Joint joint1 = joints[bone.first];
-                                    Joint joint2 = joints[bone.second];
-
-                                    if (joint1.TrackingState == TrackingState_Tracked && joint2.TrackingState == TrackingState_Tracked) {
-                                        ColorSpacePoint colorPoint1, colorPoint2;
-                                        coordinateMapper->MapCameraPointToColorSpace(joint1.Position, &colorPoint1);
-                                        coordinateMapper->MapCameraPointToColorSpace(joint2.Position, &colorPoint2);
-
-                                        int x1 = static_cast<int>(colorPoint1.X);
-                                        int y1 = static_cast<int>(colorPoint1.Y);
-                                        int x2 = static_cast<int>(colorPoint2.X);
-                                        int y2 = static_cast<int>(colorPoint2.Y);
-
-                                        if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height &&
-                                            x2 >= 0 && x2 < width && y2 >= 0 && y2 < height) {
-                                            cv::line(bgrMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 2);
-                                        }
-                                    }
-                                }
+    bool userQuit = false;
+    while (!userQuit) {
+        // Checked before polling: frames read by this poll must still be popped
+        bool finished = source->IsFinished();
+        if (finished) {
+            sync.flush();
+        }
+        sync.poll(*source);
+
+        bool popped = false;
+        while (sync.pop(bundle)) {
+            popped = true;
+            const BodyFrameData& bodyFrame = *bundle.body;
+            smoother.beginFrame(bundle.relativeTime);
+            smoother.addBodies(bodyFrame);
+            smoother.endFrame();
+            bool hasColor = bundle.has(FrameStream_Color);
+            cv::Mat colorMat;
+            if (hasColor) {
+                colorMat = cv::Mat(height, width, CV_8UC4, bundle.color->bgra.data());
+                jointMap.clear();
+                jointMap.addBodies<JointGroup_Body>(bodyFrame);
+                jointMap.map(*source);
+            }
+
+            sessions.beginFrame();
+
+            for (int i = 0; i < BODY_COUNT; ++i) {
+                const BodyData& body = bodyFrame.bodies[i];
 
-                                // Process SpineMid joint
-                                Joint spineMid = joints[JointType_SpineMid];
-                                if (spineMid.TrackingState == TrackingState_Tracked) {
-                                    float depth = spineMid.Position.Z;
-                                    float yCoordinate = spineMid.Position.Y;
-
-                                    // Display depth and Y-coordinate
-                                    ColorSpacePoint spineMidPoint;
-                                    coordinateMapper->MapCameraPointToColorSpace(spineMid.Position, &spineMidPoint);
-
-                                    int x = static_cast<int>(spineMidPoint.X);
-                                    int y = static_cast<int>(spineMidPoint.Y);
-
-                                    if (x >= 0 && x < width && y >= 0 && y < height) {
-                                        cv::putText(bgrMat, "Depth: " + to_string(depth) + "m",
-                                            cv::Point(x, y - 40), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                                            cv::Scalar(0, 0, 255), 2);
-                                        cv::putText(bgrMat, "Y: " + to_string(yCoordinate) + "m",
-                                            cv::Point(x, y - 20), cv::FONT_HERSHEY_SIMPLEX, 0.6,
-                                            cv::Scalar(0, 255, 0), 2);
-                                    }
-
-                                    // Process walking test logic
-                                    processWalkingTest(depth, yCoordinate);
+                if (body.isTracked) {
+                    const Joint* joints = body.joints;
+
+                    // Draw skeleton on the paired color frame
+                    if (hasColor) {
+                        forEachBone<JointGroup_Body>([&](const Bone& bone) {
+                            if (joints[bone.parent].TrackingState == TrackingState_Tracked && joints[bone.child].TrackingState == TrackingState_Tracked) {
+                                int x1, y1, x2, y2;
+                                if (jointMap.pixel(i, bone.parent, width, height, x1, y1) &&
+                                    jointMap.pixel(i, bone.child, width, height, x2, y2)) {
+                                    cv::line(colorMat, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 255, 0), 2);
                                 }
                             }
-                        }
+                        });
                     }
 
-                    bodyFrame->Release();
-                }
+                    // Process SpineMid joint, smoothed, if this person is under test
+                    int slot = sessions.bind(body.trackingId);
+                    Joint spineMid = joints[JointType_SpineMid];
+                    CameraSpacePoint spineMidPosition;
+                    if (slot >= 0 && spineMid.TrackingState == TrackingState_Tracked &&
+                        smoother.smoothed(smoother.slotOf(body.trackingId), JointType_SpineMid, spineMidPosition)) {
+                        float depth = spineMidPosition.Z;
+                        float yCoordinate = spineMidPosition.Y;
+
+                        // Display depth and Y-coordinate
+                        if (hasColor) {
+                            int x, y;
+                            if (jointMap.pixel(i, JointType_SpineMid, width, height, x, y)) {
+                                cv::putText(colorMat, "Depth: " + to_string(depth) + "m",
+                                    cv::Point(x, y - 40), cv::FONT_HERSHEY_SIMPLEX, 0.6,
+                                    cv::Scalar(0, 0, 255), 2);
+                                cv::putText(colorMat, "Y: " + to_string(yCoordinate) + "m",
+                                    cv::Point(x, y - 20), cv::FONT_HERSHEY_SIMPLEX, 0.6,
+                                    cv::Scalar(0, 255, 0), 2);
+                            }
+                        }
 
-                cv::imshow("Kinect Walking Test", bgrMat);
+                        // Process walking test logic
+                        processWalkingTest(sessions.state(slot), slot, depth, yCoordinate, bundle.relativeTime);
+                    }
+                }
             }
 
-            delete[] colorBuffer;
+            // People who left the view take their test with them
+            sessions.endFrame([](int slot, TugSession& session) {
+                if (session.timer.isRunning()) testLog.info() << "Body " << slot << ": Lost during the test, timer discarded";
+            });
+
+            if (hasColor) {
+                cv::imshow("Kinect Walking Test", colorMat);
+            }
         }
 
-        if (colorFrame) {
-            colorFrame->Release();
+        if (!popped && finished) {
+            break;
         }
 
         if (cv::waitKey(30) == 27) {
-            break;
+            userQuit = true;
         }
     }
 
-    sensor->Close();
+    // Test events first, then the run summary
+    logger.flush();
+    const SyncStreamStats& colorStats = sync.stats(FrameStream_Color);
+    cout << "Bundles: " << sync.bundles() << " (" << sync.partialBundles() << " without color)" << endl;
+    cout << "Color frames matched: " << colorStats.matched << ", unmatched: " << colorStats.unmatched
+         << ", mean skew: " << fixed << setprecision(2) << colorStats.meanSkewMs() << " ms" << endl;
+    cout << "Pairing latency: mean " << sync.meanPairingLatencyMs() << " ms, max "
+         << sync.maxPairingLatencyMs() << " ms" << endl;
+
+    cout << "Sessions: " << sessions.slots().bound() << " started, "
+         << sessions.slots().rejected() << " bodies over capacity" << endl;
+
     cv::destroyAllWindows();
     return 0;
 }
@@ -0,0 +1,87 @@
+// Records depth, body index and body streams (and optionally color) from the
+// Kinect into a .ksession file that every test program can replay offline.
+//
+// Usage: "Session Recorder" <output.ksession> [--color]
+#include "../Common/KinectFrameSource.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output.ksession> [--color]" << std::endl;
+        return -1;
+    }
+
+    std::string outputPath = argv[1];
+    bool recordColor = argc > 2 && std::string(argv[2]) == "--color";
+
+    UINT streams = FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body;
+    if (recordColor) streams |= FrameStream_Color;
+
+    std::unique_ptr<FrameSource> source = openFrameSource("", streams);
+    if (!source) return -1;
+
+    SessionWriter writer;
+    if (!writer.open(outputPath, streams)) {
+        std::cerr << "Failed to create session file: " << outputPath << std::endl;
+        return -1;
+    }
+
+    DepthFrameData depthFrame;
+    BodyIndexFrameData bodyIndexFrame;
+    BodyFrameData bodyFrame;
+    ColorFrameData colorFrame;
+    size_t depthFrames = 0;
+
+    cv::namedWindow("Session Recorder", cv::WINDOW_AUTOSIZE);
+
+    while (true) {
+        bool writeOk = true;
+        bool newDepth = SUCCEEDED(source->AcquireLatestDepthFrame(depthFrame));
+
+        if (newDepth) {
+            writeOk = writer.writeDepthFrame(depthFrame) && writeOk;
+            ++depthFrames;
+        }
+        if (SUCCEEDED(source->AcquireLatestBodyIndexFrame(bodyIndexFrame))) {
+            writeOk = writer.writeBodyIndexFrame(bodyIndexFrame) && writeOk;
+        }
+        if (SUCCEEDED(source->AcquireLatestBodyFrame(bodyFrame))) {
+            writeOk = writer.writeBodyFrame(bodyFrame) && writeOk;
+        }
+
+        bool newColor = recordColor && SUCCEEDED(source->AcquireLatestColorFrame(colorFrame));
+        if (newColor) {
+            writeOk = writer.writeColorFrame(colorFrame) && writeOk;
+        }
+
+        if (!writeOk) {
+            std::cerr << "Write failed, disk full? Stopping recording." << std::endl;
+            break;
+        }
+
+        // Preview what is being recorded
+        if (newColor) {
+            cv::Mat colorMat(COLOR_HEIGHT, COLOR_WIDTH, CV_8UC4, colorFrame.bgra.data());
+            cv::putText(colorMat, "REC " + std::to_string(depthFrames), cv::Point(50, 50),
+                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 2);
+            cv::imshow("Session Recorder", colorMat);
+        }
+        else if (!recordColor && newDepth) {
+            cv::Mat depthMat(DEPTH_HEIGHT, DEPTH_WIDTH, CV_16UC1, depthFrame.pixels.data());
+            cv::Mat depth8;
+            depthMat.convertTo(depth8, CV_8U, 255.0 / 8000.0);
+            cv::imshow("Session Recorder", depth8);
+        }
+
+        if (cv::waitKey(1) == 27) break; // Stop recording on ESC key
+    }
+
+    if (!writer.close()) {
+        std::cerr << "Failed to finish session file or its index: " << outputPath << std::endl;
+        return -1;
+    }
+    std::cout << "Recorded " << depthFrames << " depth frames to " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Writes a .ksession of synthetic subjects (Common/SyntheticMotion.h) for
+// replaying through the tests without a sensor or a patient, e.g. a
+// six-person Timed Up and Go at 60 fps to load the engine.
+//
+// Usage: "Synthetic Session" <output.ksession> [walk|tug|one-leg|all] [--bodies N] [--fps F] [--speed M/S] [--seed S] [--body-only]
+//
+// walk, tug and one-leg give every body that motion, side by side with
+// staggered starts. all puts a one-leg stand, a walk and a TUG next to each
+// other (more bodies stand and sway). The walker is the one in front of
+// the sensor, where the walking test measures its distance.
+#include "../Common/SyntheticMotion.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Sideways positions, centre first
+const float LANES[BODY_COUNT] = { 0.0f, -0.8f, 0.8f, -1.6f, 1.6f, -2.4f };
+
+int main(int argc, char** argv) {
+    // An option in place of the output path (--help, ...) would otherwise
+    // become the name of a file hundreds of MB long
+    if (argc < 2 || argv[1][0] == '-') {
+        cerr << "Usage: " << argv[0] << " <output.ksession> [walk|tug|one-leg|all] [--bodies N] [--fps F] [--speed M/S] [--seed S] [--body-only]" << endl;
+        return -1;
+    }
+
+    string outputPath = argv[1];
+    string test = "all";
+    int bodies = 0;
+    double fps = 30.0;
+    float speed = 1.2f;
+    unsigned seed = 1;
+    UINT streams = FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Body;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--bodies" && hasValue) bodies = atoi(argv[++i]);
+        else if (arg == "--fps" && hasValue) fps = atof(argv[++i]);
+        else if (arg == "--speed" && hasValue) speed = static_cast<float>(atof(argv[++i]));
+        else if (arg == "--seed" && hasValue) seed = static_cast<unsigned>(atoi(argv[++i]));
+        else if (arg == "--body-only") streams = FrameStream_Body;
+        else if (arg == "walk" || arg == "tug" || arg == "one-leg" || arg == "all") test = arg;
+        else {
+            cerr << "Unknown argument: " << arg << endl;
+            return -1;
+        }
+    }
+    if (bodies <= 0) bodies = test == "all" ? 3 : 1;
+    if (bodies > BODY_COUNT || fps <= 0.0 || speed <= 0.0f) {
+        cerr << "Need 1-" << BODY_COUNT << " bodies, a positive frame rate and a positive speed" << endl;
+        return -1;
+    }
+
+    SyntheticMotion motion(fps, seed);
+    for (int slot = 0; slot < bodies; ++slot) {
+        SyntheticActor actor;
+        actor.x = LANES[slot];
+        actor.speed = speed;
+        actor.delay = 1.0 + 0.5 * slot;
+        if (test == "walk") {
+            actor.motion = SyntheticMotion_Walk;
+            actor.distance = 6.5f;
+        } else if (test == "tug") {
+            actor.motion = SyntheticMotion_Tug;
+        } else if (test == "one-leg") {
+            actor.motion = SyntheticMotion_OneLegStand;
+            actor.distance = 2.5f;
+        } else if (slot == 0) {
+            // The one-leg stand tests the first body tracked
+            actor.motion = SyntheticMotion_OneLegStand;
+            actor.x = -1.0f;
+            actor.distance = 2.5f;
+        } else if (slot == 1) {
+            actor.motion = SyntheticMotion_Walk;
+            actor.x = 0.0f;
+            actor.distance = 6.5f;
+        } else if (slot == 2) {
+            actor.motion = SyntheticMotion_Tug;
+            actor.x = 1.0f;
+        } else {
+            actor.x = LANES[slot] < 0.0f ? LANES[slot] - 0.6f : LANES[slot] + 0.6f;
+            actor.distance = 5.0f;
+        }
+        motion.addActor(actor);
+    }
+
+    if (!motion.writeSession(outputPath, streams)) {
+        cerr << "Failed to write session file: " << outputPath << endl;
+        return -1;
+    }
+    cout << outputPath << ": " << motion.frameCount() << " frames, " << motion.seconds() << " s at " << fps
+         << " fps, " << bodies << (bodies == 1 ? " body" : " bodies") << endl;
+    return 0;
+}
@@ -1,63 +1,49 @@
 #include <iostream>
-#include <Kinect.h>
+#include "../Common/FrameSource.h"
+#include "../Common/FrameClock.h"
+#include "../Common/GateCrossing.h"
+#include "../Common/RingFilter.h"
+#include "../Common/DepthRoi.h"
+#include "../Common/AsyncLogger.h"
 #include <opencv2/opencv.hpp>
-#include <deque>
-#include <numeric>
 #include <chrono>
 #include <iomanip>
 
-#pragma comment(lib, "kinect20.lib")
+// Timer variables, on the sensor clock
+FrameTimer walkTimer;
 
-template<class Interface>
-inline void SafeRelease(Interface*& interfaceToRelease) {
-    if (interfaceToRelease) {
-        interfaceToRelease->Release();
-        interfaceToRelease = nullptr;
-    }
-}
-
-// Moving average filter
-float getSmoothedDepth(std::deque<float>& depthQueue, float newDepth, size_t windowSize) {
-    depthQueue.push_back(newDepth);
-    if (depthQueue.size() > windowSize) {
-        depthQueue.pop_front();
-    }
-    float sum = std::accumulate(depthQueue.begin(), depthQueue.end(), 0.0f);
-    return sum / depthQueue.size();
-}
+// Start and stop gates, metres from the sensor. The walking direction
+// follows from their order, so e.g. 3.0f -> 8.0f times a walk away.
+const float START_GATE_DISTANCE = 6.0f;
+const float STOP_GATE_DISTANCE = 1.0f;
+GateCrossing startGate(START_GATE_DISTANCE, gateDirection(START_GATE_DISTANCE, STOP_GATE_DISTANCE));
+GateCrossing stopGate(STOP_GATE_DISTANCE, gateDirection(START_GATE_DISTANCE, STOP_GATE_DISTANCE));
 
-// Timer variables
-bool isTiming = false;
-std::chrono::steady_clock::time_point startTime;
-std::chrono::steady_clock::time_point endTime;
-
-// Helper function to calculate the moving average of a deque
-float calculateMovingAverage(const std::deque<float>& values) {
-    if (values.empty()) return 0.0f;
-    float sum = std::accumulate(values.begin(), values.end(), 0.0f);
-    return sum / values.size();
-}
+// Timer events are written to the console by a background thread, so the
+// frame loop never waits on it
+AsyncLogger logger;
+LogChannel testLog(logger, "test");
 
 // Timer logic for walking test
-void processWalkingTest(float depth) {
-    // Check for start condition (depth between 5.98m and 6.0m)
-    if (!isTiming && depth >= 5.99f && depth <= 6.0f) {
-        isTiming = true;
-        startTime = std::chrono::steady_clock::now();
-        std::cout << "Timer started! Depth: " << depth << "m" << std::endl;
+void processWalkingTest(float depth, TIMESPAN frameTime) {
+    // Both gates see every sample, so each is armed before the subject reaches it
+    TIMESPAN startTime = 0, stopTime = 0;
+    bool started = startGate.update(frameTime, depth, startTime);
+    bool stopped = stopGate.update(frameTime, depth, stopTime);
+
+    // Subject passed the start gate
+    if (started && !walkTimer.isRunning()) {
+        walkTimer.start(startTime);
+        testLog.info() << "Timer started! Depth: " << depth << "m";
     }
 
-    // Check for stop condition (depth between 0.98m and 1.0m)
-    if (isTiming && depth >= 1.0f && depth <= 1.1f) {
-        endTime = std::chrono::steady_clock::now();
-        isTiming = false;
-
+    // Subject passed the stop gate
+    if (stopped && walkTimer.isRunning()) {
         // Calculate elapsed time
-        auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-        float elapsedSeconds = elapsedTime / 1000.0f;
+        float elapsedSeconds = static_cast<float>(walkTimer.stop(stopTime));
 
-        std::cout << "Timer stopped! Depth: " << depth << "m" << std::endl;
-        std::cout << "Total time taken: " << std::fixed << std::setprecision(2) << elapsedSeconds << " seconds" << std::endl;
+        testLog.info() << "Timer stopped! Depth: " << depth << "m";
+        testLog.info() << "Total time taken: " << logFixed(elapsedSeconds, 2) << " seconds";
     }
 }
 
@@ -109,6 +95,22 @@ int main() {
         return -1;
     }
 
+    // Body index reader, to measure depth on the person's torso
+    IBodyIndexFrameReader* bodyIndexFrameReader = nullptr;
+    IBodyIndexFrameSource* bodyIndexFrameSource = nullptr;
+
+    hr = kinectSensor->get_BodyIndexFrameSource(&bodyIndexFrameSource);
+    if (FAILED(hr) || !bodyIndexFrameSource) {
+        std::cerr << "Failed to get Body Index Frame Source!" << std::endl;
+        return -1;
+    }
+
+    hr = bodyIndexFrameSource->OpenReader(&bodyIndexFrameReader);
+    if (FAILED(hr) || !bodyIndexFrameReader) {
+        std::cerr << "Failed to open Body Index Frame Reader!" << std::endl;
+        return -1;
+    }
+
     // Depth frame properties
     int depthWidth = 0, depthHeight = 0;
     IFrameDescription* depthFrameDescription = nullptr;
@@ -119,8 +121,14 @@ int main() {
 
     // Depth buffer and smoothing
     std::vector<UINT16> depthBuffer(depthWidth * depthHeight);
-    std::deque<float> depthQueue; // To store depth values for smoothing
-    const size_t smoothingWindowSize = 10; // Adjust smoothing window size as needed
+    std::vector<BYTE> bodyIndexBuffer(depthWidth * depthHeight, 0xff); // last body index frame
+    bool hasBodyIndex = false;
+    DepthRoi depthRoi;
+    DepthRoiResult roi;
+    RingFilter<float, 3> depthFilter; // The ROI median is steady; a short average keeps the lag low
+
+    // Two color buffers allocated once, reused every frame
+    FramePool<ColorFrameData> colorPool(2);
 
     // Main loop
     while (true) {
@@ -132,18 +140,25 @@ int main() {
             hr = depthFrame->CopyFrameDataToArray(static_cast<UINT>(depthBuffer.size()), &depthBuffer[0]);
 
             if (SUCCEEDED(hr)) {
-                // Find the closest depth value in the center of the frame
-                int centerX = depthWidth / 2;
-                int centerY = depthHeight / 2;
-                int index = centerY * depthWidth + centerX;
-                UINT16 depthValue = depthBuffer[index];
+                // Body index frame for the same moment; keep the last one if none is new
+                IBodyIndexFrame* bodyIndexFrame = nullptr;
+                if (SUCCEEDED(bodyIndexFrameReader->AcquireLatestFrame(&bodyIndexFrame))) {
+                    hasBodyIndex = SUCCEEDED(bodyIndexFrame->CopyFrameDataToArray(static_cast<UINT>(bodyIndexBuffer.size()), &bodyIndexBuffer[0]));
+                }
+                SafeRelease(bodyIndexFrame);
+
+                // Median depth of the torso of the person in the middle of the view
+                // (of the centre window when no body is segmented) and smooth it
+                bool measured = hasBodyIndex ? depthRoi.measure(&depthBuffer[0], &bodyIndexBuffer[0], roi)
+                                             : depthRoi.measure(&depthBuffer[0], roi);
+                float smoothedDepth = measured ? depthFilter.push(roi.depth) : depthFilter.mean();
 
-                // Convert depth to meters and smooth it
-                float depthInMeters = depthValue * 0.001f;
-                float smoothedDepth = getSmoothedDepth(depthQueue, depthInMeters, smoothingWindowSize);
+                // Capture time of this depth frame on the sensor clock
+                TIMESPAN frameTime = 0;
+                depthFrame->get_RelativeTime(&frameTime);
 
                 // Process the walking test timer
-                processWalkingTest(smoothedDepth);
+                processWalkingTest(smoothedDepth, frameTime);
 
                 // Get color frame for live feed
                 IColorFrame* colorFrame = nullptr;
@@ -157,8 +172,9 @@ int main() {
                     colorFrameDescription->get_Height(&colorHeight);
                     SafeRelease(colorFrameDescription);
 
-                    // Prepare frame buffer
-                    std::vector<BYTE> colorBuffer(colorWidth * colorHeight * 4); // BGRA
+                    // Lease a preallocated BGRA buffer instead of allocating one per frame
+                    FrameLease<ColorFrameData> colorLease = colorPool.lease();
+                    AlignedBuffer& colorBuffer = colorLease->bgra;
                     hr = colorFrame->CopyConvertedFrameDataToArray(static_cast<UINT>(colorBuffer.size()), colorBuffer.data(), ColorImageFormat_Bgra);
 
                     if (SUCCEEDED(hr)) {
@@ -184,6 +200,8 @@ int main() {
     SafeRelease(depthFrameSource);
     SafeRelease(colorFrameReader);
     SafeRelease(colorFrameSource);
+    SafeRelease(bodyIndexFrameReader);
+    SafeRelease(bodyIndexFrameSource);
     if (kinectSensor) kinectSensor->Close();
     SafeRelease(kinectSensor);
 
@@ -1,47 +1,40 @@
 #include <iostream>
-#include <Kinect.h>
+#include "../Common/KinectFrameSource.h"
+#include "../Common/FrameCapture.h"
+#include "../Common/FrameClock.h"
+#include "../Common/GateCrossing.h"
+#include "../Common/FrameSynchronizer.h"
+#include "../Common/DepthRoi.h"
+#include "../Common/RingFilter.h"
+#include "../Common/AsyncLogger.h"
 #include <opencv2/opencv.hpp>
-#include <deque>
-#include <numeric>
 #include <chrono>
 #include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include<iostream>
 using namespace std;
 
-#pragma comment(lib, "kinect20.lib")
+// Timer variables, on the sensor clock
+FrameTimer walkTimer;
 
-template<class Interface>
-inline void SafeRelease(Interface*& interfaceToRelease) {
-    if (interfaceToRelease) {
-        interfaceToRelease->Release();
-        interfaceToRelease = nullptr;
-    }
-}
-
-// Moving average filter
-float getSmoothedDepth(std::deque<float>& depthQueue, float newDepth, size_t windowSize) {
-    depthQueue.push_back(newDepth);
-    if (depthQueue.size() > windowSize) {
-        depthQueue.pop_front();
-    }
-    float sum = std::accumulate(depthQueue.begin(), depthQueue.end(), 0.0f);
-    return sum / depthQueue.size();
-}
+// Start and stop gates, metres from the sensor. The walking direction
+// follows from their order, so e.g. 3.0f -> 8.0f times a walk away.
+const float START_GATE_DISTANCE = 6.0f;
+const float STOP_GATE_DISTANCE = 1.0f;
+GateCrossing startGate(START_GATE_DISTANCE, gateDirection(START_GATE_DISTANCE, STOP_GATE_DISTANCE));
+GateCrossing stopGate(STOP_GATE_DISTANCE, gateDirection(START_GATE_DISTANCE, STOP_GATE_DISTANCE));
 
-// Timer variables
-bool isTiming = false;
-std::chrono::steady_clock::time_point startTime;
-std::chrono::steady_clock::time_point endTime;
-
-// Helper function to calculate the moving average of a deque
-float calculateMovingAverage(const std::deque<float>& values) {
-    if (values.empty()) return 0.0f;
-    float sum = std::accumulate(values.begin(), values.end(), 0.0f);
-    return sum / values.size();
-}
+// Timer events are written to the console by a background thread, so the
+// analytics thread never waits on it
+AsyncLogger logger;
+LogChannel testLog(logger, "test");
 
 // Timer logic for walking test
-// Variables for displaying timer information
+// Variables for displaying timer information, shared by the analytics thread
+// and the UI loop under testStateMutex
+std::mutex testStateMutex;
 std::string timerMessage = "";
 std::string timerStartedMessage = "";
 std::string timerStoppedMessage = "";
@@ -50,178 +43,140 @@ float timerStartDepth = 0.0f;
 float timerStopDepth = 0.0f;
 float finalElapsedSeconds = 0.0f; // Store final elapsed time
 
-void processWalkingTest(float depth, std::string& timerMessage) {
-    // Check for start condition (depth between 5.98m and 6.0m)
-    if (!isTiming && depth >= 5.99f && depth <= 6.0f) {
-        isTiming = true;
-        startTime = std::chrono::steady_clock::now();
+void processWalkingTest(float depth, TIMESPAN frameTime, std::string& timerMessage) {
+    // Both gates see every sample, so each is armed before the subject reaches it
+    TIMESPAN startTime = 0, stopTime = 0;
+    bool started = startGate.update(frameTime, depth, startTime);
+    bool stopped = stopGate.update(frameTime, depth, stopTime);
+
+    // Subject passed the start gate
+    if (started && !walkTimer.isRunning()) {
+        walkTimer.start(startTime);
         timerStartedMessage = "Timer Started! Depth: " + std::to_string(depth).substr(0, 4) + " m";
-        std::cout << "Timer Started! Depth: " << depth << endl;
+        testLog.info() << "Timer Started! Depth: " << depth;
     }
 
-    // Check for stop condition (depth between 0.98m and 1.0m)
-    if (isTiming && depth >= 0.99f && depth <= 1.0f) {
-        endTime = std::chrono::steady_clock::now();
-        isTiming = false;
-
+    // Subject passed the stop gate
+    if (stopped && walkTimer.isRunning()) {
         // Calculate elapsed time
-        auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-        finalElapsedSeconds = elapsedTime / 1000.0f; // Save the final elapsed time
+        finalElapsedSeconds = static_cast<float>(walkTimer.stop(stopTime)); // Save the final elapsed time
 
         timerStoppedMessage = "Timer Stopped! Depth: " + std::to_string(depth).substr(0, 4) + " m " +
             "Time Taken: " + std::to_string(finalElapsedSeconds).substr(0, 5) + " s";
-        std::cout << "Timer Stopped! Depth: " << depth << "\nTime: " << finalElapsedSeconds << " s" << std::endl;
+        testLog.info() << "Timer Stopped! Depth: " << depth;
+        testLog.info() << "Time: " << finalElapsedSeconds << " s";
     }
 
     // Display live depth value
     liveDepthMessage = "Depth: " + std::to_string(depth).substr(0, 4) + " m";
 }
-int main() {
-    // Initialize Kinect sensor
-    IKinectSensor* kinectSensor = nullptr;
-    HRESULT hr = GetDefaultKinectSensor(&kinectSensor);
-
-    if (FAILED(hr) || !kinectSensor) {
-        std::cerr << "Failed to initialize Kinect sensor!" << std::endl;
+// Usage: "Walking Speed Test V3" [recording.ksession]
+// Without an argument the live Kinect is used.
+int main(int argc, char** argv) {
+    // Open the live sensor or a recorded session
+    std::string replayPath = argc > 1 ? argv[1] : "";
+    std::unique_ptr<FrameSource> source = openFrameSource(replayPath, FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Color, 1.0);
+    if (!source) {
         return -1;
     }
 
-    hr = kinectSensor->Open();
-    if (FAILED(hr)) {
-        std::cerr << "Failed to open Kinect sensor!" << std::endl;
-        return -1;
-    }
-
-    // Depth frame reader
-    IDepthFrameReader* depthFrameReader = nullptr;
-    IDepthFrameSource* depthFrameSource = nullptr;
-
-    hr = kinectSensor->get_DepthFrameSource(&depthFrameSource);
-    if (FAILED(hr) || !depthFrameSource) {
-        std::cerr << "Failed to get Depth Frame Source!" << std::endl;
-        return -1;
-    }
-
-    hr = depthFrameSource->OpenReader(&depthFrameReader);
-    if (FAILED(hr) || !depthFrameReader) {
-        std::cerr << "Failed to open Depth Frame Reader!" << std::endl;
-        return -1;
-    }
-
-    // Color frame reader
-    IColorFrameReader* colorFrameReader = nullptr;
-    IColorFrameSource* colorFrameSource = nullptr;
-
-    hr = kinectSensor->get_ColorFrameSource(&colorFrameSource);
-    if (FAILED(hr) || !colorFrameSource) {
-        std::cerr << "Failed to get Color Frame Source!" << std::endl;
-        return -1;
-    }
-
-    hr = colorFrameSource->OpenReader(&colorFrameReader);
-    if (FAILED(hr) || !colorFrameReader) {
-        std::cerr << "Failed to open Color Frame Reader!" << std::endl;
-        return -1;
-    }
-
-    // Depth frame properties
-    int depthWidth = 0, depthHeight = 0;
-    IFrameDescription* depthFrameDescription = nullptr;
-    depthFrameSource->get_FrameDescription(&depthFrameDescription);
-    depthFrameDescription->get_Width(&depthWidth);
-    depthFrameDescription->get_Height(&depthHeight);
-    SafeRelease(depthFrameDescription);
-
-    // Depth buffer and smoothing
-    std::vector<UINT16> depthBuffer(depthWidth * depthHeight);
-    std::deque<float> depthQueue; // To store depth values for smoothing
-    const size_t smoothingWindowSize = 10; // Adjust smoothing window size as needed
-
-    // Main loop
-    // Main loop
-    while (true) {
-        // Get Depth Frame and process
-        IDepthFrame* depthFrame = nullptr;
-        hr = depthFrameReader->AcquireLatestFrame(&depthFrame);
-
-        if (SUCCEEDED(hr)) {
-            hr = depthFrame->CopyFrameDataToArray(static_cast<UINT>(depthBuffer.size()), &depthBuffer[0]);
-
-            if (SUCCEEDED(hr)) {
-                // Find the closest depth value in the center of the frame
-                int centerX = depthWidth / 2;
-                int centerY = depthHeight / 2;
-                int index = centerY * depthWidth + centerX;
-                UINT16 depthValue = depthBuffer[index];
-
-                // Convert depth to meters and smooth it
-                float depthInMeters = depthValue * 0.001f;
-                float smoothedDepth = getSmoothedDepth(depthQueue, depthInMeters, smoothingWindowSize);
+    // Acquire on a dedicated thread so rendering never holds up the sensor
+    FrameCapture capture(*source);
+    capture.start(FrameStream_Depth | FrameStream_BodyIndex | FrameStream_Color);
+
+    // Analytics thread: every depth frame, in order, at sensor rate, paired
+    // with the body index frame of the same moment when there is one
+    std::atomic<bool> stopAnalytics(false);
+    uint64_t depthFramesProcessed = 0;
+    uint64_t torsoFrames = 0;
+    std::thread analytics([&]() {
+        FrameSynchronizer sync(FrameStream_Depth | FrameStream_BodyIndex, FrameStream_Depth, MissingStream_Partial);
+        FrameBundle bundle;
+        DepthRoi depthRoi;
+        DepthRoiResult roi;
+        RingFilter<float, 3> depthFilter; // The ROI median is steady; a short average keeps the lag low
+
+        while (!stopAnalytics) {
+            bool finished = capture.sourceFinished() && capture.depth().empty() && capture.bodyIndex().empty();
+            if (finished) sync.flush();
+            sync.poll(capture);
+
+            bool popped = false;
+            while (sync.pop(bundle)) {
+                popped = true;
+
+                // Median depth of the torso of the person in the middle of the
+                // view (of the centre window when no body is segmented)
+                bool measured = bundle.has(FrameStream_BodyIndex)
+                    ? depthRoi.measure(bundle.depth->pixels.data(), bundle.bodyIndex->pixels.data(), roi)
+                    : depthRoi.measure(bundle.depth->pixels.data(), roi);
+                float smoothedDepth = measured ? depthFilter.push(roi.depth) : depthFilter.mean();
+                if (roi.body >= 0) ++torsoFrames;
 
                 // Process the walking test timer
-                processWalkingTest(smoothedDepth, timerMessage);
-
-                // Get color frame for live feed
-                IColorFrame* colorFrame = nullptr;
-                hr = colorFrameReader->AcquireLatestFrame(&colorFrame);
-
-                if (SUCCEEDED(hr)) {
-                    int colorWidth = 0, colorHeight = 0;
-                    IFrameDescription* colorFrameDescription = nullptr;
-                    colorFrame->get_FrameDescription(&colorFrameDescription);
-                    colorFrameDescription->get_Width(&colorWidth);
-                    colorFrameDescription->get_Height(&colorHeight);
-                    SafeRelease(colorFrameDescription);
-
-                    // Prepare frame buffer
-                    std::vector<BYTE> colorBuffer(colorWidth * colorHeight * 4); // BGRA
-                    hr = colorFrame->CopyConvertedFrameDataToArray(static_cast<UINT>(colorBuffer.size()), colorBuffer.data(), ColorImageFormat_Bgra);
-
-                    if (SUCCEEDED(hr)) {
-                        // Create OpenCV Mat and display it
-                        cv::Mat colorMat(colorHeight, colorWidth, CV_8UC4, colorBuffer.data());
-
-                        // Display the messages
-                        cv::putText(colorMat, liveDepthMessage, cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
-                        if (!timerStartedMessage.empty()) {
-                            cv::putText(colorMat, timerStartedMessage, cv::Point(50, 100),
-                                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
-                        }
-                        if (!timerStoppedMessage.empty()) {
-                            cv::putText(colorMat, timerStoppedMessage, cv::Point(50, 150),
-                                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
-                        }
-                        if (isTiming) {
-                            auto currentTime = std::chrono::steady_clock::now();
-                            auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
-                            float elapsedSeconds = elapsedTime / 1000.0f;
-                            cv::putText(colorMat, "Timer: " + std::to_string(elapsedSeconds).substr(0, 5) + " s",
-                                cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
-                        }
-                        else if (finalElapsedSeconds > 0.0f) {
-                            cv::putText(colorMat, "Final Time: " + std::to_string(finalElapsedSeconds).substr(0, 5) + " s",
-                                cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
-                        }
-
-                        // Display the frame
-                        cv::imshow("Kinect Live Feed", colorMat);
-                        if (cv::waitKey(30) == 27) break; // Exit on ESC key
-                    }
-                }
-
-                SafeRelease(colorFrame);
+                std::lock_guard<std::mutex> lock(testStateMutex);
+                processWalkingTest(smoothedDepth, bundle.relativeTime, timerMessage);
+                ++depthFramesProcessed;
+            }
+
+            if (!popped) {
+                if (finished) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
             }
         }
+    });
+
+    // UI loop: newest color frame, at whatever rate rendering allows
+    FrameLease<ColorFrameData> colorFrame;
+    bool userQuit = false;
+    while (!capture.sourceFinished() || !capture.color().empty()) {
+        if (capture.color().popLatest(colorFrame)) {
+            // Create OpenCV Mat and display it
+            cv::Mat colorMat(COLOR_HEIGHT, COLOR_WIDTH, CV_8UC4, colorFrame->bgra.data());
+
+            // Display the messages
+            std::unique_lock<std::mutex> lock(testStateMutex);
+            cv::putText(colorMat, liveDepthMessage, cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
+            if (!timerStartedMessage.empty()) {
+                cv::putText(colorMat, timerStartedMessage, cv::Point(50, 100),
+                    cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
+            }
+            if (!timerStoppedMessage.empty()) {
+                cv::putText(colorMat, timerStoppedMessage, cv::Point(50, 150),
+                    cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
+            }
+            if (walkTimer.isRunning()) {
+                // Live time up to the frame on screen
+                float elapsedSeconds = static_cast<float>(walkTimer.elapsedSeconds(colorFrame->relativeTime));
+                cv::putText(colorMat, "Timer: " + std::to_string(elapsedSeconds).substr(0, 5) + " s",
+                    cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
+            }
+            else if (finalElapsedSeconds > 0.0f) {
+                cv::putText(colorMat, "Final Time: " + std::to_string(finalElapsedSeconds).substr(0, 5) + " s",
+                    cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 255), 2);
+            }
+            lock.unlock();
 
-        SafeRelease(depthFrame);
+            // Display the frame
+            cv::imshow("Kinect Live Feed", colorMat);
+        }
+        if (cv::waitKey(30) == 27) { // Exit on ESC key
+            userQuit = true;
+            break;
+        }
     }
-    // Clean up
-    SafeRelease(depthFrameReader);
-    SafeRelease(depthFrameSource);
-    SafeRelease(colorFrameReader);
-    SafeRelease(colorFrameSource);
-    if (kinectSensor) kinectSensor->Close();
-    SafeRelease(kinectSensor);
 
+    // At the end of a recording let analytics finish the queued frames
+    if (userQuit) stopAnalytics = true;
+    analytics.join();
+    capture.stop();
+
+    // Timer events first, then the run summary
+    logger.flush();
+    std::cout << "Analytics: " << depthFramesProcessed << " depth frames processed, "
+              << torsoFrames << " measured on the torso, "
+              << capture.depth().dropped() << " dropped" << std::endl;
+    std::cout << "Render: " << capture.color().captured() << " color frames captured, "
+              << capture.color().skipped() << " skipped, " << capture.color().dropped() << " dropped" << std::endl;
     return 0;
 }